@@ -0,0 +1,51 @@
+#include "artifact_store.hpp"
+
+#include "cache.hpp"
+#include "cache_router.hpp"
+#include "extension_state.hpp"
+#include "quackstore_filesystem.hpp"
+#include "quackstore_params.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// ArtifactStore
+// =============================================================================
+
+bool ArtifactStore::Store(duckdb::ClientContext &context, const duckdb::string &path, const duckdb::string &type,
+                          duckdb::const_data_ptr_t data, idx_t size) {
+    const auto file_path = GetFilePath(path);
+    auto cache = GetCache(context, file_path);
+    return cache && cache->StoreArtifact(file_path, type, data, size);
+}
+
+bool ArtifactStore::Retrieve(duckdb::ClientContext &context, const duckdb::string &path, const duckdb::string &type,
+                             duckdb::vector<uint8_t> &data_out) {
+    const auto file_path = GetFilePath(path);
+    auto cache = GetCache(context, file_path);
+    return cache && cache->RetrieveArtifact(file_path, type, data_out);
+}
+
+duckdb::optional_ptr<Cache> ArtifactStore::GetCache(duckdb::ClientContext &context, const duckdb::string &file_path) {
+    auto state = ExtensionState::RetrieveFromContext(context);
+    if (!state) {
+        return nullptr;
+    }
+    const auto params = ExtensionParams::ReadFrom(context);
+    if (!params.cache_enabled) {
+        return nullptr;
+    }
+    if (auto router = state->GetRouter()) {
+        return &router->Route(file_path, params);
+    }
+    auto &cache = state->GetCache();
+    return cache.IsOpen() ? &cache : nullptr;
+}
+
+duckdb::string ArtifactStore::GetFilePath(const duckdb::string &path) {
+    // Files are cached under their quackstore:// path
+    const duckdb::string prefix = QuackstoreFileSystem::SCHEMA_PREFIX;
+    return path.rfind(prefix, 0) == 0 ? path : prefix + path;
+}
+
+}  // namespace quackstore
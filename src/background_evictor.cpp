@@ -0,0 +1,53 @@
+#include "background_evictor.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// BackgroundEvictor
+// =============================================================================
+
+BackgroundEvictor::BackgroundEvictor(EvictBatch evict_batch)
+    : evict_batch(std::move(evict_batch))
+    , thread([this]() { Run(); }) {
+}
+
+BackgroundEvictor::~BackgroundEvictor() {
+    {
+        std::lock_guard<std::mutex> lock{evictor_mutex};
+        stopping = true;
+    }
+    wake_up.notify_all();
+    thread.join();
+}
+
+void BackgroundEvictor::Notify() {
+    {
+        std::lock_guard<std::mutex> lock{evictor_mutex};
+        notified = true;
+    }
+    wake_up.notify_one();
+}
+
+void BackgroundEvictor::Run() {
+    std::unique_lock<std::mutex> lock{evictor_mutex};
+    while (!stopping) {
+        wake_up.wait_for(lock, CHECK_INTERVAL, [&]() { return stopping || notified; });
+        notified = false;
+        while (!stopping) {
+            lock.unlock();
+            bool more = false;
+            try {
+                more = evict_batch();
+            } catch (...) {
+                // Stores evict what they need, the next check tries again
+            }
+            lock.lock();
+            if (!more) {
+                break;
+            }
+            wake_up.wait_for(lock, BATCH_PAUSE, [&]() { return stopping; });
+        }
+    }
+}
+
+}  // namespace quackstore
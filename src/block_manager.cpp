@@ -5,10 +5,18 @@
 #include "block_manager.hpp"
 #include "metadata_reader.hpp"
 #include "metadata_writer.hpp"
+#include "segment_table.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace 
 {
-    const uint32_t BLOCK_CACHE_DATA_FILE_VERSION_NUMBER = 3;
+    const uint32_t BLOCK_CACHE_DATA_FILE_VERSION_NUMBER = 6;
+    //! Ranges noted for dropping from the page cache before they're dropped without waiting for the read to end
+    const size_t MAX_PENDING_PAGE_CACHE_DROPS = 64;
 }
 
 namespace quackstore {
@@ -28,6 +36,10 @@ void BlockCacheDataFileHeader::Write(duckdb::WriteStream &ser) {
     ser.Write(free_list);
     ser.Write(block_count);
     ser.Write(block_size);
+    ser.Write(generation);
+    ser.Write(layout);
+    ser.Write(segment_index);
+    ser.Write(segment_index_size);
 }
 
 BlockCacheDataFileHeader BlockCacheDataFileHeader::Read(duckdb::ReadStream &source) {
@@ -42,6 +54,16 @@ BlockCacheDataFileHeader BlockCacheDataFileHeader::Read(duckdb::ReadStream &sour
     header.free_list = source.Read<int64_t>();
     header.block_count = source.Read<uint64_t>();
     header.block_size = source.Read<uint64_t>();
+    // The header area is zero-filled, so older files read a zero generation
+    header.generation = header.version >= 5 ? source.Read<uint64_t>() : 0;
+    if (header.version >= 6) {
+        header.layout = source.Read<uint32_t>();
+        header.segment_index = source.Read<uint64_t>();
+        header.segment_index_size = source.Read<uint64_t>();
+    }
+    if (header.layout > static_cast<uint32_t>(StorageLayout::SEGMENTED)) {
+        throw duckdb::IOException("Unsupported block cache storage layout [" + std::to_string(header.layout) + "]");
+    }
 
     return header;
 }
@@ -54,6 +76,10 @@ size_t BlockCacheDataFileHeader::Size() {
     size += sizeof(decltype(free_list));
     size += sizeof(decltype(block_count));
     size += sizeof(decltype(block_size));
+    size += sizeof(decltype(generation));
+    size += sizeof(decltype(layout));
+    size += sizeof(decltype(segment_index));
+    size += sizeof(decltype(segment_index_size));
     return size;
 }
 
@@ -63,15 +89,15 @@ size_t BlockCacheDataFileHeader::Size() {
 
 BlockManager::BlockManager(const BlockManagerOptions &options)
     : fs(duckdb::FileSystem::CreateLocal()), options(options) {
-    if (options.block_size < Bytes(16)) {
-        throw duckdb::IOException("The block size can't be smaller than 16 bytes");
-    }
+    ValidateBlockSize(options.block_size);
+    block_shift = GetBlockShift(options.block_size);
+    segment_table = duckdb::make_uniq<SegmentTable>(std::max(SEGMENT_SIZE >> block_shift, MIN_SEGMENT_SLOTS));
 }
 
 BlockManager::~BlockManager() { Close(); }
 
 void BlockManager::Close() {
-    if (IsOpen()) {
+    if (IsOpen() && !read_only) {
         Flush();
     }
     CloseInternal();
@@ -108,11 +134,15 @@ BlockCacheDataFileHeader BlockManager::CreateNewDatabase(const duckdb::string &p
         throw duckdb::IOException("Failed to open block data cache file: \"%s\"!", path);
     }
 
+    layout = options.layout;
+
     BlockCacheDataFileHeader header;
     header.version = BLOCK_CACHE_DATA_FILE_VERSION_NUMBER;
     header.meta_block = meta_block_id;
     header.free_list = free_list_id;
     header.block_count = max_block;
+    header.block_size = options.block_size;
+    header.layout = static_cast<uint32_t>(layout);
 
     duckdb::MemoryStream mem;
     header.Write(mem);
@@ -124,28 +154,29 @@ BlockCacheDataFileHeader BlockManager::CreateNewDatabase(const duckdb::string &p
     return header;
 }
 
-BlockCacheDataFileHeader BlockManager::LoadExistingDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out) {
+BlockCacheDataFileHeader BlockManager::LoadExistingDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out,
+                                                            bool open_read_only) {
     Close();
     D_ASSERT(max_block == 0);
     D_ASSERT(meta_block_id == INVALID_BLOCK_ID);
     D_ASSERT(free_list_id == INVALID_BLOCK_ID);
 
-    handle = fs->OpenFile(path, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_READ);
+    auto flags = open_read_only ? duckdb::FileFlags::FILE_FLAGS_READ
+                                : duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_READ;
+    handle = fs->OpenFile(path, flags);
     if (!handle) {
         throw duckdb::IOException("Failed to open block data cache file: \"%s\"!", path);
     }
 
     // Read the header from the file
-    duckdb::vector<uint8_t> header_data(BlockCacheDataFileHeader::Size());
-    handle->Read(header_data.data(), header_data.size(), 0);
-
-    duckdb::MemoryStream mem(header_data.data(), header_data.size());
-    auto header = BlockCacheDataFileHeader::Read(mem);
+    auto header = ReadHeader();
 
     // Initialize state
     max_block = header.block_count;
     meta_block_id = header.meta_block;
     free_list_id = header.free_list;
+    generation = header.generation;
+    read_only = open_read_only;
 
     if (header.block_size != options.block_size) {
         throw duckdb::IOException(
@@ -154,18 +185,91 @@ BlockCacheDataFileHeader BlockManager::LoadExistingDatabase(const duckdb::string
             options.block_size, header.block_size);
     }
 
+    LoadSegmentTable(header);
     LoadFreeList();
 
     if (out) *out = LoadResult::LOADED_EXISTING;
     return header;
 }
 
+bool BlockManager::TryReadHeader(const duckdb::string &path, BlockCacheDataFileHeader &header_out) {
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (!local_fs->FileExists(path)) {
+        return false;
+    }
+
+    auto file_handle = local_fs->OpenFile(path, duckdb::FileFlags::FILE_FLAGS_READ);
+    duckdb::vector<uint8_t> header_data(BlockCacheDataFileHeader::Size());
+    file_handle->Read(header_data.data(), header_data.size(), 0);
+
+    duckdb::MemoryStream mem(header_data.data(), header_data.size());
+    header_out = BlockCacheDataFileHeader::Read(mem);
+    return true;
+}
+
 void BlockManager::Flush()
 {
     ValidateHandle();
+    if (read_only) {
+        return;
+    }
 
     SaveFreeList();
+    if (layout == StorageLayout::SEGMENTED) {
+        // Written last, it holds the locations of the free list and metadata blocks written before
+        SaveSegmentTable();
+    }
     WriteHeader();
+    // The header points to the new table, the segments only the previous one referred to can be overwritten now
+    segment_table->ReleasePendingSegments();
+}
+
+BlockCacheDataFileHeader BlockManager::Reload() {
+    ValidateHandle();
+
+    auto header = ReadHeader();
+    if (header.block_size != options.block_size) {
+        throw duckdb::IOException(
+            "cannot initialize the same block storage with a different block size: provided block "
+            "size: %llu, file block size: %llu",
+            options.block_size, header.block_size);
+    }
+
+    free_list.clear();
+    block_refs.clear();
+    extents.clear();
+    max_block = header.block_count;
+    meta_block_id = header.meta_block;
+    free_list_id = header.free_list;
+    generation = header.generation;
+    LoadSegmentTable(header);
+    LoadFreeList();
+
+    return header;
+}
+
+uint64_t BlockManager::ReadStoredGeneration() {
+    ValidateHandle();
+    return ReadHeader().generation;
+}
+
+void BlockManager::FreeAllBlocks() {
+    block_refs.clear();
+    extents.clear();
+    for (block_id_t block_id = 0; block_id < static_cast<block_id_t>(max_block); ++block_id) {
+        if (block_id != meta_block_id) {
+            free_list.insert(block_id);
+            segment_table->Remove(block_id);
+        }
+    }
+}
+
+BlockCacheDataFileHeader BlockManager::ReadHeader() {
+    duckdb::vector<uint8_t> header_data(BlockCacheDataFileHeader::Size());
+    handle->Read(header_data.data(), header_data.size(), 0);
+
+    duckdb::MemoryStream mem(header_data.data(), header_data.size());
+    return BlockCacheDataFileHeader::Read(mem);
 }
 
 void BlockManager::WriteHeader() {
@@ -177,6 +281,10 @@ void BlockManager::WriteHeader() {
     header.free_list = free_list_id;
     header.block_count = max_block;
     header.block_size = options.block_size;
+    header.generation = ++generation;
+    header.layout = static_cast<uint32_t>(layout);
+    header.segment_index = segment_index;
+    header.segment_index_size = segment_index_size;
 
     duckdb::MemoryStream mem;
     header.Write(mem);
@@ -212,10 +320,65 @@ block_id_t BlockManager::AllocBlock() {
     return block_id;
 }
 
+block_id_t BlockManager::AllocBlocks(idx_t block_count) {
+    if (block_count <= 1) {
+        return AllocBlock();
+    }
+
+    // Look for a run of free blocks long enough for the extent
+    block_id_t run_start = INVALID_BLOCK_ID;
+    idx_t run_length = 0;
+    for (auto block_id : free_list) {
+        if (run_length > 0 && block_id == run_start + static_cast<block_id_t>(run_length)) {
+            ++run_length;
+        } else {
+            run_start = block_id;
+            run_length = 1;
+        }
+        if (run_length == block_count) {
+            break;
+        }
+    }
+
+    block_id_t block_id;
+    if (run_length == block_count) {
+        block_id = run_start;
+        free_list.erase(free_list.find(run_start), free_list.upper_bound(run_start + block_count - 1));
+    } else if (run_length > 0 && run_start + static_cast<block_id_t>(run_length) == static_cast<block_id_t>(max_block)) {
+        // The free blocks at the end of the storage are extended
+        block_id = run_start;
+        free_list.erase(free_list.find(run_start), free_list.end());
+        max_block = run_start + block_count;
+    } else {
+        block_id = max_block;
+        max_block += block_count;
+    }
+
+    extents[block_id] = block_count;
+    return block_id;
+}
+
+void BlockManager::RegisterExtent(block_id_t block_id, idx_t block_count) {
+    ValidateBlockId(block_id);
+    if (block_count > 1) {
+        extents[block_id] = block_count;
+    }
+}
+
+idx_t BlockManager::GetExtentBlockCount(block_id_t block_id) const {
+    auto it = extents.find(block_id);
+    return it != extents.end() ? it->second : 1;
+}
+
 void BlockManager::StoreBlock(block_id_t block_id, const duckdb::vector<uint8_t> &data) {
     ValidateBlockId(block_id);
     ValidateHandle();
 
+    if (layout == StorageLayout::SEGMENTED) {
+        // Written as a whole, the block moves to the head instead of being overwritten
+        PlaceBlock(block_id);
+    }
+
     auto offset = GetBlockOffset(block_id);
     fs->Write(*handle, const_cast<duckdb::data_ptr_t>(data.data()), data.size(), offset);
 }
@@ -225,7 +388,36 @@ void BlockManager::RetrieveBlock(block_id_t block_id, duckdb::vector<uint8_t> &d
     ValidateHandle();
 
     auto offset = GetBlockOffset(block_id);
+    data.resize(options.block_size);
     handle->Read(data.data(), options.block_size, offset);
+    DropPageCache(offset, options.block_size);
+}
+
+void BlockManager::StoreBlockRange(block_id_t block_id, uint64_t offset_in_block, duckdb::const_data_ptr_t data,
+                                   idx_t size) {
+    ValidateBlockId(block_id);
+    ValidateBlockRange(block_id, offset_in_block, size);
+    ValidateHandle();
+
+    SegmentTable::Location location;
+    if (layout == StorageLayout::SEGMENTED && !segment_table->TryGetLocation(block_id, location)) {
+        // A block written in parts (e.g. a slab) is placed by its first part
+        PlaceBlock(block_id);
+    }
+
+    auto offset = GetBlockOffset(block_id) + offset_in_block;
+    fs->Write(*handle, const_cast<duckdb::data_ptr_t>(data), size, offset);
+}
+
+void BlockManager::RetrieveBlockRange(block_id_t block_id, uint64_t offset_in_block, duckdb::data_ptr_t data,
+                                      idx_t size) {
+    ValidateBlockId(block_id);
+    ValidateBlockRange(block_id, offset_in_block, size);
+    ValidateHandle();
+
+    auto offset = GetBlockOffset(block_id) + offset_in_block;
+    handle->Read(data, size, offset);
+    DropPageCache(offset, size);
 }
 
 void BlockManager::MarkBlockAsFree(block_id_t block_id) {
@@ -235,10 +427,72 @@ void BlockManager::MarkBlockAsFree(block_id_t block_id) {
         // Block is already freed. Do nothing.
         return;
     }
+    block_refs.erase(block_id);
+    segment_table->Remove(block_id);
+
+    auto extent_it = extents.find(block_id);
+    if (extent_it != extents.end()) {
+        for (idx_t i = 1; i < extent_it->second; ++i) {
+            free_list.insert(block_id + static_cast<block_id_t>(i));
+        }
+        extents.erase(extent_it);
+    }
+}
+
+void BlockManager::AddBlockRef(block_id_t block_id) {
+    ValidateBlockId(block_id);
+
+    auto it = block_refs.find(block_id);
+    if (it == block_refs.end()) {
+        // The block had a single owner so far
+        block_refs[block_id] = 2;
+        return;
+    }
+    ++it->second;
+}
+
+bool BlockManager::ReleaseBlockRef(block_id_t block_id) {
+    ValidateBlockId(block_id);
+
+    auto it = block_refs.find(block_id);
+    if (it == block_refs.end()) {
+        // Last owner is gone
+        MarkBlockAsFree(block_id);
+        return true;
+    }
+    if (--it->second <= 1) {
+        block_refs.erase(it);
+    }
+    return false;
+}
+
+idx_t BlockManager::GetBlockRefCount(block_id_t block_id) const {
+    auto it = block_refs.find(block_id);
+    return it != block_refs.end() ? it->second : 1;
 }
 
 uint64_t BlockManager::GetBlockSize() const { return options.block_size; }
 
+void BlockManager::SetLayout(StorageLayout new_layout) { options.layout = new_layout; }
+
+void BlockManager::ValidateBlockSize(uint64_t block_size) {
+    if (block_size < Bytes(16)) {
+        throw duckdb::IOException("The block size can't be smaller than 16 bytes");
+    }
+    if ((block_size & (block_size - 1)) != 0) {
+        throw duckdb::InvalidInputException("The block size must be a power of two, got %llu", block_size);
+    }
+}
+
+uint8_t BlockManager::GetBlockShift(uint64_t block_size) {
+    D_ASSERT(block_size != 0 && (block_size & (block_size - 1)) == 0);
+    uint8_t shift = 0;
+    while ((1ULL << shift) < block_size) {
+        ++shift;
+    }
+    return shift;
+}
+
 block_id_t BlockManager::GetMetaBlockID() {
     if (meta_block_id != INVALID_BLOCK_ID) {
         return meta_block_id;
@@ -249,16 +503,98 @@ block_id_t BlockManager::GetMetaBlockID() {
     return meta_block_id;
 }
 
+bool BlockManager::TryGetBlockRange(block_id_t block_id, uint64_t &offset_out, idx_t &size_out) const {
+    if (block_id < 0 || static_cast<uint64_t>(block_id) >= max_block) {
+        return false;
+    }
+    uint64_t slot = static_cast<uint64_t>(block_id);
+    if (layout == StorageLayout::SEGMENTED) {
+        SegmentTable::Location location;
+        if (!segment_table->TryGetLocation(block_id, location)) {
+            return false;
+        }
+        slot = location.slot;
+    }
+    offset_out = BLOCK_START + (slot << block_shift);
+    size_out = GetExtentBlockCount(block_id) << block_shift;
+    return true;
+}
+
 const duckdb::set<block_id_t> &BlockManager::GetFreeList() const { return free_list; }
 block_id_t BlockManager::GetMaxBlock() const { return max_block; }
+const SegmentTable &BlockManager::GetSegmentTable() const { return *segment_table; }
 
 // =============================================================================
 // Private methods
 // =============================================================================
 
-uint64_t BlockManager::GetBlockOffset(block_id_t block_id) { 
+uint64_t BlockManager::GetBlockOffset(block_id_t block_id) const {
     ValidateBlockId(block_id);
-    return BLOCK_START + block_id * options.block_size; 
+    if (layout == StorageLayout::SEGMENTED) {
+        // A block is placed when it's first written, reading it before has nothing to return
+        SegmentTable::Location location;
+        if (!segment_table->TryGetLocation(block_id, location)) {
+            throw duckdb::IOException("Block %lld was not written to the storage file", block_id);
+        }
+        return BLOCK_START + (location.slot << block_shift);
+    }
+    return BLOCK_START + (static_cast<uint64_t>(block_id) << block_shift);
+}
+
+uint64_t BlockManager::PlaceBlock(block_id_t block_id) {
+    const auto segment_count = segment_table->GetSegmentCount();
+    const auto slot = segment_table->Place(block_id, GetExtentBlockCount(block_id));
+    if (segment_table->GetSegmentCount() > segment_count) {
+        // The storage grew, free a sparse segment for the head to move to next instead of growing again
+        CollectSparseSegment();
+    }
+    return slot;
+}
+
+void BlockManager::CollectSparseSegment() {
+    uint64_t segment;
+    if (!segment_table->FindSparseSegment(options.segment_gc_live_percent, SEGMENT_INDEX_BLOCK_ID, segment)) {
+        return;
+    }
+
+    duckdb::vector<uint8_t> data;
+    for (const auto block_id : segment_table->GetSegmentBlocks(segment)) {
+        SegmentTable::Location location;
+        segment_table->TryGetLocation(block_id, location);
+        data.resize(location.slot_count << block_shift);
+        handle->Read(data.data(), data.size(), BLOCK_START + (location.slot << block_shift));
+        // Placed directly, moving blocks doesn't collect another segment
+        const auto slot = segment_table->Place(block_id, location.slot_count);
+        fs->Write(*handle, data.data(), data.size(), BLOCK_START + (slot << block_shift));
+    }
+}
+
+void BlockManager::SaveSegmentTable() {
+    duckdb::MemoryStream mem;
+    segment_table->Write(mem);
+
+    // The previous table stays where it is until the header points to the new one
+    segment_index_size = mem.GetPosition();
+    const auto slot_count = std::max<uint64_t>((segment_index_size + options.block_size - 1) >> block_shift, 1);
+    segment_index = segment_table->Place(SEGMENT_INDEX_BLOCK_ID, slot_count);
+    fs->Write(*handle, mem.GetData(), segment_index_size, BLOCK_START + (segment_index << block_shift));
+}
+
+void BlockManager::LoadSegmentTable(const BlockCacheDataFileHeader &header) {
+    layout = static_cast<StorageLayout>(header.layout);
+    segment_index = header.segment_index;
+    segment_index_size = header.segment_index_size;
+    segment_table->Clear();
+    if (layout != StorageLayout::SEGMENTED || segment_index_size == 0) {
+        return;
+    }
+
+    duckdb::vector<uint8_t> data(segment_index_size);
+    handle->Read(data.data(), data.size(), BLOCK_START + (segment_index << block_shift));
+    duckdb::MemoryStream mem(data.data(), data.size());
+    segment_table->Read(mem);
+    const auto slot_count = std::max<uint64_t>((segment_index_size + options.block_size - 1) >> block_shift, 1);
+    segment_table->Restore(SEGMENT_INDEX_BLOCK_ID, {segment_index, slot_count});
 }
 
 void BlockManager::SaveFreeList() {
@@ -326,6 +662,20 @@ void BlockManager::ValidateBlockId(block_id_t block_id) const {
     }
 }
 
+void BlockManager::ValidateBlockRange(block_id_t block_id, uint64_t offset_in_block, idx_t size) const {
+    const uint64_t range_size = GetExtentBlockCount(block_id) << block_shift;
+    if (offset_in_block + size > range_size) {
+        throw duckdb::InvalidInputException(
+            {
+                {"offset", std::to_string(offset_in_block)},
+                {"size", std::to_string(size)},
+                {"block_size", std::to_string(range_size)}
+            },
+            "Block range cannot exceed the block size"
+        );
+    }
+}
+
 void BlockManager::ValidateHandle() const {
     if (!IsOpen()) {
         throw duckdb::IOException("BlockManager is not open. Cannot perform operation.");
@@ -333,10 +683,62 @@ void BlockManager::ValidateHandle() const {
 }
 
 void BlockManager::CloseHandle() {
+    FlushPageCacheDrops();
     if (IsOpen()) {
         handle->Close();
         handle = nullptr;
     }
+#ifndef _WIN32
+    if (page_cache_fd >= 0) {
+        close(page_cache_fd);
+        page_cache_fd = -1;
+    }
+#endif
+}
+
+void BlockManager::SetPageCacheDropEnabled(bool enabled) {
+    page_cache_drop_enabled = enabled;
+}
+
+void BlockManager::DropPageCache(uint64_t offset, idx_t size) {
+    if (!page_cache_drop_enabled) {
+        return;
+    }
+    for (auto &range : pending_page_cache_drops) {
+        if (range.offset + range.size == offset) {
+            range.size += size;
+            return;
+        }
+        if (offset + size == range.offset) {
+            range.offset = offset;
+            range.size += size;
+            return;
+        }
+    }
+    if (pending_page_cache_drops.size() >= MAX_PENDING_PAGE_CACHE_DROPS) {
+        FlushPageCacheDrops();
+    }
+    pending_page_cache_drops.push_back({offset, size});
+}
+
+void BlockManager::FlushPageCacheDrops() {
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    if (pending_page_cache_drops.empty() || !IsOpen()) {
+        pending_page_cache_drops.clear();
+        return;
+    }
+    // The page cache belongs to the file, advising through a descriptor of our own drops the pages of the handle
+    if (page_cache_fd < 0) {
+        page_cache_fd = open(handle->GetPath().c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (page_cache_fd >= 0) {
+        for (auto &range : pending_page_cache_drops) {
+            posix_fadvise(page_cache_fd, static_cast<off_t>(range.offset), static_cast<off_t>(range.size),
+                          POSIX_FADV_DONTNEED);
+        }
+    }
+#endif
+    pending_page_cache_drops.clear();
 }
 
 void BlockManager::CloseInternal()
@@ -344,7 +746,15 @@ void BlockManager::CloseInternal()
     max_block = 0;
     meta_block_id = INVALID_BLOCK_ID;
     free_list_id = INVALID_BLOCK_ID;
+    generation = 0;
+    read_only = false;
+    layout = StorageLayout::IN_PLACE;
+    segment_table->Clear();
+    segment_index = 0;
+    segment_index_size = 0;
     free_list.clear();
+    block_refs.clear();
+    extents.clear();
 
     CloseHandle();
 }
@@ -1,25 +1,59 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <duckdb/common/checksum.hpp>
+#include <duckdb/common/error_data.hpp>
+
+#ifndef _WIN32
+#include <sys/statvfs.h>
+#endif
 
 #include "cache.hpp"
+#include "cache_registry.hpp"
+#include "background_evictor.hpp"
+#include "page_cache_warmer.hpp"
 
-namespace
-{
-    int64_t NumBlocksFromSize(int64_t cache_size_in_bytes, int64_t block_size) {
-        return (cache_size_in_bytes + block_size - 1) / block_size;
+namespace {
+    //! Writes to a full volume fail with an IOException carrying ENOSPC in its errno
+    bool IsOutOfSpace(const std::exception &ex) {
+        const duckdb::ErrorData error(ex);
+        const auto &extra_info = error.ExtraInfo();
+        const auto errno_it = extra_info.find("errno");
+        return error.Type() == duckdb::ExceptionType::IO && errno_it != extra_info.end() &&
+               errno_it->second == std::to_string(ENOSPC);
+    }
+
+    //! Size and free space (available to unprivileged users) of the volume holding the path
+    bool GetVolumeSpace(const duckdb::string &path, uint64_t &total_out, uint64_t &available_out) {
+#ifndef _WIN32
+        struct statvfs stats;
+        if (statvfs(path.c_str(), &stats) != 0) {
+            return false;
+        }
+        total_out = static_cast<uint64_t>(stats.f_blocks) * stats.f_frsize;
+        available_out = static_cast<uint64_t>(stats.f_bavail) * stats.f_frsize;
+        return true;
+#else
+        return false;
+#endif
     }
 }
 
 namespace quackstore {
 
 Cache::Cache(uint64_t block_size, duckdb::unique_ptr<BlockManager> block_manager,
-             duckdb::unique_ptr<MetadataManager> metadata_manager)
+             duckdb::unique_ptr<MetadataManager> metadata_manager, duckdb::optional_ptr<CacheRegistry> registry)
     : block_size(block_size)
     , block_mgr(block_manager ? std::move(block_manager) : duckdb::make_uniq<BlockManager>(BlockManagerOptions{block_size}))
     , metadata_mgr(metadata_manager ? std::move(metadata_manager) : duckdb::make_uniq<MetadataManager>())
+    , registry(registry)
 {
     D_ASSERT(!opened);
     D_ASSERT(block_mgr);
     D_ASSERT(metadata_mgr);
+    BlockManager::ValidateBlockSize(block_size);
+    block_shift = BlockManager::GetBlockShift(block_size);
+    metadata_mgr->SetBlockSize(block_size);
 }
 
 Cache::~Cache() {
@@ -43,17 +77,49 @@ void Cache::Open(const duckdb::string &open_path) {
         throw duckdb::InvalidInputException("Cache path can't be empty");
     }
 
+    if (read_only) {
+        OpenReadOnly(open_path);
+        return;
+    }
+
+    if (registry) {
+        shared_cache = registry->Acquire(open_path, block_size, block_size_set, shared_access_enabled, storage_layout);
+        path = open_path;
+        opened = true;
+        RequestHandleSettings();
+        return;
+    }
+
+    if (shared_access_enabled) {
+        file_lock = duckdb::make_uniq<FileLock>(open_path + ".lock");
+    }
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    // A cache file written with another block size is migrated to the block size set before loading, without
+    // one set it keeps its block size
+    BlockCacheDataFileHeader existing_header;
+    if (BlockManager::TryReadHeader(open_path, existing_header) && existing_header.block_size != block_size) {
+        if (block_size_set) {
+            MigrateBlockSize(open_path, existing_header.block_size);
+        } else {
+            ResetBlockSize(existing_header.block_size);
+        }
+    }
+
     BlockManager::LoadResult load_result = BlockManager::LoadResult::NA;
     auto header = block_mgr->LoadOrCreateDatabase(open_path, &load_result);
     if (load_result == BlockManager::LoadResult::LOADED_EXISTING)
     {
         MetadataReader reader(*block_mgr, block_mgr->GetMetaBlockID());
         metadata_mgr->ReadMetadata(reader, header.version);
+        RestoreBlockState();
     }
 
     path = open_path;
     opened = true;
     SetDirty(true);
+    StartEvictor();
+    StartWarmup();
 }
 
 void Cache::Close() {
@@ -64,11 +130,33 @@ void Cache::Close() {
     if (current_cache_users.load(std::memory_order_acquire) != 0) {
         throw duckdb::IOException("Query cache is in use, please wait for the running queries to finish and try again.");
     }
-    Flush();
-    if (block_mgr) {
-        block_mgr->Close();
-        metadata_mgr->Clear();
+    StopEvictor();
+    StopWarmup();
+    if (shared_cache) {
+        // Only this handle is done with the cache, other database instances may still use it. File handles in
+        // flight keep the storage open through their epoch.
+        const auto registry_key = shared_cache->GetPath();
+        epoch.reset();
+        if (!is_epoch) {
+            shared_cache->DropHandleSettings(*this);
+        }
+        shared_cache.reset();
+        registry->Release(registry_key);
+        opened = false;
+        path.clear();
+        return;
+    }
+    {
+        SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+        Flush();
+        if (block_mgr) {
+            block_mgr->Close();
+            metadata_mgr->Clear();
+        }
     }
+    file_lock.reset();
+    deferred_lru_updates.clear();
+    unpublished_changes = 0;
     opened = false;
     path.clear();
     SetDirty(false);
@@ -76,40 +164,174 @@ void Cache::Close() {
 
 void Cache::Clear() {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    ValidateWritable();
     if (opened) {
+        if (shared_cache) {
+            // The shared cache is cleared for all its handles and opened again empty while holding its lock, so file
+            // handles in flight never see it closed, they read the blocks they miss from the source again
+            duckdb::lock_guard<std::recursive_mutex> storage_lock{shared_cache->cache_mutex};
+            const auto storage_path = shared_cache->GetPath();
+            shared_cache->ClearStorage();
+            shared_cache->Open(storage_path);
+            return;
+        }
         if (current_cache_users.load(std::memory_order_acquire) != 0) {
             throw duckdb::IOException("Query cache is in use, please wait for the running queries to finish and try again.");
         }
+        ClearStorage();
+    }
+
+    SetDirty(false);
+}
+
+void Cache::ClearStorage() {
+    StopEvictor();
+    StopWarmup();
+    if (shared_access_enabled) {
+        // Other processes keep the file open, publish an empty cache instead of removing the file
+        SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+        metadata_mgr->Clear();
+        block_mgr->FreeAllBlocks();
+        SetDirty(true);
+        Flush();
+        block_mgr->Close();
+    } else {
         block_mgr->Clear();
         metadata_mgr->Clear();
-        opened = false;
     }
-
+    file_lock.reset();
+    deferred_lru_updates.clear();
+    unpublished_changes = 0;
+    opened = false;
     SetDirty(false);
 }
 
 void Cache::Evict(const duckdb::string& filepath)
 {
+    EvictFiles({filepath});
+}
+
+idx_t Cache::EvictFiles(const duckdb::vector<duckdb::string> &file_paths) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->EvictFiles(file_paths);
+    }
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
 
-    MetadataManager::FileMetadata md;
-    if (!RetrieveFileMetadata(filepath, md)) return;
+    const auto release_block = [&](block_id_t block_id) { block_mgr->ReleaseBlockRef(block_id); };
+    idx_t evicted_files = 0;
+    idx_t evicted_artifacts = 0;
+    for (const auto &file_path : file_paths) {
+        // Blocks shared with other files stay in the storage until their last owner is evicted
+        const auto evicted_blocks = metadata_mgr->UnregisterFileBlocks(file_path, release_block);
+        if (evicted_blocks != 0) {
+            // Artifacts matched by a prefix or pattern along with their file aren't files of their own
+            if (file_path.find(ARTIFACT_SEPARATOR) == duckdb::string::npos) {
+                ++evicted_files;
+            } else {
+                ++evicted_artifacts;
+            }
+        }
+        for (const auto &artifact_path : metadata_mgr->GetFilePathsWithPrefix(file_path + ARTIFACT_SEPARATOR)) {
+            metadata_mgr->UnregisterFileBlocks(artifact_path, release_block);
+            ++evicted_artifacts;
+        }
+    }
+    // The whole batch is published at once, and only if something was actually evicted
+    if (evicted_files != 0 || evicted_artifacts != 0) {
+        SetDirty(true);
+        PublishChanges();
+    }
+    return evicted_files;
+}
 
-    bool evicted = false;
-    for(const auto& [block_id, _]: md.blocks)
-    {
-        metadata_mgr->UnregisterBlock(block_id);
-        block_mgr->MarkBlockAsFree(block_id);
-        evicted = true;
+bool Cache::RenameFile(const duckdb::string &file_path, const duckdb::string &new_path) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->RenameFile(file_path, new_path);
+    }
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    if (file_path == new_path) {
+        return false;
+    }
+    // The file replaces the target, blocks shared with other files stay in the storage
+    const auto release_block = [&](block_id_t block_id) { block_mgr->ReleaseBlockRef(block_id); };
+    bool changed = metadata_mgr->UnregisterFileBlocks(new_path, release_block) != 0;
+    for (const auto &artifact_path : metadata_mgr->GetFilePathsWithPrefix(new_path + ARTIFACT_SEPARATOR)) {
+        metadata_mgr->UnregisterFileBlocks(artifact_path, release_block);
+        changed = true;
+    }
+
+    const bool renamed = metadata_mgr->RenameFile(file_path, new_path);
+    for (const auto &artifact_path : metadata_mgr->GetFilePathsWithPrefix(file_path + ARTIFACT_SEPARATOR)) {
+        metadata_mgr->RenameFile(artifact_path, new_path + artifact_path.substr(file_path.size()));
+    }
+    if (changed || renamed) {
+        SetDirty(true);
+        PublishChanges();
+    }
+    return renamed;
+}
+
+//! Files are cached under their quackstore:// path, prefixes and patterns may be given with or without it
+static duckdb::vector<duckdb::string> WithSchemaPrefix(const duckdb::string &path) {
+    static const duckdb::string SCHEMA_PREFIX = "quackstore://";
+    if (path.rfind(SCHEMA_PREFIX, 0) == 0) {
+        return {path};
+    }
+    return {path, SCHEMA_PREFIX + path};
+}
+
+idx_t Cache::EvictPrefix(const duckdb::string &prefix) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->EvictPrefix(prefix);
     }
-    // Only mark dirty if something was actually evicted
-    SetDirty(evicted);
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    duckdb::vector<duckdb::string> file_paths;
+    for (const auto &full_prefix : WithSchemaPrefix(prefix)) {
+        auto matches = metadata_mgr->GetFilePathsWithPrefix(full_prefix);
+        file_paths.insert(file_paths.end(), matches.begin(), matches.end());
+    }
+    return EvictFiles(file_paths);
+}
+
+idx_t Cache::EvictGlob(const duckdb::string &pattern) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->EvictGlob(pattern);
+    }
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    duckdb::vector<duckdb::string> file_paths;
+    for (const auto &full_pattern : WithSchemaPrefix(pattern)) {
+        auto matches = metadata_mgr->GetFilePathsMatching(full_pattern);
+        file_paths.insert(file_paths.end(), matches.begin(), matches.end());
+    }
+    return EvictFiles(file_paths);
 }
 
 void Cache::Flush() {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_cache->Flush();
+        return;
+    }
 
-    if (!IsOpen() || !IsDirty() || !block_mgr)
+    if (!IsOpen() || !block_mgr || read_only)
+    {
+        return;
+    }
+    // Changes of other processes replace the local state, only the local LRU order is lost
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+    ApplyDeferredLRUUpdates();
+    if (!IsDirty())
     {
         return;
     }
@@ -125,32 +347,438 @@ void Cache::Flush() {
 
     block_mgr->Flush();
     SetDirty(false);
+    unpublished_changes = 0;
+    last_published = std::chrono::steady_clock::now();
 }
 
 void Cache::StoreBlock(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    const StorePolicy policy{deduplication_enabled, pack_threshold};
+    if (shared_cache) {
+        shared_cache->StoreBlockWithPolicy(file_path, block_index, data, policy);
+        return;
+    }
+    StoreBlockWithPolicy(file_path, block_index, data, policy);
+}
+
+void Cache::StoreBlockWithPolicy(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data,
+                                 const StorePolicy &policy) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    try {
+        StoreBlockInternal(file_path, block_index, data, policy);
+    } catch (std::exception &ex) {
+        if (!IsOutOfSpace(ex)) {
+            throw;
+        }
+        // The volume filled up (e.g. by other users of a shared disk): store the block in the space of evicted
+        // blocks, and leave it uncached if it still doesn't fit. The data is read from the source then.
+        ReleaseFileBlock(file_path, block_index);
+        EvictForSpace();
+        try {
+            StoreBlockInternal(file_path, block_index, data, policy);
+        } catch (std::exception &retry_ex) {
+            if (!IsOutOfSpace(retry_ex)) {
+                throw;
+            }
+            ReleaseFileBlock(file_path, block_index);
+        }
+    }
+    EnforceMetadataBudget(file_path);
+    // The blocks it took from the free list (or the end of the file) must be published before the lock is released,
+    // another process would hand them out again otherwise
+    PublishChanges();
+}
+
+void Cache::EvictAfterStore(block_id_t keep_block_id) {
+    auto remove_from_storage = [&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); };
+    if (!evictor) {
+        metadata_mgr->EvictLRUBlockIfNeeded(remove_from_storage, keep_block_id);
+        return;
+    }
+    // The evictor keeps the cache below the high watermark, a store only evicts the few blocks it fell behind by
+    const auto max_cache_size = metadata_mgr->GetMaxCacheSize();
+    const auto evicted_blocks =
+        metadata_mgr->EvictOverQuotaBlocks(max_cache_size, MAX_STORE_EVICTIONS, remove_from_storage, keep_block_id);
+    metadata_mgr->EvictLRUBlocks(max_cache_size, MAX_STORE_EVICTIONS - evicted_blocks, remove_from_storage,
+                                 keep_block_id);
+    if (!eviction_running && metadata_mgr->GetCachedBytes() > GetWatermark(eviction_high_watermark)) {
+        evictor->Notify();
+    }
+}
+
+bool Cache::EvictBatch() {
+    // Never waits for the cache, so the evictor can be stopped by a thread holding it. A busy cache is no progress,
+    // the next store over the watermark or the check interval wakes the evictor again.
+    std::unique_lock<std::recursive_mutex> lock{cache_mutex, std::try_to_lock};
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    if (!opened || read_only) {
+        return false;
+    }
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    // Evict from the high watermark down to the low watermark
+    if (!eviction_running) {
+        if (metadata_mgr->GetCachedBytes() <= GetWatermark(eviction_high_watermark)) {
+            return false;
+        }
+        eviction_running = true;
+    }
+    const auto low_watermark = GetWatermark(eviction_low_watermark);
+    auto remove_from_storage = [&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); };
+    auto evicted_blocks = metadata_mgr->EvictOverQuotaBlocks(low_watermark, EVICTION_BATCH_SIZE, remove_from_storage);
+    evicted_blocks +=
+        metadata_mgr->EvictLRUBlocks(low_watermark, EVICTION_BATCH_SIZE - evicted_blocks, remove_from_storage);
+    if (evicted_blocks > 0) {
+        SetDirty(true);
+        PublishChangesBatched();
+    }
+    eviction_running = evicted_blocks == EVICTION_BATCH_SIZE && metadata_mgr->GetCachedBytes() > low_watermark;
+    return eviction_running;
+}
+
+uint64_t Cache::GetWatermark(uint64_t percent) const {
+    return metadata_mgr->GetMaxCacheSize() / 100 * percent;
+}
+
+void Cache::SetBackgroundEviction(bool enabled, uint64_t low_watermark_percent, uint64_t high_watermark_percent) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    const auto high_watermark = std::min<uint64_t>(high_watermark_percent, 100);
+    const auto low_watermark = std::min(low_watermark_percent, high_watermark);
+    if (IsSharedHandle()) {
+        if (enabled != handle_settings.background_eviction_enabled ||
+            low_watermark != handle_settings.eviction_low_watermark ||
+            high_watermark != handle_settings.eviction_high_watermark) {
+            handle_settings.background_eviction_enabled = enabled;
+            handle_settings.eviction_low_watermark = low_watermark;
+            handle_settings.eviction_high_watermark = high_watermark;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (enabled == background_eviction_enabled && low_watermark == eviction_low_watermark &&
+        high_watermark == eviction_high_watermark) {
+        return;
+    }
+    background_eviction_enabled = enabled;
+    eviction_high_watermark = high_watermark;
+    eviction_low_watermark = low_watermark;
+    if (enabled) {
+        StartEvictor();
+    } else {
+        StopEvictor();
+    }
+}
+
+bool Cache::IsBackgroundEvictionEnabled() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->IsBackgroundEvictionEnabled();
+    }
+    return evictor != nullptr;
+}
+
+void Cache::StartEvictor() {
+    if (evictor || !background_eviction_enabled || !opened || read_only || shared_cache) {
+        return;
+    }
+    evictor = duckdb::make_uniq<BackgroundEvictor>([this]() { return EvictBatch(); });
+    // The cache may be over the watermark already
+    evictor->Notify();
+}
+
+void Cache::StopEvictor() {
+    evictor.reset();
+    eviction_running = false;
+}
+
+void Cache::SetWarmupSize(uint64_t max_bytes) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        if (max_bytes != handle_settings.warmup_size) {
+            handle_settings.warmup_size = max_bytes;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (max_bytes == warmup_size) {
+        return;
+    }
+    warmup_size = max_bytes;
+    StartWarmup();
+}
+
+uint64_t Cache::GetWarmupBytes() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetWarmupBytes();
+    }
+    return warmup_bytes;
+}
+
+bool Cache::IsBlockWarmedUp(const duckdb::string &file_path, int64_t block_index) const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->IsBlockWarmedUp(file_path, block_index);
+    }
+    uint64_t offset;
+    idx_t size;
+    const auto block_id = metadata_mgr->GetBlockId(file_path, block_index);
+    if (!warmer || block_id == BlockManager::INVALID_BLOCK_ID || !block_mgr->TryGetBlockRange(block_id, offset, size)) {
+        return false;
+    }
+    for (const auto &range : warmer->GetRanges()) {
+        if (offset >= range.offset && offset + size <= range.offset + range.size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cache::StartWarmup() {
+    if (warmup_started || warmup_size == 0 || !opened || shared_cache || page_cache_drop_enabled) {
+        return;
+    }
+    warmup_started = true;
+
+    // The blocks used last before the cache was closed, in file order so adjacent blocks are asked for as one range
+    SharedAccess access(*this, FileLock::Mode::SHARED);
+    duckdb::vector<PageCacheWarmer::FileRange> block_ranges;
+    for (const auto block_id : metadata_mgr->GetRecentBlocks(warmup_size >> block_shift)) {
+        uint64_t offset;
+        idx_t size;
+        if (!block_mgr->TryGetBlockRange(block_id, offset, size) || warmup_bytes + size > warmup_size) {
+            continue;
+        }
+        warmup_bytes += size;
+        block_ranges.push_back({offset, size});
+    }
+    std::sort(block_ranges.begin(), block_ranges.end(),
+              [](const PageCacheWarmer::FileRange &a, const PageCacheWarmer::FileRange &b) { return a.offset < b.offset; });
+    duckdb::vector<PageCacheWarmer::FileRange> ranges;
+    for (const auto &range : block_ranges) {
+        if (!ranges.empty() && ranges.back().offset + ranges.back().size == range.offset) {
+            ranges.back().size += range.size;
+        } else {
+            ranges.push_back(range);
+        }
+    }
+    if (!ranges.empty()) {
+        warmer = duckdb::make_uniq<PageCacheWarmer>(path, std::move(ranges));
+    }
+}
+
+void Cache::StopWarmup() {
+    warmer.reset();
+    warmup_started = false;
+    warmup_bytes = 0;
+}
+
+void Cache::EnforceMetadataBudget(const duckdb::string &keep_file_path) {
+    if (metadata_budget == 0 || metadata_mgr->GetMetadataBytes() <= metadata_budget) {
+        return;
+    }
+    // Blocks shared with other files stay in the storage until their last owner is dropped
+    const auto release_block = [&](block_id_t block_id) { block_mgr->ReleaseBlockRef(block_id); };
+    if (metadata_mgr->EvictFileMetadata(metadata_budget, keep_file_path, release_block) > 0) {
+        SetDirty(true);
+    }
+}
+
+void Cache::ReleaseFileBlock(const duckdb::string &file_path, int64_t block_index) {
+    const auto block_id = metadata_mgr->GetBlockId(file_path, block_index);
+    if (block_id != BlockManager::INVALID_BLOCK_ID) {
+        metadata_mgr->UnregisterFileBlock(file_path, block_index);
+        block_mgr->ReleaseBlockRef(block_id);
+    }
+}
+
+void Cache::EvictForSpace() {
+    // A share of the cache, at least a few extents, so the next stores don't run out of space right away
+    const auto cached_bytes = metadata_mgr->GetCachedBytes();
+    const auto evicted_bytes = std::min<uint64_t>(cached_bytes, std::max<uint64_t>(cached_bytes / 20,
+                                                                                   block_size << (MAX_EXTENT_SHIFT + 2)));
+    const auto max_cache_size = metadata_mgr->GetMaxCacheSize();
+    metadata_mgr->SetMaxCacheSize(cached_bytes - evicted_bytes);
+    metadata_mgr->EvictLRUBlockIfNeeded([&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); });
+    // A derived size stays at what fits on the volume until it's derived again
+    if (!auto_size_enabled) {
+        metadata_mgr->SetMaxCacheSize(max_cache_size);
+    }
+    SetDirty(true);
+}
+
+void Cache::StoreBlockInternal(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data,
+                               const StorePolicy &policy) {
+    // Data shorter than the block size is the tail of a file: only its valid bytes are stored,
+    // and small ones are packed into shared slab blocks
+    if (data.empty()) {
+        data.resize(block_size, 0);
+    }
+    const bool pack = data.size() < block_size && data.size() < policy.pack_threshold;
+    const uint64_t length = data.size() != block_size ? data.size() : 0;
+
+    // Data longer than the block size is stored as an extent of contiguous blocks
+    const idx_t num_blocks = (data.size() + block_size - 1) >> block_shift;
+    if (num_blocks > 1) {
+        ValidateExtent(block_index, num_blocks);
+    }
 
     uint64_t checksum = duckdb::Checksum(data.data(), data.size());
 
-    block_id_t block_id = metadata_mgr->GetBlockId(file_path, block_index);
+    // Stored blocks are never overwritten in place: they may be shared with other files or packed
+    // together with other blocks. Drop the old blocks and store the data as a new one.
+    for (idx_t i = 0; i < num_blocks; ++i) {
+        ReleaseFileBlock(file_path, block_index + static_cast<int64_t>(i));
+    }
 
-    // Allocate new block for the data if it's this is a new data
-    if (block_id == BlockManager::INVALID_BLOCK_ID) {
-        block_id = block_mgr->AllocBlock();
-        metadata_mgr->RegisterBlock(file_path, block_index, block_id, checksum);
+    if (policy.deduplicate && TryStoreDeduplicatedBlock(file_path, block_index, data, checksum)) {
+        SetDirty(true);
+        return;
+    }
 
-        // Evict LRU block if needed
-        metadata_mgr->EvictLRUBlockIfNeeded([&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); });
+    if (pack) {
+        StorePackedBlock(file_path, block_index, data, checksum);
+        SetDirty(true);
+        return;
     }
 
+    // Allocate new block for the data
+    const block_id_t block_id = block_mgr->AllocBlocks(num_blocks);
+    metadata_mgr->RegisterBlock(file_path, block_index, block_id, checksum, 0, length);
+
+    // Evict LRU block if needed
+    EvictAfterStore(BlockManager::INVALID_BLOCK_ID);
+
     metadata_mgr->UpdateLRUOrder(block_id);
-    block_mgr->StoreBlock(block_id, data);
+    if (length != 0) {
+        block_mgr->StoreBlockRange(block_id, 0, data.data(), data.size());
+    } else {
+        block_mgr->StoreBlock(block_id, data);
+    }
 
     SetDirty(true);
 }
 
+bool Cache::RetrieveCoveringBlock(const duckdb::string &file_path, int64_t block_index, int64_t &start_index_out,
+                                  duckdb::vector<uint8_t> &data) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->RetrieveCoveringBlock(file_path, block_index, start_index_out, data);
+    }
+    SharedAccess access(*this, FileLock::Mode::SHARED);
+
+    start_index_out = metadata_mgr->FindCoveringBlockIndex(file_path, block_index, MAX_EXTENT_SHIFT);
+    if (start_index_out < 0) {
+        return false;
+    }
+    return RetrieveBlock(file_path, start_index_out, data);
+}
+
+bool Cache::IsBlockCached(const duckdb::string &file_path, int64_t block_index) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->IsBlockCached(file_path, block_index);
+    }
+    SharedAccess access(*this, FileLock::Mode::SHARED);
+    return metadata_mgr->FindCoveringBlockIndex(file_path, block_index, MAX_EXTENT_SHIFT) >= 0;
+}
+
+bool Cache::RetrieveRange(const duckdb::string &file_path, idx_t offset, idx_t size, duckdb::data_ptr_t out) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->RetrieveRange(file_path, offset, size, out);
+    }
+
+    duckdb::vector<uint8_t> block_data;
+    while (size > 0) {
+        const int64_t block_index = static_cast<int64_t>(offset >> block_shift);
+        int64_t start_index = block_index;
+        block_data.resize(block_size);
+        if (!RetrieveCoveringBlock(file_path, block_index, start_index, block_data)) {
+            return false;
+        }
+        const idx_t block_offset = offset - (static_cast<idx_t>(start_index) << block_shift);
+        if (block_offset >= block_data.size()) {
+            return false;
+        }
+        const idx_t bytes = duckdb::MinValue<idx_t>(size, block_data.size() - block_offset);
+        std::copy(block_data.begin() + block_offset, block_data.begin() + block_offset + bytes, out);
+        out += bytes;
+        offset += bytes;
+        size -= bytes;
+    }
+    DropReadPages();
+    return true;
+}
+
+//! Artifacts start with the size and last modification time of the file version they were derived from
+static constexpr idx_t ARTIFACT_HEADER_SIZE = 2 * sizeof(int64_t);
+
+bool Cache::StoreArtifact(const duckdb::string &file_path, const duckdb::string &type, duckdb::const_data_ptr_t data,
+                          idx_t size) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    MetadataManager::FileMetadata md;
+    if (IsReadOnly() || !RetrieveFileMetadata(file_path, md)) {
+        return false;
+    }
+
+    duckdb::vector<uint8_t> artifact(ARTIFACT_HEADER_SIZE + size);
+    duckdb::Store<int64_t>(md.file_size, artifact.data());
+    duckdb::Store<int64_t>(md.last_modified.value, artifact.data() + sizeof(int64_t));
+    if (size != 0) {
+        memcpy(artifact.data() + ARTIFACT_HEADER_SIZE, data, size);
+    }
+
+    // Stored like the blocks of a file, so it's evicted, exported and shared like them
+    const auto artifact_path = file_path + ARTIFACT_SEPARATOR + type;
+    EvictFiles({artifact_path});
+    const auto artifact_block_size = GetBlockSize();
+    int64_t block_index = 0;
+    for (idx_t offset = 0; offset < artifact.size(); offset += artifact_block_size, ++block_index) {
+        duckdb::vector<uint8_t> block(artifact.begin() + offset,
+                                      artifact.begin() + duckdb::MinValue<idx_t>(offset + artifact_block_size, artifact.size()));
+        StoreBlock(artifact_path, block_index, block);
+    }
+    StoreFileSize(artifact_path, static_cast<int64_t>(artifact.size()));
+    StoreFileLastModified(artifact_path, md.last_modified);
+    return true;
+}
+
+bool Cache::RetrieveArtifact(const duckdb::string &file_path, const duckdb::string &type,
+                             duckdb::vector<uint8_t> &data_out) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    const auto artifact_path = file_path + ARTIFACT_SEPARATOR + type;
+    MetadataManager::FileMetadata md;
+    MetadataManager::FileMetadata artifact_md;
+    if (!RetrieveFileMetadata(file_path, md) || !RetrieveFileMetadata(artifact_path, artifact_md) ||
+        artifact_md.file_size < static_cast<int64_t>(ARTIFACT_HEADER_SIZE)) {
+        return false;
+    }
+
+    // Some of its blocks may have been evicted
+    duckdb::vector<uint8_t> artifact(artifact_md.file_size);
+    if (!RetrieveRange(artifact_path, 0, artifact.size(), artifact.data())) {
+        return false;
+    }
+    if (duckdb::Load<int64_t>(artifact.data()) != md.file_size ||
+        duckdb::Load<int64_t>(artifact.data() + sizeof(int64_t)) != md.last_modified.value) {
+        return false;
+    }
+    data_out.assign(artifact.begin() + ARTIFACT_HEADER_SIZE, artifact.end());
+    return true;
+}
+
 bool Cache::RetrieveBlock(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->RetrieveBlock(file_path, block_index, data);
+    }
+    SharedAccess access(*this, FileLock::Mode::SHARED);
 
     auto block_id = metadata_mgr->GetBlockId(file_path, block_index);
     if (block_id == BlockManager::INVALID_BLOCK_ID) {
@@ -158,16 +786,42 @@ bool Cache::RetrieveBlock(const duckdb::string &file_path, int64_t block_index,
     }
 
     auto block_info = metadata_mgr->GetBlockInfo(file_path, block_id);
-    metadata_mgr->UpdateLRUOrder(block_id);
-    block_mgr->RetrieveBlock(block_id, data);
+    if (shared_access_enabled) {
+        // Only the shared lock is held, the state may be replaced by another process before it's published
+        if (deferred_lru_updates.size() < MAX_DEFERRED_LRU_UPDATES) {
+            deferred_lru_updates.push_back({file_path, block_index});
+        }
+    } else if (!read_only) {
+        metadata_mgr->UpdateLRUOrder(block_id);
+    }
+
+    uint64_t computed_checksum = 0;
+    if (block_info.HasLength()) {
+        data.resize(block_info.length);
+        block_mgr->RetrieveBlockRange(block_id, block_info.offset, data.data(), block_info.length);
+        computed_checksum = duckdb::Checksum(data.data(), block_info.length);
+    } else {
+        block_mgr->RetrieveBlock(block_id, data);
+        computed_checksum = duckdb::Checksum(data.data(), data.size());
+    }
 
     // Verify checksum
-    uint64_t computed_checksum = duckdb::Checksum(data.data(), data.size());
     if (block_info.checksum != computed_checksum) {
+        if (shared_access_enabled || read_only) {
+            // Only reading under the shared lock (or from a read-only file), the block is replaced when the
+            // data is stored again
+            return false;
+        }
         // Given block is corrupted, or we got an inconsistent state where metadata and block data is unsync.
         // In this case we mark given block as free and unregister it from the metadata.
-        block_mgr->MarkBlockAsFree(block_id);
-        metadata_mgr->UnregisterBlock(block_id);
+        // For a packed block only its own range is dropped, other blocks in the slab are verified on their own.
+        if (block_info.HasLength()) {
+            metadata_mgr->UnregisterFileBlock(file_path, block_index);
+            block_mgr->ReleaseBlockRef(block_id);
+        } else {
+            block_mgr->MarkBlockAsFree(block_id);
+            metadata_mgr->UnregisterBlock(block_id);
+        }
 
         SetDirty(true);
         return false;
@@ -177,41 +831,771 @@ bool Cache::RetrieveBlock(const duckdb::string &file_path, int64_t block_index,
     return true;
 }
 
+void Cache::RetainRange(const duckdb::string &file_path, idx_t offset, idx_t size) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_cache->RetainRange(file_path, offset, size);
+        return;
+    }
+    if (size == 0) {
+        return;
+    }
+    SharedAccess access(*this, FileLock::Mode::SHARED);
+
+    const auto last_index = static_cast<int64_t>((offset + size - 1) >> block_shift);
+    for (auto block_index = static_cast<int64_t>(offset >> block_shift); block_index <= last_index; ++block_index) {
+        const auto start_index = metadata_mgr->FindCoveringBlockIndex(file_path, block_index, MAX_EXTENT_SHIFT);
+        if (start_index >= 0) {
+            metadata_mgr->RetainBlock(metadata_mgr->GetBlockId(file_path, start_index));
+        }
+    }
+}
+
 void Cache::StoreFileSize(const duckdb::string &file_path, int64_t file_size) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_cache->StoreFileSize(file_path, file_size);
+        return;
+    }
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
     metadata_mgr->SetFileSize(file_path, file_size);
     SetDirty(true);
+    EnforceMetadataBudget(file_path);
+    PublishChangesBatched();
 }
 
 void Cache::StoreFileLastModified(const duckdb::string &file_path, duckdb::timestamp_t timestamp) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_cache->StoreFileLastModified(file_path, timestamp);
+        return;
+    }
+    ValidateWritable();
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
     metadata_mgr->SetFileLastModified(file_path, timestamp);
     SetDirty(true);
+    EnforceMetadataBudget(file_path);
+    PublishChangesBatched();
 }
 
 bool Cache::RetrieveFileMetadata(const duckdb::string &file_path, MetadataManager::FileMetadata &file_metadata_out) {
     duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->RetrieveFileMetadata(file_path, file_metadata_out);
+    }
+    SharedAccess access(*this, FileLock::Mode::SHARED);
 
     return metadata_mgr->GetFileMetadata(file_path, file_metadata_out);
 }
 
-void Cache::SetMaxCacheSize(uint64_t new_max_cache_size_in_bytes) {
-    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
-
-    auto max_cache_size_in_blocks = NumBlocksFromSize(new_max_cache_size_in_bytes, block_size);
-
-    metadata_mgr->SetMaxCacheSize(max_cache_size_in_blocks);
-    metadata_mgr->EvictLRUBlockIfNeeded([&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); });
-    SetDirty(true);
+bool Cache::IsFileCached(const duckdb::string &file_path) {
+    MetadataManager::FileMetadata md;
+    if (!RetrieveFileMetadata(file_path, md)) {
+        return false;
+    }
+    const auto block_size = GetBlockSize();
+    uint64_t cached_bytes = 0;
+    for (auto &entry : md.blocks) {
+        cached_bytes += entry.second.GetLength(block_size);
+    }
+    return cached_bytes >= md.file_size;
+}
+
+void Cache::SetMaxCacheSize(uint64_t new_max_cache_size_in_bytes) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        // Passed on even if unchanged with auto-sizing, the shared cache derives its size again
+        if (new_max_cache_size_in_bytes != handle_settings.max_cache_size || handle_settings.auto_size_enabled) {
+            handle_settings.max_cache_size = new_max_cache_size_in_bytes;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (!auto_size_enabled && new_max_cache_size_in_bytes == metadata_mgr->GetMaxCacheSize()) {
+        // Nothing to evict, files opened with the same settings don't take the lock
+        return;
+    }
+    if (read_only) {
+        // Nothing is evicted from a read-only cache
+        metadata_mgr->SetMaxCacheSize(new_max_cache_size_in_bytes);
+        return;
+    }
+
+    auto max_cache_size = new_max_cache_size_in_bytes;
+    if (auto_size_enabled && opened) {
+        const auto now = std::chrono::steady_clock::now();
+        if (new_max_cache_size_in_bytes == configured_max_cache_size && now - auto_size_updated < AUTO_SIZE_INTERVAL) {
+            return;
+        }
+        auto_size_updated = now;
+        max_cache_size = ComputeAutoSize(new_max_cache_size_in_bytes);
+    }
+    configured_max_cache_size = new_max_cache_size_in_bytes;
+
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    metadata_mgr->SetMaxCacheSize(max_cache_size);
+    if (evictor) {
+        // Shrinking a large cache takes a while, the evictor does it in batches
+        evictor->Notify();
+        return;
+    }
+    if (metadata_mgr->EvictLRUBlockIfNeeded([&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); })) {
+        SetDirty(true);
+        PublishChanges();
+    }
+}
+
+uint64_t Cache::GetMaxCacheSize() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetMaxCacheSize();
+    }
+    return metadata_mgr->GetMaxCacheSize();
+}
+
+void Cache::SetAutoSize(bool enabled, uint64_t min_size, uint64_t reserved_free_percent) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        if (enabled != handle_settings.auto_size_enabled || min_size != handle_settings.auto_size_min ||
+            reserved_free_percent != handle_settings.auto_size_reserved_percent) {
+            handle_settings.auto_size_enabled = enabled;
+            handle_settings.auto_size_min = min_size;
+            handle_settings.auto_size_reserved_percent = reserved_free_percent;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (enabled == auto_size_enabled && min_size == auto_size_min && reserved_free_percent == auto_size_reserved_percent) {
+        return;
+    }
+    auto_size_enabled = enabled;
+    auto_size_min = min_size;
+    auto_size_reserved_percent = reserved_free_percent;
+    // Derived (or taken as set) again with the next max cache size
+    auto_size_updated = std::chrono::steady_clock::time_point{};
+    configured_max_cache_size = 0;
+}
+
+uint64_t Cache::ComputeAutoSize(uint64_t max_size) const {
+    uint64_t total_bytes = 0;
+    uint64_t available_bytes = 0;
+    if (!GetVolumeSpace(path, total_bytes, available_bytes)) {
+        return max_size;
+    }
+    // The cached blocks are on the volume already, the free space beyond the reserve is added to them
+    const auto reserved_bytes = total_bytes / 100 * auto_size_reserved_percent;
+    const auto cached_bytes = metadata_mgr->GetCachedBytes();
+    const auto size = cached_bytes + available_bytes > reserved_bytes ? cached_bytes + available_bytes - reserved_bytes : 0;
+    return std::min(std::max(size, auto_size_min), max_size);
+}
+
+void Cache::SetQuotas(const duckdb::vector<MetadataManager::Quota> &quotas) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        if (quotas != handle_settings.quotas) {
+            handle_settings.quotas = quotas;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (quotas == metadata_mgr->GetQuotas()) {
+        return;
+    }
+    if (read_only) {
+        metadata_mgr->SetQuotas(quotas);
+        return;
+    }
+
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+
+    metadata_mgr->SetQuotas(quotas);
+    if (metadata_mgr->EvictLRUBlockIfNeeded([&](block_id_t block_id) { block_mgr->MarkBlockAsFree(block_id); })) {
+        SetDirty(true);
+        PublishChanges();
+    }
+}
+
+duckdb::vector<MetadataManager::GroupUsage> Cache::GetGroupUsage() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetGroupUsage();
+    }
+    return metadata_mgr->GetGroupUsage();
+}
+
+duckdb::vector<duckdb::string> Cache::GetFilePaths() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetFilePaths();
+    }
+    return metadata_mgr->GetFilePaths();
+}
+
+void Cache::SetBlockSize(uint64_t new_block_size) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+
+    BlockManager::ValidateBlockSize(new_block_size);
+    block_size_set = true;
+    if (shared_cache) {
+        block_size = new_block_size;
+        block_shift = BlockManager::GetBlockShift(new_block_size);
+        shared_cache->SetBlockSize(new_block_size);
+        return;
+    }
+    if (new_block_size == block_size) {
+        return;
+    }
+
+    if (!IsOpen()) {
+        ResetBlockSize(new_block_size);
+        return;
+    }
+
+    // Reopening the cache file migrates it to the new block size
+    const auto cache_path = path;
+    Close();
+    ResetBlockSize(new_block_size);
+    Open(cache_path);
+}
+
+void Cache::SetStorageLayout(StorageLayout layout) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    storage_layout = layout;
+    if (shared_cache) {
+        shared_cache->SetStorageLayout(layout);
+        return;
+    }
+    block_mgr->SetLayout(layout);
+}
+
+StorageLayout Cache::GetStorageLayout() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetStorageLayout();
+    }
+    return block_mgr->GetLayout();
+}
+
+void Cache::SetSharedAccessEnabled(bool enabled) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_access_enabled = enabled;
+        shared_cache->SetSharedAccessEnabled(enabled);
+        return;
+    }
+    if (enabled == shared_access_enabled) {
+        return;
+    }
+    if (!IsOpen()) {
+        shared_access_enabled = enabled;
+        return;
+    }
+
+    const auto cache_path = path;
+    Close();
+    shared_access_enabled = enabled;
+    Open(cache_path);
+}
+
+void Cache::SetReadOnly(bool enabled) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (enabled == read_only) {
+        return;
+    }
+    if (!IsOpen()) {
+        read_only = enabled;
+        return;
+    }
+
+    const auto cache_path = path;
+    Close();
+    read_only = enabled;
+    Open(cache_path);
+}
+
+bool Cache::IsReadOnly() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    return read_only;
+}
+
+void Cache::SetPageCacheDropEnabled(bool enabled) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        if (enabled != handle_settings.page_cache_drop_enabled) {
+            handle_settings.page_cache_drop_enabled = enabled;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (enabled == page_cache_drop_enabled) {
+        return;
+    }
+    page_cache_drop_enabled = enabled;
+    block_mgr->SetPageCacheDropEnabled(enabled);
+}
+
+void Cache::DropReadPages() {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        shared_cache->DropReadPages();
+        return;
+    }
+    if (page_cache_drop_enabled && block_mgr) {
+        block_mgr->FlushPageCacheDrops();
+    }
+}
+
+bool Cache::IsPageCacheDropEnabled() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->IsPageCacheDropEnabled();
+    }
+    return page_cache_drop_enabled;
+}
+
+bool Cache::IsSharedAccessEnabled() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->IsSharedAccessEnabled();
+    }
+    return shared_access_enabled;
+}
+
+uint64_t Cache::GetCachedBytes() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetCachedBytes();
+    }
+    return metadata_mgr->GetCachedBytes();
+}
+
+void Cache::SetMetadataBudget(uint64_t budget_bytes) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (IsSharedHandle()) {
+        if (budget_bytes != handle_settings.metadata_budget) {
+            handle_settings.metadata_budget = budget_bytes;
+            RequestHandleSettings();
+        }
+        return;
+    }
+    if (budget_bytes == metadata_budget) {
+        return;
+    }
+    metadata_budget = budget_bytes;
+    if (!opened || read_only) {
+        return;
+    }
+
+    SharedAccess access(*this, FileLock::Mode::EXCLUSIVE);
+    EnforceMetadataBudget("");
+    PublishChanges();
+}
+
+uint64_t Cache::GetMetadataBudget() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetMetadataBudget();
+    }
+    return metadata_budget;
+}
+
+uint64_t Cache::GetMetadataBytes() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetMetadataBytes();
+    }
+    return metadata_mgr->GetMetadataBytes();
+}
+
+idx_t Cache::GetFileCount() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (shared_cache) {
+        return shared_cache->GetFileCount();
+    }
+    return metadata_mgr->GetFileCount();
+}
+
+void Cache::SetDeduplicationEnabled(bool enabled) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    deduplication_enabled = enabled;
+    if (epoch) {
+        epoch->SetDeduplicationEnabled(enabled);
+    }
+}
+
+bool Cache::IsDeduplicationEnabled() const {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    return deduplication_enabled;
+}
+
+void Cache::SetPackThreshold(uint64_t new_pack_threshold) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    pack_threshold = new_pack_threshold;
+    if (epoch) {
+        epoch->SetPackThreshold(new_pack_threshold);
+    }
+}
+
+bool Cache::TryStoreDeduplicatedBlock(const duckdb::string &file_path, int64_t block_index,
+                                      const duckdb::vector<uint8_t> &data, uint64_t checksum) {
+    MetadataManager::FileMetadataBlockInfo shared_block;
+    if (!metadata_mgr->FindBlockByChecksum(checksum, file_path, shared_block)) {
+        return false;
+    }
+
+    // Checksums may collide, compare the stored content byte by byte
+    const idx_t stored_length = shared_block.GetLength(block_size);
+    if (stored_length != data.size()) {
+        return false;
+    }
+    duckdb::vector<uint8_t> stored_data(stored_length);
+    block_mgr->RetrieveBlockRange(shared_block.block_id, shared_block.offset, stored_data.data(), stored_length);
+    if (!std::equal(data.begin(), data.end(), stored_data.begin())) {
+        return false;
+    }
+
+    block_mgr->AddBlockRef(shared_block.block_id);
+    metadata_mgr->RegisterBlock(file_path, block_index, shared_block.block_id, checksum, shared_block.offset,
+                                shared_block.length);
+    metadata_mgr->UpdateLRUOrder(shared_block.block_id);
+    return true;
+}
+
+void Cache::StorePackedBlock(const duckdb::string &file_path, int64_t block_index, const duckdb::vector<uint8_t> &data,
+                             uint64_t checksum) {
+    uint64_t slab_end = 0;
+    block_id_t slab_id = metadata_mgr->GetOpenSlab(slab_end);
+
+    if (slab_id == BlockManager::INVALID_BLOCK_ID || slab_end + data.size() > block_size ||
+        metadata_mgr->FileHasBlock(file_path, slab_id)) {
+        // Start a new slab block, the space left in the previous one is reclaimed when its last packed block is gone
+        slab_id = block_mgr->AllocBlock();
+        slab_end = 0;
+    } else {
+        block_mgr->AddBlockRef(slab_id);
+    }
+    metadata_mgr->RegisterBlock(file_path, block_index, slab_id, checksum, slab_end, data.size());
+    metadata_mgr->SetOpenSlab(slab_id, slab_end + data.size());
+    metadata_mgr->UpdateLRUOrder(slab_id);
+
+    // Evict LRU blocks if needed, appending to a slab grows the cache as well
+    EvictAfterStore(slab_id);
+
+    block_mgr->StoreBlockRange(slab_id, slab_end, data.data(), data.size());
+}
+
+void Cache::ValidateExtent(int64_t block_index, idx_t num_blocks) const {
+    const auto extent_shift = BlockManager::GetBlockShift(duckdb::NextPowerOfTwo(num_blocks));
+    if (extent_shift > MAX_EXTENT_SHIFT) {
+        throw duckdb::InvalidInputException("Block data can't span more than %llu blocks, got %llu",
+                                            uint64_t(1) << MAX_EXTENT_SHIFT, num_blocks);
+    }
+    if ((block_index & ((int64_t(1) << extent_shift) - 1)) != 0) {
+        throw duckdb::InvalidInputException("Block data spanning %llu blocks must start at a block index aligned to %llu",
+                                            num_blocks, uint64_t(1) << extent_shift);
+    }
+}
+
+void Cache::ValidateWritable() const {
+    if (read_only && opened) {
+        throw duckdb::IOException("Cache \"%s\" is opened read-only", path);
+    }
+}
+
+void Cache::OpenReadOnly(const duckdb::string &open_path) {
+    BlockCacheDataFileHeader existing_header;
+    if (!BlockManager::TryReadHeader(open_path, existing_header)) {
+        throw duckdb::IOException("Read-only cache file \"%s\" doesn't exist", open_path);
+    }
+    // A read-only file can't be migrated, it's used with the block size it was written with
+    if (existing_header.block_size != block_size) {
+        ResetBlockSize(existing_header.block_size);
+    }
+
+    auto header = block_mgr->LoadExistingDatabase(open_path, nullptr, true);
+    MetadataReader reader(*block_mgr, block_mgr->GetMetaBlockID());
+    metadata_mgr->ReadMetadata(reader, header.version);
+    RestoreBlockState();
+
+    path = open_path;
+    opened = true;
+    StartWarmup();
+}
+
+void Cache::ResetBlockSize(uint64_t new_block_size) {
+    D_ASSERT(!opened);
+    block_size = new_block_size;
+    block_shift = BlockManager::GetBlockShift(new_block_size);
+    block_mgr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{new_block_size, storage_layout});
+    block_mgr->SetPageCacheDropEnabled(page_cache_drop_enabled);
+    metadata_mgr->SetBlockSize(new_block_size);
+}
+
+void Cache::MigrateBlockSize(const duckdb::string &cache_path, uint64_t stored_block_size) {
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    const auto migrated_path = cache_path + ".migrate";
+    if (local_fs->FileExists(migrated_path)) {
+        // Leftover of an interrupted migration
+        local_fs->RemoveFile(migrated_path);
+    }
+
+    {
+        Cache source(stored_block_size);
+        source.Open(cache_path);
+        Cache target(block_size);
+        target.SetStorageLayout(storage_layout);
+        target.Open(migrated_path);
+        target.SetPackThreshold(pack_threshold);
+        target.SetDeduplicationEnabled(deduplication_enabled);
+
+        const uint8_t source_shift = source.GetBlockShift();
+        duckdb::vector<uint8_t> source_data(stored_block_size);
+        duckdb::vector<uint8_t> target_data;
+
+        for (const auto &file_path : source.metadata_mgr->GetFilePaths()) {
+            MetadataManager::FileMetadata md;
+            source.metadata_mgr->GetFileMetadata(file_path, md);
+            target.StoreFileSize(file_path, md.file_size);
+            target.StoreFileLastModified(file_path, md.last_modified);
+            if (md.file_size <= 0) {
+                continue;
+            }
+
+            // A new block is kept only if all the old blocks (or extents) it is made of are cached
+            const auto file_size = static_cast<uint64_t>(md.file_size);
+            const auto num_target_blocks = (file_size + block_size - 1) >> block_shift;
+            for (uint64_t target_index = 0; target_index < num_target_blocks; ++target_index) {
+                const uint64_t begin = target_index << block_shift;
+                const uint64_t end = std::min(begin + block_size, file_size);
+
+                target_data.resize(end - begin);
+                bool covered = true;
+                uint64_t position = begin;
+                while (position < end) {
+                    int64_t source_index = 0;
+                    source_data.resize(stored_block_size);
+                    if (!source.RetrieveCoveringBlock(file_path, position >> source_shift, source_index, source_data)) {
+                        covered = false;
+                        break;
+                    }
+                    const uint64_t source_begin = static_cast<uint64_t>(source_index) << source_shift;
+                    const uint64_t source_end = source_begin + source_data.size();
+                    if (source_end <= position) {
+                        // Old block holds fewer bytes than the file size implies
+                        covered = false;
+                        break;
+                    }
+                    const uint64_t copy_end = std::min(end, source_end);
+                    std::copy(source_data.begin() + (position - source_begin), source_data.begin() + (copy_end - source_begin),
+                              target_data.begin() + (position - begin));
+                    position = copy_end;
+                }
+                if (covered) {
+                    target.StoreBlock(file_path, static_cast<int64_t>(target_index), target_data);
+                }
+            }
+        }
+
+        target.Close();
+        source.Close();
+    }
+
+    local_fs->MoveFile(migrated_path, cache_path);
+}
+
+Cache::SharedAccess::SharedAccess(Cache &cache, FileLock::Mode mode)
+    : cache(cache), active(cache.shared_access_enabled && cache.file_lock) {
+    if (!active) {
+        return;
+    }
+    if (cache.file_lock_depth++ == 0) {
+        try {
+            cache.file_lock->Lock(mode);
+            cache.ReloadIfChanged();
+        } catch (...) {
+            if (--cache.file_lock_depth == 0) {
+                cache.file_lock->Unlock();
+            }
+            throw;
+        }
+    }
+}
+
+Cache::SharedAccess::~SharedAccess() {
+    if (active && --cache.file_lock_depth == 0) {
+        cache.file_lock->Unlock();
+    }
+}
+
+void Cache::ReloadIfChanged() {
+    if (!opened || block_mgr->ReadStoredGeneration() == block_mgr->GetGeneration()) {
+        return;
+    }
+
+    auto header = block_mgr->Reload();
+    MetadataReader reader(*block_mgr, block_mgr->GetMetaBlockID());
+    metadata_mgr->ReadMetadata(reader, header.version);
+    RestoreBlockState();
+    SetDirty(false);
+}
+
+void Cache::RestoreBlockState() {
+    // Restore owner counts of the blocks shared between files
+    for (const auto &[block_id, ref_count] : metadata_mgr->GetSharedBlocks()) {
+        for (idx_t i = 1; i < ref_count; ++i) {
+            block_mgr->AddBlockRef(block_id);
+        }
+    }
+    // Restore extents spanning several blocks
+    for (const auto &[block_id, block_count] : metadata_mgr->GetExtents()) {
+        block_mgr->RegisterExtent(block_id, block_count);
+    }
+}
+
+void Cache::PublishChanges() {
+    if (shared_access_enabled) {
+        Flush();
+    }
+}
+
+void Cache::PublishChangesBatched() {
+    if (!shared_access_enabled) {
+        return;
+    }
+    if (++unpublished_changes >= PUBLISH_BATCH_SIZE ||
+        std::chrono::steady_clock::now() - last_published >= PUBLISH_INTERVAL) {
+        Flush();
+    }
+}
+
+void Cache::ApplyDeferredLRUUpdates() {
+    for (const auto &key : deferred_lru_updates) {
+        // The block may have been evicted since, by this or another process
+        const auto block_id = metadata_mgr->GetBlockId(key.file_path, key.block_index);
+        if (block_id != BlockManager::INVALID_BLOCK_ID) {
+            metadata_mgr->UpdateLRUOrder(block_id);
+            SetDirty(true);
+        }
+    }
+    deferred_lru_updates.clear();
 }
 
 void Cache::AddRef() {
     current_cache_users.fetch_add(1, std::memory_order_acq_rel);
+    if (shared_cache) {
+        shared_cache->AddRef();
+    }
 };
 void Cache::RemoveRef() {
     current_cache_users.fetch_sub(1, std::memory_order_acq_rel);
+    if (shared_cache) {
+        shared_cache->RemoveRef();
+    }
 };
 
+duckdb::shared_ptr<Cache> Cache::PinEpoch() {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (!shared_cache) {
+        return nullptr;
+    }
+    if (!epoch) {
+        // A handle of the same shared cache, it keeps the storage acquired from the registry until it's dropped
+        epoch = duckdb::make_shared_ptr<Cache>(block_size, nullptr, nullptr, registry);
+        epoch->is_epoch = true;
+        epoch->deduplication_enabled = deduplication_enabled;
+        epoch->pack_threshold = pack_threshold;
+        epoch->shared_access_enabled = shared_access_enabled;
+        epoch->storage_layout = storage_layout;
+        epoch->Open(path);
+    }
+    return epoch;
+}
+
+void Cache::RequestHandleSettings() {
+    if (shared_cache && !is_epoch) {
+        shared_cache->SetHandleSettings(*this, handle_settings);
+    }
+}
+
+void Cache::SetHandleSettings(const Cache &handle, const HandleSettings &settings) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    handles_settings[&handle] = settings;
+    ApplyHandleSettings();
+}
+
+void Cache::DropHandleSettings(const Cache &handle) {
+    duckdb::lock_guard<std::recursive_mutex> lock{cache_mutex};
+    if (handles_settings.erase(&handle) != 0) {
+        ApplyHandleSettings();
+    }
+}
+
+void Cache::ApplyHandleSettings() {
+    if (handles_settings.empty()) {
+        // The last handle closed it, it keeps its settings
+        return;
+    }
+
+    // No handle gets less than it asked for, see the constructor
+    auto merged = handles_settings.begin()->second;
+    merged.background_eviction_enabled = false;
+    merged.eviction_low_watermark = 0;
+    merged.eviction_high_watermark = 0;
+    for (const auto &entry : handles_settings) {
+        const auto &settings = entry.second;
+        merged.max_cache_size = std::max(merged.max_cache_size, settings.max_cache_size);
+        merged.auto_size_enabled = merged.auto_size_enabled && settings.auto_size_enabled;
+        merged.auto_size_min = std::max(merged.auto_size_min, settings.auto_size_min);
+        merged.auto_size_reserved_percent = std::min(merged.auto_size_reserved_percent, settings.auto_size_reserved_percent);
+        if (settings.background_eviction_enabled) {
+            merged.background_eviction_enabled = true;
+            merged.eviction_low_watermark = std::max(merged.eviction_low_watermark, settings.eviction_low_watermark);
+            merged.eviction_high_watermark = std::max(merged.eviction_high_watermark, settings.eviction_high_watermark);
+        }
+        // 0 doesn't bound the metadata
+        merged.metadata_budget = merged.metadata_budget == 0 || settings.metadata_budget == 0
+                                     ? 0 : std::max(merged.metadata_budget, settings.metadata_budget);
+        merged.page_cache_drop_enabled = merged.page_cache_drop_enabled && settings.page_cache_drop_enabled;
+        merged.warmup_size = std::max(merged.warmup_size, settings.warmup_size);
+    }
+    if (!merged.background_eviction_enabled) {
+        merged.eviction_high_watermark = 100;
+    }
+    duckdb::vector<MetadataManager::Quota> quotas;
+    for (const auto &quota : merged.quotas) {
+        auto merged_quota = quota;
+        bool limited_by_all = true;
+        for (const auto &entry : handles_settings) {
+            const auto &handle_quotas = entry.second.quotas;
+            const auto it = std::find_if(handle_quotas.begin(), handle_quotas.end(),
+                                         [&](const MetadataManager::Quota &other) { return other.prefix == quota.prefix; });
+            if (it == handle_quotas.end()) {
+                limited_by_all = false;
+                break;
+            }
+            if (it->GetLimit(merged.max_cache_size) > merged_quota.GetLimit(merged.max_cache_size)) {
+                merged_quota = *it;
+            }
+        }
+        if (limited_by_all) {
+            quotas.push_back(merged_quota);
+        }
+    }
+
+    // Each setter applies its setting only if it changed. Background eviction is started first, so shrinking the
+    // cache is left to the evictor.
+    SetAutoSize(merged.auto_size_enabled, merged.auto_size_min, merged.auto_size_reserved_percent);
+    SetBackgroundEviction(merged.background_eviction_enabled, merged.eviction_low_watermark,
+                          merged.eviction_high_watermark);
+    SetMaxCacheSize(merged.max_cache_size);
+    SetMetadataBudget(merged.metadata_budget);
+    SetPageCacheDropEnabled(merged.page_cache_drop_enabled);
+    SetWarmupSize(merged.warmup_size);
+    SetQuotas(quotas);
+}
+
 bool Cache::IsDirty() const { 
     return dirty; 
 }
@@ -0,0 +1,280 @@
+#include "cache_bundle.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <duckdb/common/serializer/buffered_file_reader.hpp>
+#include <duckdb/common/serializer/buffered_file_writer.hpp>
+
+#include "cache.hpp"
+
+namespace quackstore {
+
+namespace {
+
+enum class BundleTag : uint8_t {
+    END = 0,
+    FILE = 1,
+    RANGE = 2
+};
+
+void WriteString(duckdb::WriteStream &writer, const duckdb::string &value) {
+    writer.Write<uint32_t>(static_cast<uint32_t>(value.size()));
+    writer.WriteData(duckdb::const_data_ptr_cast(value.data()), value.size());
+}
+
+//! Lengths read from a bundle are checked against the bytes left in it, a corrupted length mustn't be allocated
+void CheckLength(duckdb::BufferedFileReader &reader, uint64_t length, const duckdb::string &bundle_path) {
+    if (length > reader.FileSize() - reader.CurrentOffset()) {
+        throw duckdb::IOException("Cache bundle \"%s\" is corrupted", bundle_path);
+    }
+}
+
+duckdb::string ReadString(duckdb::BufferedFileReader &reader, const duckdb::string &bundle_path) {
+    const auto size = reader.Read<uint32_t>();
+    CheckLength(reader, size, bundle_path);
+    duckdb::string value(size, '\0');
+    reader.ReadData(duckdb::data_ptr_cast(&value[0]), size);
+    return value;
+}
+
+//! Files are cached under their quackstore:// path, the prefix may be given with or without it
+bool MatchesPrefix(const duckdb::string &file_path, const duckdb::string &prefix) {
+    static const duckdb::string SCHEMA_PREFIX = "quackstore://";
+    if (file_path.rfind(prefix, 0) == 0) {
+        return true;
+    }
+    return file_path.rfind(SCHEMA_PREFIX, 0) == 0 && file_path.compare(SCHEMA_PREFIX.size(), prefix.size(), prefix) == 0;
+}
+
+//! Collects the contiguous byte ranges of an imported file and stores them as blocks and extents of the cache.
+class RangeImporter {
+public:
+    RangeImporter(Cache &cache, const duckdb::string &file_path, uint64_t file_size, CacheBundle::Stats &stats)
+        : cache(cache), file_path(file_path), file_size(file_size), stats(stats),
+          block_size(cache.GetBlockSize()), block_shift(cache.GetBlockShift()) {
+        // Blocks already cached are kept
+        MetadataManager::FileMetadata md;
+        if (cache.RetrieveFileMetadata(file_path, md)) {
+            for (const auto &[block_id, block_info] : md.blocks) {
+                const auto num_blocks = (block_info.GetLength(block_size) + block_size - 1) >> block_shift;
+                for (idx_t i = 0; i < num_blocks; ++i) {
+                    cached_indices.insert(block_info.block_index + static_cast<int64_t>(i));
+                }
+            }
+        }
+    }
+
+    void AddRange(uint64_t offset, duckdb::vector<uint8_t> &data) {
+        if (offset != run_start + run.size()) {
+            Flush(true);
+            run_start = offset;
+        }
+        run.insert(run.end(), data.begin(), data.end());
+        Flush(false);
+    }
+
+    //! Store the whole blocks of the run, partial blocks at its edges are dropped once no more data follows.
+    void Flush(bool final) {
+        while (!run.empty()) {
+            if (run_start >= file_size) {
+                run.clear();
+                break;
+            }
+            const idx_t misalignment = run_start & (block_size - 1);
+            if (misalignment != 0) {
+                const idx_t skip = std::min<idx_t>(block_size - misalignment, run.size());
+                run.erase(run.begin(), run.begin() + skip);
+                run_start += skip;
+                continue;
+            }
+
+            // The largest extent aligned at the block index, smaller ones only when no more data follows
+            const int64_t block_index = static_cast<int64_t>(run_start >> block_shift);
+            uint8_t extent_shift = Cache::MAX_EXTENT_SHIFT;
+            while (extent_shift > 0 && (block_index & ((int64_t(1) << extent_shift) - 1)) != 0) {
+                --extent_shift;
+            }
+            idx_t piece = std::min<idx_t>(block_size << extent_shift, file_size - run_start);
+            if (run.size() < piece) {
+                if (!final) {
+                    break;
+                }
+                while (extent_shift > 0 && run.size() < piece) {
+                    --extent_shift;
+                    piece = std::min<idx_t>(block_size << extent_shift, file_size - run_start);
+                }
+                if (run.size() < piece) {
+                    run.clear();
+                    break;
+                }
+            }
+
+            bool cached = true;
+            const idx_t num_blocks = (piece + block_size - 1) >> block_shift;
+            for (idx_t i = 0; i < num_blocks && cached; ++i) {
+                cached = cached_indices.count(block_index + static_cast<int64_t>(i)) != 0;
+            }
+            if (!cached) {
+                duckdb::vector<uint8_t> data(run.begin(), run.begin() + piece);
+                cache.StoreBlock(file_path, block_index, data);
+                stats.blocks += num_blocks;
+                stats.bytes += piece;
+            }
+            run.erase(run.begin(), run.begin() + piece);
+            run_start += piece;
+        }
+    }
+
+private:
+    Cache &cache;
+    const duckdb::string &file_path;
+    const uint64_t file_size;
+    CacheBundle::Stats &stats;
+    const uint64_t block_size;
+    const uint8_t block_shift;
+    duckdb::unordered_set<int64_t> cached_indices;
+    //! Contiguous bytes of the file starting at run_start that are not stored yet
+    uint64_t run_start = 0;
+    duckdb::vector<uint8_t> run;
+};
+
+}  // namespace
+
+// =============================================================================
+// CacheBundle
+// =============================================================================
+
+CacheBundle::Stats CacheBundle::Export(duckdb::FileSystem &fs, const duckdb::string &bundle_path,
+                                       const duckdb::vector<duckdb::reference<Cache>> &caches,
+                                       const duckdb::string &prefix) {
+    Stats stats;
+    duckdb::BufferedFileWriter writer(fs, bundle_path);
+    writer.WriteData(duckdb::const_data_ptr_cast(MAGIC), strlen(MAGIC));
+    writer.Write<uint32_t>(VERSION);
+
+    duckdb::vector<uint8_t> data;
+    for (auto &cache_ref : caches) {
+        auto &cache = cache_ref.get();
+        if (!cache.IsOpen()) {
+            continue;
+        }
+        const auto block_size = cache.GetBlockSize();
+        const auto block_shift = cache.GetBlockShift();
+
+        for (const auto &file_path : cache.GetFilePaths()) {
+            MetadataManager::FileMetadata md;
+            if (!MatchesPrefix(file_path, prefix) || !cache.RetrieveFileMetadata(file_path, md)) {
+                continue;
+            }
+            writer.Write<uint8_t>(static_cast<uint8_t>(BundleTag::FILE));
+            WriteString(writer, file_path);
+            writer.Write<uint64_t>(md.file_size);
+            writer.Write<int64_t>(md.last_modified.value);
+
+            duckdb::vector<int64_t> block_indices;
+            for (const auto &[block_id, block_info] : md.blocks) {
+                block_indices.push_back(block_info.block_index);
+            }
+            std::sort(block_indices.begin(), block_indices.end());
+            for (auto block_index : block_indices) {
+                // Blocks evicted or found corrupted in the meantime are left out
+                data.resize(block_size);
+                if (!cache.RetrieveBlock(file_path, block_index, data)) {
+                    continue;
+                }
+                // Tails written by older versions are padded to the block size
+                const uint64_t offset = static_cast<uint64_t>(block_index) << block_shift;
+                const uint64_t length = offset < md.file_size ? std::min<uint64_t>(data.size(), md.file_size - offset) : 0;
+                if (length == 0) {
+                    continue;
+                }
+                writer.Write<uint8_t>(static_cast<uint8_t>(BundleTag::RANGE));
+                writer.Write<uint64_t>(offset);
+                writer.Write<uint64_t>(length);
+                writer.WriteData(data.data(), length);
+                stats.blocks += (length + block_size - 1) >> block_shift;
+                stats.bytes += length;
+            }
+            writer.Write<uint8_t>(static_cast<uint8_t>(BundleTag::END));
+            ++stats.files;
+        }
+    }
+    writer.Write<uint8_t>(static_cast<uint8_t>(BundleTag::END));
+    writer.Sync();
+    writer.Close();
+    return stats;
+}
+
+CacheBundle::Stats CacheBundle::Import(duckdb::FileSystem &fs, const duckdb::string &bundle_path,
+                                       const std::function<Cache &(const duckdb::string &)> &route) {
+    Stats stats;
+    duckdb::BufferedFileReader reader(fs, bundle_path.c_str());
+
+    char magic[8];
+    reader.ReadData(duckdb::data_ptr_cast(magic), sizeof(magic));
+    if (memcmp(magic, MAGIC, sizeof(magic)) != 0) {
+        throw duckdb::IOException("\"%s\" is not a cache bundle", bundle_path);
+    }
+    const auto version = reader.Read<uint32_t>();
+    if (version > VERSION) {
+        throw duckdb::IOException("Cache bundle \"%s\" has unsupported version %u", bundle_path, version);
+    }
+
+    duckdb::vector<uint8_t> data;
+    while (true) {
+        const auto tag = static_cast<BundleTag>(reader.Read<uint8_t>());
+        if (tag == BundleTag::END) {
+            break;
+        }
+        if (tag != BundleTag::FILE) {
+            throw duckdb::IOException("Cache bundle \"%s\" is corrupted", bundle_path);
+        }
+        const auto file_path = ReadString(reader, bundle_path);
+        const auto file_size = reader.Read<uint64_t>();
+        const duckdb::timestamp_t last_modified{reader.Read<int64_t>()};
+
+        // Only the newer version of a file is kept
+        auto &cache = route(file_path);
+        bool import_file = true;
+        MetadataManager::FileMetadata md;
+        if (cache.RetrieveFileMetadata(file_path, md) &&
+            (md.file_size != file_size || md.last_modified != last_modified)) {
+            if (last_modified > md.last_modified) {
+                cache.Evict(file_path);
+            } else {
+                import_file = false;
+                ++stats.skipped_files;
+            }
+        }
+        if (import_file) {
+            cache.StoreFileSize(file_path, file_size);
+            cache.StoreFileLastModified(file_path, last_modified);
+            ++stats.files;
+        }
+
+        RangeImporter importer(cache, file_path, file_size, stats);
+        while (true) {
+            const auto range_tag = static_cast<BundleTag>(reader.Read<uint8_t>());
+            if (range_tag == BundleTag::END) {
+                break;
+            }
+            if (range_tag != BundleTag::RANGE) {
+                throw duckdb::IOException("Cache bundle \"%s\" is corrupted", bundle_path);
+            }
+            const auto offset = reader.Read<uint64_t>();
+            const auto length = reader.Read<uint64_t>();
+            CheckLength(reader, length, bundle_path);
+            data.resize(length);
+            reader.ReadData(data.data(), length);
+            if (import_file) {
+                importer.AddRange(offset, data);
+            }
+        }
+        if (import_file) {
+            importer.Flush(true);
+        }
+    }
+    return stats;
+}
+
+}  // namespace quackstore
@@ -0,0 +1,100 @@
+#include "cache_registry.hpp"
+
+#include <cstdlib>
+
+#include "cache.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// CacheRegistry
+// =============================================================================
+
+CacheRegistry &CacheRegistry::Get() {
+    static CacheRegistry registry;
+    return registry;
+}
+
+duckdb::shared_ptr<Cache> CacheRegistry::Acquire(const duckdb::string &path, uint64_t block_size,
+                                                 bool migrate_block_size, bool shared_access, StorageLayout layout) {
+    const auto key = CanonicalPath(path);
+
+    duckdb::lock_guard<std::mutex> lock{registry_mutex};
+    auto it = caches.find(key);
+    if (it == caches.end()) {
+        auto cache = duckdb::make_shared_ptr<Cache>(block_size);
+        if (migrate_block_size) {
+            cache->SetBlockSize(block_size);
+        }
+        cache->SetSharedAccessEnabled(shared_access);
+        cache->SetStorageLayout(layout);
+        cache->Open(key);
+        it = caches.emplace(key, Entry{std::move(cache), 0}).first;
+    } else {
+        // The block size set by the user opening it last applies to the shared cache. The layout stays, it's only
+        // changed by setting it on a handle.
+        auto &cache = *it->second.cache;
+        if (migrate_block_size && cache.GetBlockSize() != block_size) {
+            cache.SetBlockSize(block_size);
+        }
+        if (shared_access && !cache.IsSharedAccessEnabled()) {
+            // Other processes can only be coordinated with if all users of the file take the lock, so it's never
+            // turned off while another user enabled it
+            cache.SetSharedAccessEnabled(true);
+        }
+    }
+    ++it->second.users;
+    return it->second.cache;
+}
+
+void CacheRegistry::Release(const duckdb::string &key) {
+    duckdb::lock_guard<std::mutex> lock{registry_mutex};
+    auto it = caches.find(key);
+    if (it == caches.end()) {
+        return;
+    }
+    if (--it->second.users == 0) {
+        // Closed while holding the registry lock, so the file is never opened again before it's flushed. The entry
+        // is gone even if closing fails.
+        auto cache = std::move(it->second.cache);
+        caches.erase(it);
+        cache->Close();
+    }
+}
+
+duckdb::string CacheRegistry::CanonicalPath(const duckdb::string &path) {
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    auto expanded = local_fs->ExpandPath(path);
+
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, expanded.c_str(), _MAX_PATH)) {
+        return resolved;
+    }
+    return expanded;
+#else
+    if (char *resolved = realpath(expanded.c_str(), nullptr)) {
+        duckdb::string result(resolved);
+        free(resolved);
+        return result;
+    }
+
+    // The cache file doesn't exist yet, resolve its directory
+    const auto separator = expanded.find_last_of('/');
+    const duckdb::string dir = separator == duckdb::string::npos ? "." : expanded.substr(0, separator == 0 ? 1 : separator);
+    const duckdb::string name = separator == duckdb::string::npos ? expanded : expanded.substr(separator + 1);
+    if (char *resolved = realpath(dir.c_str(), nullptr)) {
+        duckdb::string result(resolved);
+        free(resolved);
+        return result.back() == '/' ? result + name : result + "/" + name;
+    }
+    return expanded;
+#endif
+}
+
+idx_t CacheRegistry::GetCacheCount() const {
+    duckdb::lock_guard<std::mutex> lock{registry_mutex};
+    return caches.size();
+}
+
+}  // namespace quackstore
@@ -0,0 +1,148 @@
+#include "cache_router.hpp"
+
+#include <algorithm>
+
+#include "cache.hpp"
+#include "quackstore_filesystem.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// CacheRouter
+// =============================================================================
+
+CacheRouter::CacheRouter(Cache &default_cache, duckdb::optional_ptr<CacheRegistry> registry)
+    : default_cache(default_cache), registry(registry) {
+}
+
+CacheRouter::~CacheRouter() = default;
+
+Cache &CacheRouter::Route(const duckdb::string &file_path, const ExtensionParams &params) {
+    auto route = FindRoute(file_path, params);
+    if (!route) {
+        if (!default_cache.IsOpen()) {
+            // Storage settings are applied when the cache is opened, changes of an open cache are done by the settings
+            if (params.block_size != 0) {
+                default_cache.SetBlockSize(params.block_size);
+            }
+            default_cache.SetSharedAccessEnabled(params.shared_cache);
+            default_cache.SetStorageLayout(params.storage_layout);
+            default_cache.Open(params.cache_path);
+        }
+
+        // Settings changed at startup don't run their callbacks, they are taken on with the next file opened. The
+        // cache applies only the settings that changed, so opening files with the same settings takes no lock.
+        default_cache.SetAutoSize(params.cache_size_auto, params.min_cache_size, params.reserved_free_percent);
+        // Started first, so shrinking the cache is left to the evictor
+        default_cache.SetBackgroundEviction(params.background_eviction, params.eviction_low_watermark,
+                                            params.eviction_high_watermark);
+        default_cache.SetMaxCacheSize(params.max_cache_size);
+        default_cache.SetMetadataBudget(params.metadata_budget);
+        default_cache.SetDeduplicationEnabled(params.dedup_enabled);
+        default_cache.SetPackThreshold(params.pack_threshold);
+        default_cache.SetPageCacheDropEnabled(params.backing_tier);
+        default_cache.SetWarmupSize(params.warmup_size);
+        default_cache.SetQuotas(params.quotas);
+        return default_cache;
+    }
+
+    duckdb::lock_guard<std::mutex> lock{router_mutex};
+    auto &cache = GetNamedCache(*route);
+    if (cache.IsOpen() && cache.GetPath() != route->path) {
+        cache.Close();
+    }
+    if (!cache.IsOpen()) {
+        if (route->block_size != 0) {
+            cache.SetBlockSize(route->block_size);
+        }
+        cache.SetSharedAccessEnabled(params.shared_cache);
+        cache.SetStorageLayout(params.storage_layout);
+        cache.Open(route->path);
+    }
+
+    cache.SetAutoSize(params.cache_size_auto, params.min_cache_size, params.reserved_free_percent);
+    cache.SetBackgroundEviction(params.background_eviction, params.eviction_low_watermark, params.eviction_high_watermark);
+    cache.SetMaxCacheSize(route->max_cache_size);
+    cache.SetMetadataBudget(params.metadata_budget);
+    cache.SetDeduplicationEnabled(route->dedup_enabled);
+    cache.SetPackThreshold(params.pack_threshold);
+    cache.SetPageCacheDropEnabled(params.backing_tier);
+    cache.SetWarmupSize(params.warmup_size);
+    cache.SetQuotas(params.quotas);
+    return cache;
+}
+
+void CacheRouter::Configure(const duckdb::vector<NamedCacheConfig> &configs) {
+    duckdb::lock_guard<std::mutex> lock{router_mutex};
+    for (auto it = named_caches.begin(); it != named_caches.end();) {
+        auto config = std::find_if(configs.begin(), configs.end(),
+                                   [&](const NamedCacheConfig &candidate) { return candidate.name == it->first; });
+        if (config == configs.end()) {
+            it->second->Close();
+            it = named_caches.erase(it);
+            continue;
+        }
+        if (it->second->IsOpen() && it->second->GetPath() != config->path) {
+            it->second->Close();
+        }
+        ++it;
+    }
+}
+
+void CacheRouter::ForEachCache(const std::function<void(Cache &)> &func) {
+    func(default_cache);
+
+    duckdb::lock_guard<std::mutex> lock{router_mutex};
+    for (auto &[name, cache] : named_caches) {
+        func(*cache);
+    }
+}
+
+duckdb::shared_ptr<Cache> CacheRouter::GetLowerTier(const ExtensionParams &params) {
+    if (params.lower_cache_path.empty()) {
+        return nullptr;
+    }
+
+    duckdb::lock_guard<std::mutex> lock{router_mutex};
+    if (lower_tier && lower_tier->GetPath() != params.lower_cache_path) {
+        // Handles in flight keep the old lower tier until they are closed
+        lower_tier.reset();
+    }
+    if (!lower_tier) {
+        auto cache = duckdb::make_shared_ptr<Cache>(default_cache.GetBlockSize());
+        cache->SetReadOnly(true);
+        cache->Open(params.lower_cache_path);
+        lower_tier = std::move(cache);
+    }
+    return lower_tier;
+}
+
+void CacheRouter::CloseLowerTier() {
+    duckdb::lock_guard<std::mutex> lock{router_mutex};
+    lower_tier.reset();
+}
+
+duckdb::optional_ptr<const NamedCacheConfig> CacheRouter::FindRoute(const duckdb::string &file_path,
+                                                                    const ExtensionParams &params) {
+    const duckdb::string schema_prefix = QuackstoreFileSystem::SCHEMA_PREFIX;
+    const auto path = file_path.rfind(schema_prefix, 0) == 0 ? file_path.substr(schema_prefix.size()) : file_path;
+
+    duckdb::optional_ptr<const NamedCacheConfig> route;
+    for (const auto &config : params.caches) {
+        if (path.rfind(config.prefix, 0) == 0 && (!route || config.prefix.size() > route->prefix.size())) {
+            route = &config;
+        }
+    }
+    return route;
+}
+
+Cache &CacheRouter::GetNamedCache(const NamedCacheConfig &config) {
+    auto &cache = named_caches[config.name];
+    if (!cache) {
+        const auto block_size = config.block_size != 0 ? config.block_size : default_cache.GetBlockSize();
+        cache = duckdb::make_uniq<Cache>(block_size, nullptr, nullptr, registry);
+    }
+    return *cache;
+}
+
+}  // namespace quackstore
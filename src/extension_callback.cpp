@@ -3,19 +3,23 @@
 
 #include "extension_callback.hpp"
 #include "cache.hpp"
+#include "cache_router.hpp"
 #include "extension_state.hpp"
 
 namespace quackstore {
 
-ExtensionCallback::ExtensionCallback(duckdb::unique_ptr<Cache> in_cache) 
+ExtensionCallback::ExtensionCallback(duckdb::unique_ptr<Cache> in_cache, duckdb::unique_ptr<CacheRouter> in_router) 
 : cache(std::move(in_cache)) 
+, router(std::move(in_router))
 {}
 
+ExtensionCallback::~ExtensionCallback() = default;
+
 void ExtensionCallback::OnConnectionOpened(duckdb::ClientContext &context) 
 {
     auto& cache_ref = *cache;
 
-    context.registered_state->Insert(ExtensionState::EXTENSION_STATE_NAME, duckdb::make_shared_ptr<ExtensionState>(cache_ref));
+    context.registered_state->Insert(ExtensionState::EXTENSION_STATE_NAME, duckdb::make_shared_ptr<ExtensionState>(cache_ref, router.get()));
 }
 
 } // namespace quackstore
\ No newline at end of file
@@ -7,8 +7,9 @@ namespace quackstore {
 
 const duckdb::string ExtensionState::EXTENSION_STATE_NAME = "quackstore_extension_state";
 
-ExtensionState::ExtensionState(Cache& cache)
+ExtensionState::ExtensionState(Cache& cache, duckdb::optional_ptr<CacheRouter> router)
 : cache(cache) 
+, router(router)
 {}
 
 duckdb::shared_ptr<ExtensionState> ExtensionState::RetrieveFromContext(duckdb::ClientContext& context) {
@@ -19,4 +20,8 @@ Cache& ExtensionState::GetCache() const {
     return cache;
 }
 
+duckdb::optional_ptr<CacheRouter> ExtensionState::GetRouter() const {
+    return router;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "file_lock.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+#ifdef F_OFD_SETLKW
+    // Locks of the open file description: two locks of one process exclude each other as well, and closing another
+    // descriptor of the lock file doesn't release them
+    constexpr int SET_LOCK_WAIT = F_OFD_SETLKW;
+    constexpr int SET_LOCK = F_OFD_SETLK;
+#else
+    // Locks of the process: only other processes are excluded
+    constexpr int SET_LOCK_WAIT = F_SETLKW;
+    constexpr int SET_LOCK = F_SETLK;
+#endif
+}
+#endif
+
+namespace quackstore {
+
+// =============================================================================
+// FileLock
+// =============================================================================
+
+#ifdef _WIN32
+
+FileLock::FileLock(const duckdb::string &path) : path(path) {
+    handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw duckdb::IOException("Failed to open cache lock file: \"%s\"!", path);
+    }
+}
+
+FileLock::~FileLock() {
+    Unlock();
+    CloseHandle(static_cast<HANDLE>(handle));
+}
+
+void FileLock::Lock(Mode mode) {
+    OVERLAPPED overlapped = {};
+    DWORD flags = mode == Mode::EXCLUSIVE ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+    if (!LockFileEx(static_cast<HANDLE>(handle), flags, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+        throw duckdb::IOException("Failed to lock cache lock file: \"%s\"!", path);
+    }
+}
+
+void FileLock::Unlock() {
+    OVERLAPPED overlapped = {};
+    UnlockFileEx(static_cast<HANDLE>(handle), 0, MAXDWORD, MAXDWORD, &overlapped);
+}
+
+#else
+
+FileLock::FileLock(const duckdb::string &path) : path(path) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw duckdb::IOException("Failed to open cache lock file: \"%s\": %s", path, strerror(errno));
+    }
+}
+
+FileLock::~FileLock() {
+    Unlock();
+    close(fd);
+}
+
+void FileLock::Lock(Mode mode) {
+    struct flock fl = {};
+    fl.l_type = mode == Mode::EXCLUSIVE ? F_WRLCK : F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+    while (fcntl(fd, SET_LOCK_WAIT, &fl) == -1) {
+        if (errno != EINTR) {
+            throw duckdb::IOException("Failed to lock cache lock file: \"%s\": %s", path, strerror(errno));
+        }
+    }
+}
+
+void FileLock::Unlock() {
+    struct flock fl = {};
+    fl.l_type = F_UNLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+    fcntl(fd, SET_LOCK, &fl);
+}
+
+#endif
+
+}  // namespace quackstore
@@ -0,0 +1,221 @@
+#include "gzip_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "miniz.hpp"
+
+namespace quackstore {
+
+namespace {
+    constexpr idx_t INPUT_BUFFER_SIZE = Kilobytes(256ULL);
+    constexpr idx_t WINDOW_SIZE = TINFL_LZ_DICT_SIZE;
+
+    // Member header and trailer of RFC 1952
+    constexpr uint8_t GZIP_ID1 = 0x1F;
+    constexpr uint8_t GZIP_ID2 = 0x8B;
+    constexpr uint8_t GZIP_DEFLATE = 8;
+    constexpr uint8_t FLAG_HCRC = 0x02;
+    constexpr uint8_t FLAG_EXTRA = 0x04;
+    constexpr uint8_t FLAG_NAME = 0x08;
+    constexpr uint8_t FLAG_COMMENT = 0x10;
+    constexpr idx_t HEADER_SIZE = 10;
+    constexpr idx_t HEADER_CRC_SIZE = 2;
+    constexpr idx_t TRAILER_SIZE = 8;
+}
+
+// =============================================================================
+// GzipReader
+// =============================================================================
+
+//! Plain data, a checkpoint is a copy of it
+struct GzipReader::State {
+    duckdb_miniz::tinfl_decompressor decompressor;
+    //! The last 32KB of output the decompressor refers back to, written as a ring buffer
+    uint8_t window[WINDOW_SIZE];
+    idx_t window_pos = 0;
+};
+
+GzipReader::GzipReader(duckdb::unique_ptr<duckdb::FileHandle> compressed_handle, idx_t checkpoint_interval)
+    : handle(std::move(compressed_handle))
+    , compressed_size(static_cast<idx_t>(handle->GetFileSize()))
+    , checkpoint_interval(checkpoint_interval)
+    , input_buffer(INPUT_BUFFER_SIZE)
+    , state(duckdb::make_uniq<State>()) {
+    D_ASSERT(checkpoint_interval > 0);
+}
+
+GzipReader::~GzipReader() = default;
+
+idx_t GzipReader::Seek(idx_t offset) {
+    // From the closest checkpoint at or before the offset, unless the stream is closer already
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), offset,
+                               [](idx_t offset, const Checkpoint &checkpoint) { return offset < checkpoint.position; });
+    if (offset < position) {
+        if (it == checkpoints.begin()) {
+            Restart();
+        } else {
+            Restore(*std::prev(it));
+        }
+    } else if (it != checkpoints.begin() && std::prev(it)->position > position) {
+        Restore(*std::prev(it));
+    }
+    ReadOutput(nullptr, offset - position);
+    return position;
+}
+
+idx_t GzipReader::ReadOutput(duckdb::data_ptr_t out, idx_t size) {
+    idx_t total = 0;
+    while (total < size) {
+        if (output_available == 0) {
+            if (finished) {
+                break;
+            }
+            Inflate();
+            continue;
+        }
+        const auto count = std::min(output_available, size - total);
+        if (out) {
+            std::memcpy(out + total, state->window + output_start, count);
+        }
+        output_start += count;
+        output_available -= count;
+        position += count;
+        total += count;
+    }
+    return total;
+}
+
+void GzipReader::Inflate() {
+    if (!in_member && !StartMember()) {
+        finished = true;
+        return;
+    }
+    // All output was returned, the decompressor state and the input offset are all it takes to go on from here
+    const auto next_checkpoint = checkpoints.empty() ? checkpoint_interval : checkpoints.back().position + checkpoint_interval;
+    if (position >= next_checkpoint) {
+        AddCheckpoint();
+    }
+
+    FillInput();
+    const bool more_input = input_buffer_offset + input_end < compressed_size;
+    size_t in_size = input_end - input_pos;
+    size_t out_size = WINDOW_SIZE - state->window_pos;
+    const auto status = duckdb_miniz::tinfl_decompress(
+        &state->decompressor, input_buffer.data() + input_pos, &in_size, state->window,
+        state->window + state->window_pos, &out_size, more_input ? duckdb_miniz::TINFL_FLAG_HAS_MORE_INPUT : 0);
+    input_pos += in_size;
+    output_start = state->window_pos;
+    output_available = out_size;
+    state->window_pos = (state->window_pos + out_size) & (WINDOW_SIZE - 1);
+
+    if (status == duckdb_miniz::TINFL_STATUS_DONE) {
+        // Whole bytes the decompressor looked ahead belong to the trailer
+        SeekInput(GetInputOffset() - (state->decompressor.m_num_bits >> 3) + TRAILER_SIZE);
+        in_member = false;
+    } else if (status < 0 || (status == duckdb_miniz::TINFL_STATUS_NEEDS_MORE_INPUT && !more_input)) {
+        ThrowCorrupt();
+    }
+}
+
+bool GzipReader::StartMember() {
+    const auto member_offset = GetInputOffset();
+    uint8_t header[HEADER_SIZE];
+    bool complete = true;
+    for (auto &byte : header) {
+        complete = complete && ReadInputByte(byte);
+    }
+    if (!complete || header[0] != GZIP_ID1 || header[1] != GZIP_ID2 || header[2] != GZIP_DEFLATE) {
+        if (member_offset == 0) {
+            throw duckdb::IOException("\"%s\" is not a gzip file", handle->GetPath());
+        }
+        // Bytes after the last member (e.g. padding) aren't part of the stream
+        return false;
+    }
+
+    const auto flags = header[3];
+    if (flags & FLAG_EXTRA) {
+        uint8_t size_low;
+        uint8_t size_high;
+        if (!ReadInputByte(size_low) || !ReadInputByte(size_high)) {
+            ThrowCorrupt();
+        }
+        SeekInput(GetInputOffset() + (size_low | (static_cast<idx_t>(size_high) << 8)));
+    }
+    for (const auto zero_terminated : {FLAG_NAME, FLAG_COMMENT}) {
+        uint8_t byte = 1;
+        while ((flags & zero_terminated) && byte != 0) {
+            if (!ReadInputByte(byte)) {
+                ThrowCorrupt();
+            }
+        }
+    }
+    if (flags & FLAG_HCRC) {
+        SeekInput(GetInputOffset() + HEADER_CRC_SIZE);
+    }
+
+    tinfl_init(&state->decompressor);
+    in_member = true;
+    return true;
+}
+
+void GzipReader::AddCheckpoint() {
+    checkpoints.push_back({position, GetInputOffset(), duckdb::make_uniq<State>(*state)});
+}
+
+void GzipReader::Restore(const Checkpoint &checkpoint) {
+    *state = *checkpoint.state;
+    position = checkpoint.position;
+    output_available = 0;
+    in_member = true;
+    finished = false;
+    SeekInput(checkpoint.input_offset);
+}
+
+void GzipReader::Restart() {
+    state->window_pos = 0;
+    position = 0;
+    output_available = 0;
+    in_member = false;
+    finished = false;
+    SeekInput(0);
+}
+
+void GzipReader::ThrowCorrupt() const {
+    throw duckdb::IOException("Failed to decompress \"%s\": the gzip stream is corrupt or truncated", handle->GetPath());
+}
+
+void GzipReader::SeekInput(idx_t offset) {
+    if (offset >= input_buffer_offset && offset <= input_buffer_offset + input_end) {
+        input_pos = offset - input_buffer_offset;
+        return;
+    }
+    input_buffer_offset = offset;
+    input_pos = 0;
+    input_end = 0;
+}
+
+bool GzipReader::FillInput() {
+    if (input_pos < input_end) {
+        return true;
+    }
+    input_buffer_offset = GetInputOffset();
+    input_pos = 0;
+    input_end = 0;
+    if (input_buffer_offset >= compressed_size) {
+        return false;
+    }
+    input_end = std::min(INPUT_BUFFER_SIZE, compressed_size - input_buffer_offset);
+    handle->Read(input_buffer.data(), input_end, input_buffer_offset);
+    return true;
+}
+
+bool GzipReader::ReadInputByte(uint8_t &byte_out) {
+    if (!FillInput()) {
+        return false;
+    }
+    byte_out = input_buffer[input_pos++];
+    return true;
+}
+
+}  // namespace quackstore
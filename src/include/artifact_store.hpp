@@ -0,0 +1,36 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+namespace duckdb {
+    class ClientContext;
+}
+
+namespace quackstore {
+
+class Cache;
+
+// =============================================================================
+// ArtifactStore
+// =============================================================================
+
+//! Entry point for readers and other extensions caching what they derive from files read through the cache
+//! (serialized Parquet footers, CSV sniff results, row group statistics), so planning doesn't parse them again.
+//! Artifacts are keyed by the file, its version and the artifact type and are evicted with the file, see
+//! Cache::StoreArtifact. Paths may be given with or without quackstore://.
+class ArtifactStore {
+public:
+    //! Returns false if the cache is disabled or doesn't hold the file.
+    static bool Store(duckdb::ClientContext &context, const duckdb::string &path, const duckdb::string &type,
+                      duckdb::const_data_ptr_t data, idx_t size);
+    //! Returns false if no artifact of the type is cached for the current version of the file.
+    static bool Retrieve(duckdb::ClientContext &context, const duckdb::string &path, const duckdb::string &type,
+                         duckdb::vector<uint8_t> &data_out);
+
+private:
+    //! The cache serving the file, nullptr if caching is disabled
+    static duckdb::optional_ptr<Cache> GetCache(duckdb::ClientContext &context, const duckdb::string &file_path);
+    static duckdb::string GetFilePath(const duckdb::string &path);
+};
+
+}  // namespace quackstore
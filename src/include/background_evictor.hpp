@@ -0,0 +1,47 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include <condition_variable>
+#include <thread>
+
+namespace quackstore {
+
+// =============================================================================
+// BackgroundEvictor
+// =============================================================================
+
+//! Thread evicting cached blocks in batches off the store path. It runs the batch function whenever it's notified
+//! and every CHECK_INTERVAL, until the function reports that nothing is left to evict. Batches are spaced by a short
+//! pause, so the stores and reads waiting for the cache get their turn.
+class BackgroundEvictor {
+public:
+    //! Evicts one batch, returns true if another batch is needed.
+    using EvictBatch = std::function<bool()>;
+
+    static constexpr std::chrono::milliseconds CHECK_INTERVAL{1000};
+    static constexpr std::chrono::milliseconds BATCH_PAUSE{1};
+
+    explicit BackgroundEvictor(EvictBatch evict_batch);
+    //! Waits for the running batch.
+    ~BackgroundEvictor();
+
+    BackgroundEvictor(const BackgroundEvictor &) = delete;
+    BackgroundEvictor &operator=(const BackgroundEvictor &) = delete;
+
+    //! Start evicting right away instead of at the next check.
+    void Notify();
+
+private:
+    void Run();
+
+private:
+    EvictBatch evict_batch;
+    std::mutex evictor_mutex;
+    std::condition_variable wake_up;
+    bool notified = false;
+    bool stopping = false;
+    std::thread thread;
+};
+
+}  // namespace quackstore
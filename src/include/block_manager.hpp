@@ -4,6 +4,8 @@
 
 namespace quackstore {
 
+class SegmentTable;
+
 #define Bytes(n) (n)
 #define Kilobytes(n) (n << 10)
 #define Megabytes(n) (n << 20)
@@ -25,6 +27,13 @@ struct BlockCacheDataFileHeader {
     uint64_t block_count;
     //! The block_size.
     uint64_t block_size;
+    //! Incremented on every header write, lets processes sharing the file detect changes (added in v5).
+    uint64_t generation = 0;
+    //! StorageLayout of the blocks, and the location and size in bytes of the segment table of a segmented
+    //! storage (added in v6).
+    uint32_t layout = 0;
+    uint64_t segment_index = 0;
+    uint64_t segment_index_size = 0;
 
     void Write(duckdb::WriteStream &ser);
     static BlockCacheDataFileHeader Read(duckdb::ReadStream &source);
@@ -35,14 +44,33 @@ struct BlockCacheDataFileHeader {
 // BlockManager
 // =============================================================================
 
+//! How blocks are laid out in the storage file.
+enum class StorageLayout : uint32_t {
+    //! Every block id has a fixed slot, blocks are overwritten in place and freed ids are reused
+    IN_PLACE = 0,
+    //! Blocks are appended to large segments and a block written again moves to the head, sparse segments
+    //! are collected by moving their live blocks. Writes stay sequential under churn.
+    SEGMENTED = 1
+};
+
 struct BlockManagerOptions {
     uint64_t block_size;
+    //! Layout of new storage files, existing files keep the layout they were created with.
+    StorageLayout layout = StorageLayout::IN_PLACE;
+    //! A segmented storage growing by a segment collects the sparsest segment with fewer live slots than this
+    //! percentage.
+    uint8_t segment_gc_live_percent = 50;
 };
 
 class BlockManager {
     static constexpr idx_t FILE_HEADER_SIZE = 4096U;
     //! The location in the file where the block writing starts.
     static constexpr uint64_t BLOCK_START = FILE_HEADER_SIZE;
+    //! Segment size of a segmented storage, at least MIN_SEGMENT_SLOTS blocks.
+    static constexpr uint64_t SEGMENT_SIZE = Megabytes(64ULL);
+    static constexpr uint64_t MIN_SEGMENT_SLOTS = 64;
+    //! Id the segment table of a segmented storage is placed under.
+    static constexpr block_id_t SEGMENT_INDEX_BLOCK_ID = -2;
 
 public:
     //! Used to indicate an invalid block id.
@@ -66,33 +94,100 @@ public:
 
     BlockCacheDataFileHeader LoadOrCreateDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out = nullptr);
     BlockCacheDataFileHeader CreateNewDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out = nullptr);
-    BlockCacheDataFileHeader LoadExistingDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out = nullptr);
+    //! A storage loaded read-only is never written to, not even when it's closed.
+    BlockCacheDataFileHeader LoadExistingDatabase(const duckdb::string &path, duckdb::optional_ptr<LoadResult> out = nullptr,
+                                                  bool read_only = false);
+    bool IsReadOnly() const { return read_only; }
+    //! Read the header of an existing storage file without opening it. Returns false if the file doesn't exist.
+    static bool TryReadHeader(const duckdb::string &path, BlockCacheDataFileHeader &header_out);
 
     void Flush();
+    //! Drop the in-memory state and load it again from the file, e.g. after another process changed it.
+    BlockCacheDataFileHeader Reload();
+    //! Generation of the state currently loaded, and of the state stored in the file.
+    uint64_t GetGeneration() const { return generation; }
+    uint64_t ReadStoredGeneration();
+    //! Mark all blocks except the metadata block as free.
+    void FreeAllBlocks();
 
     //! Allocate a new block within the block storage.
     block_id_t AllocBlock();
+    //! Allocate an extent of block_count contiguous blocks, addressed by its first block id.
+    //! The whole extent is freed when its first block is marked as free.
+    block_id_t AllocBlocks(idx_t block_count);
+    //! Restore an extent allocated before the storage was reloaded.
+    void RegisterExtent(block_id_t block_id, idx_t block_count);
+    //! Number of blocks in the extent starting at the block (1 for regular blocks).
+    idx_t GetExtentBlockCount(block_id_t block_id) const;
     virtual void StoreBlock(block_id_t block_id, const duckdb::vector<uint8_t> &data);
+    //! Read a whole block, data is resized to the block size.
     void RetrieveBlock(block_id_t block_id, duckdb::vector<uint8_t> &data);
+    //! Store/retrieve a byte range inside the block (or extent), used by tail blocks, blocks packed into a shared
+    //! slab block and extents.
+    void StoreBlockRange(block_id_t block_id, uint64_t offset_in_block, duckdb::const_data_ptr_t data, idx_t size);
+    void RetrieveBlockRange(block_id_t block_id, uint64_t offset_in_block, duckdb::data_ptr_t data, idx_t size);
     void MarkBlockAsFree(block_id_t block_id);
     size_t MarkChainedBlocksAsFree(block_id_t block_id);
 
+    //! Register one more owner of an allocated block (used for content-shared blocks).
+    void AddBlockRef(block_id_t block_id);
+    //! Drop one owner of the block. The block is marked as free once its last owner is gone.
+    //! Returns true if the block was freed.
+    bool ReleaseBlockRef(block_id_t block_id);
+    //! Number of owners of an allocated block.
+    idx_t GetBlockRefCount(block_id_t block_id) const;
+
     uint64_t GetBlockSize() const;
+
+    //! Layout of the storage files created from now on.
+    void SetLayout(StorageLayout layout);
+    //! Layout of the open storage file.
+    StorageLayout GetLayout() const { return layout; }
+
+    //! Drop the pages of blocks read from the storage file from the OS page cache, for when the data read is
+    //! kept in memory by the caller anyway. Not supported on all platforms, it's a no-op there.
+    void SetPageCacheDropEnabled(bool enabled);
+    bool IsPageCacheDropEnabled() const { return page_cache_drop_enabled; }
+    //! Drop the pages of the blocks read since the last call, adjacent blocks with one call to the OS. Reads
+    //! call it once they're done, so the blocks of a read range are dropped together.
+    void FlushPageCacheDrops();
+
+    //! Byte range of the block (or extent) in the storage file. Returns false for blocks without a place in the
+    //! file yet, blocks of a segmented storage are placed when they're first written.
+    bool TryGetBlockRange(block_id_t block_id, uint64_t &offset_out, idx_t &size_out) const;
+
+    //! The block size must be a power of two, so block offsets can be computed with shifts.
+    static void ValidateBlockSize(uint64_t block_size);
+    //! log2 of a valid block size.
+    static uint8_t GetBlockShift(uint64_t block_size);
+
     block_id_t GetMetaBlockID();
 
     //! Used only for testing
     const duckdb::set<block_id_t> &GetFreeList() const;
     block_id_t GetMaxBlock() const;
+    const SegmentTable &GetSegmentTable() const;
 
 private:
-    uint64_t GetBlockOffset(block_id_t block_id);
+    //! Offset of the block in the storage file, throws for blocks of a segmented storage that weren't written yet.
+    uint64_t GetBlockOffset(block_id_t block_id) const;
     void SaveFreeList();
     void LoadFreeList();
     void WriteHeader();
+    BlockCacheDataFileHeader ReadHeader();
     void ValidateBlockId(block_id_t block_id) const;
+    void ValidateBlockRange(block_id_t block_id, uint64_t offset_in_block, idx_t size) const;
     void ValidateHandle() const;
     void CloseHandle();
     void CloseInternal();
+    //! Note the range read to drop it from the page cache with the next FlushPageCacheDrops.
+    void DropPageCache(uint64_t offset, idx_t size);
+    //! Append the block at the head of a segmented storage, returns its first slot.
+    uint64_t PlaceBlock(block_id_t block_id);
+    //! Move the live blocks of the sparsest segment to the head, so the segment is reused after the next flush.
+    void CollectSparseSegment();
+    void SaveSegmentTable();
+    void LoadSegmentTable(const BlockCacheDataFileHeader &header);
 
 private:
     duckdb::mutex block_manager_mutex;
@@ -100,6 +195,8 @@ private:
     duckdb::unique_ptr<duckdb::FileSystem> fs;
     //! Storage options.
     BlockManagerOptions options;
+    //! log2 of the block size.
+    uint8_t block_shift;
     //! The file handle to the block cache file.
     duckdb::unique_ptr<duckdb::FileHandle> handle;
 
@@ -109,9 +206,31 @@ private:
     block_id_t meta_block_id;
     //! The block_id where free_list is stored
     block_id_t free_list_id;
+    //! Generation of the header written or loaded last
+    uint64_t generation = 0;
+    //! Whether the file was opened read-only
+    bool read_only = false;
+    //! Layout of the open file, and the placement of its blocks and of the stored segment table if segmented
+    StorageLayout layout = StorageLayout::IN_PLACE;
+    duckdb::unique_ptr<SegmentTable> segment_table;
+    uint64_t segment_index = 0;
+    uint64_t segment_index_size = 0;
+    //! Whether pages of read blocks are dropped from the page cache, and the descriptor used to advise the OS
+    bool page_cache_drop_enabled = false;
+    int page_cache_fd = -1;
+    //! Ranges read whose pages weren't dropped yet, adjacent ones merged
+    struct FileRange {
+        uint64_t offset;
+        idx_t size;
+    };
+    duckdb::vector<FileRange> pending_page_cache_drops;
 
     //! The free list of block ids.
     duckdb::set<block_id_t> free_list;
+    //! Owner counts of blocks shared by more than one owner. Blocks not in the map have a single owner.
+    duckdb::unordered_map<block_id_t, idx_t> block_refs;
+    //! Block counts of allocated extents, keyed by their first block id.
+    duckdb::unordered_map<block_id_t, idx_t> extents;
 };
 
 }  // namespace quackstore
@@ -2,16 +2,49 @@
 
 #include <duckdb.hpp>
 
+#include <chrono>
+#include <limits>
+
 #include "block_manager.hpp"
+#include "file_lock.hpp"
 #include "metadata_manager.hpp"
 
 namespace quackstore {
 
+class BackgroundEvictor;
+class PageCacheWarmer;
+class CacheRegistry;
+
 class Cache {
 public:
+    static constexpr uint64_t DEFAULT_PACK_THRESHOLD = Kilobytes(64);
+    //! Data stored for a block index may span up to 2^MAX_EXTENT_SHIFT blocks (an extent).
+    static constexpr uint8_t MAX_EXTENT_SHIFT = 4;
+    //! Artifacts of a file are cached under the path of the file followed by the separator and their type.
+    static constexpr const char *ARTIFACT_SEPARATOR = "#artifact:";
+    //! How long a max cache size derived from the free space of the volume is kept.
+    static constexpr std::chrono::seconds AUTO_SIZE_INTERVAL{10};
+    //! Blocks evicted by one batch of the background evictor, and at most by a store while it runs.
+    static constexpr idx_t EVICTION_BATCH_SIZE = 1024;
+    static constexpr idx_t MAX_STORE_EVICTIONS = 1ULL << MAX_EXTENT_SHIFT;
+    //! Changes of a cache shared with other processes that don't allocate blocks (file metadata, evictions of the
+    //! background evictor) are published in batches of this many changes, or once the interval passed since the
+    //! last publish, and when the cache is flushed. Stores are published right away.
+    static constexpr idx_t PUBLISH_BATCH_SIZE = 256;
+    static constexpr std::chrono::milliseconds PUBLISH_INTERVAL{1000};
+    //! Reads under the shared lock of a shared cache keep at most this many LRU updates until the next publish.
+    static constexpr idx_t MAX_DEFERRED_LRU_UPDATES = 4096;
+
+    //! With a registry the cache is a handle of the cache the registry keeps open for the opened path, so
+    //! database instances opening the same cache file share one cache. Storage settings then apply to the shared
+    //! cache, deduplication and packing stay per handle. The shared cache merges the settings of its handles so none
+    //! gets less than it asked for: the largest max cache size, metadata budget and warm-up size, background eviction
+    //! if any handle enables it, auto-sizing and page cache drops only if all handles enable them, and the quotas of
+    //! the prefixes all handles limit (the largest of their limits).
     Cache(uint64_t block_size, 
         duckdb::unique_ptr<BlockManager> block_mg = nullptr, 
-        duckdb::unique_ptr<MetadataManager> metadata_mgr = nullptr);
+        duckdb::unique_ptr<MetadataManager> metadata_mgr = nullptr,
+        duckdb::optional_ptr<CacheRegistry> registry = nullptr);
     ~Cache();
 
     bool IsOpen() const;
@@ -20,28 +53,245 @@ public:
 
     void Clear();
     void Evict(const duckdb::string& filepath);
+    //! Evict the files (and their artifacts) in one batch, the changes are published once.
+    //! Returns the number of evicted files, artifacts don't count.
+    idx_t EvictFiles(const duckdb::vector<duckdb::string> &file_paths);
+    //! Move the cached blocks (and artifacts) of a file to another path, e.g. after the file was moved at the source.
+    //! Whatever was cached for the target path is evicted. Returns true if the file was cached.
+    bool RenameFile(const duckdb::string &file_path, const duckdb::string &new_path);
+    //! Evict the files whose path (with or without quackstore://) starts with the prefix.
+    idx_t EvictPrefix(const duckdb::string &prefix);
+    //! Evict the files whose path (with or without quackstore://) matches the glob pattern,
+    //! see MetadataManager::GetFilePathsMatching.
+    idx_t EvictGlob(const duckdb::string &pattern);
 
+    //! Store the data of a block. Data longer than the block size is stored as an extent covering the following
+    //! block indices, the block_index must be aligned to the extent size rounded up to a power of two.
     void StoreBlock(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data);
     bool RetrieveBlock(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data);
+    //! Retrieve the block or extent covering the block_index, start_index_out is the block index it was stored at.
+    bool RetrieveCoveringBlock(const duckdb::string &file_path, int64_t block_index, int64_t &start_index_out,
+                               duckdb::vector<uint8_t> &data);
+    //! Whether a block or an extent covering the block_index is cached.
+    bool IsBlockCached(const duckdb::string &file_path, int64_t block_index);
+    //! Read size bytes of the file starting at offset from the cached blocks, independent of the block size.
+    //! Returns false if any part of the range isn't cached.
+    bool RetrieveRange(const duckdb::string &file_path, idx_t offset, idx_t size, duckdb::data_ptr_t out);
+
+    //! Evict the cached blocks covering the byte range of the file only after all other blocks, e.g. the headers
+    //! and catalog of a database file. Lasts while the cache is open.
+    void RetainRange(const duckdb::string &file_path, idx_t offset, idx_t size);
+
+    //! Store an artifact derived from a cached file (e.g. a parsed footer, a CSV sniff result or an index) under its
+    //! type, replacing the artifact stored before. It belongs to the version (size and last modification time) of the
+    //! file it's stored for and is evicted with the file. Returns false if the file has no cached metadata.
+    bool StoreArtifact(const duckdb::string &file_path, const duckdb::string &type, duckdb::const_data_ptr_t data,
+                       idx_t size);
+    //! Returns false if no artifact of the type is cached for the current version of the file.
+    bool RetrieveArtifact(const duckdb::string &file_path, const duckdb::string &type,
+                          duckdb::vector<uint8_t> &data_out);
 
     void StoreFileSize(const duckdb::string &file_path, int64_t file_size);
     void StoreFileLastModified(const duckdb::string &file_path, duckdb::timestamp_t timestamp);
     bool RetrieveFileMetadata(const duckdb::string &file_path, quackstore::MetadataManager::FileMetadata &file_metadata_out);
+    //! Whether the cached blocks of the file hold all of its bytes.
+    bool IsFileCached(const duckdb::string &file_path);
 
     //! Set new max cache size. Triggers eviction if new cache size is less than previous one.
     void SetMaxCacheSize(uint64_t new_max_cache_size_in_bytes);
+    //! Max cache size in effect, derived from the free space of the volume with auto-sizing.
+    uint64_t GetMaxCacheSize() const;
+    //! Derive the max cache size from the volume holding the cache file: the cached bytes plus the free space
+    //! beyond the reserved percentage of the volume, between min_size and the max cache size set. It's derived
+    //! again when the max cache size is set, at most once per AUTO_SIZE_INTERVAL.
+    void SetAutoSize(bool enabled, uint64_t min_size, uint64_t reserved_free_percent);
+    //! Evict with a background thread keeping the cached bytes between the low and high watermarks (percentages of
+    //! the max cache size), in batches, instead of evicting on every store. Stores only evict the few blocks the
+    //! thread falls behind by, and shrinking the max cache size returns right away.
+    void SetBackgroundEviction(bool enabled, uint64_t low_watermark_percent, uint64_t high_watermark_percent);
+    bool IsBackgroundEvictionEnabled() const;
+    //! Number of bytes held by the cached blocks, tail blocks count only their valid bytes.
+    uint64_t GetCachedBytes() const;
+    //! Bound the memory held by the metadata (0 for no bound). Over the budget, the entries of files without
+    //! cached blocks are dropped first, then the least recently used files along with their blocks.
+    void SetMetadataBudget(uint64_t budget_bytes);
+    uint64_t GetMetadataBudget() const;
+    //! Estimate of the memory held by the metadata.
+    uint64_t GetMetadataBytes() const;
+    //! Number of files with cached metadata.
+    idx_t GetFileCount() const;
+
+    //! Limit the bytes cached for the files under path prefixes. Triggers eviction of groups over their quota.
+    void SetQuotas(const duckdb::vector<MetadataManager::Quota> &quotas);
+    //! Cached bytes and blocks of every quota group.
+    duckdb::vector<MetadataManager::GroupUsage> GetGroupUsage() const;
+    //! Paths of all files with cached metadata.
+    duckdb::vector<duckdb::string> GetFilePaths() const;
+
+    //! Store blocks with identical content only once, sharing them between files.
+    void SetDeduplicationEnabled(bool enabled);
+    bool IsDeduplicationEnabled() const;
+
+    //! Tail blocks smaller than the threshold (bytes) are packed together into shared slab blocks.
+    void SetPackThreshold(uint64_t new_pack_threshold);
+
+    //! Share the cache file with other processes. Every change is written to the file under a lock file,
+    //! and changes written by other processes are loaded before the cache is accessed.
+    //! Changing it reopens an open cache.
+    void SetSharedAccessEnabled(bool enabled);
+    bool IsSharedAccessEnabled() const;
+
+    //! Drop the pages of blocks read from the cache file from the OS page cache, for when the cache is the
+    //! persistent tier behind DuckDB's in-memory external file cache and the data would be in memory twice.
+    void SetPageCacheDropEnabled(bool enabled);
+    bool IsPageCacheDropEnabled() const;
+    //! Drop the pages of the blocks read since the last call, called at the end of a read so its blocks are
+    //! dropped with a call per range of the cache file instead of one per block.
+    void DropReadPages();
+
+    //! Ask the OS to read the most recently used blocks, up to max_bytes, into its page cache in the background once
+    //! the cache is opened, so the first reads after a restart don't all wait for the disk. Once per open, 0 for no
+    //! warm-up. Skipped while the page cache drop is enabled.
+    void SetWarmupSize(uint64_t max_bytes);
+    //! Bytes of the blocks the warm-up of the open cache asked for.
+    uint64_t GetWarmupBytes() const;
+    //! Whether the warm-up of the open cache asked for the block of the file. Used for testing only
+    bool IsBlockWarmedUp(const duckdb::string &file_path, int64_t block_index) const;
+
+    //! Open an existing cache file without ever writing to it: no flushes, no LRU updates and no locks,
+    //! so a pre-warmed cache file can be mounted read-only by many hosts. It keeps the block size it was
+    //! written with. Storing or evicting data throws. Changing it reopens an open cache.
+    void SetReadOnly(bool read_only);
+    bool IsReadOnly() const;
 
     //! Flush all changes to disk.
     void Flush();
 
-    uint64_t GetBlockSize() const { return block_size; }
+    //! Layout of the cache files created from now on, existing files keep the layout they were created with.
+    //! See StorageLayout.
+    void SetStorageLayout(StorageLayout layout);
+    //! Layout of the open cache file.
+    StorageLayout GetStorageLayout() const;
+
+    //! Change the block size (must be a power of two). The blocks of an open cache, or of an existing cache file
+    //! opened later, are migrated to the new block size. Until a block size is set, an existing cache file is
+    //! opened with the block size it was written with.
+    void SetBlockSize(uint64_t new_block_size);
+
+    uint64_t GetBlockSize() const { return shared_cache ? shared_cache->GetBlockSize() : block_size; }
+    //! log2 of the block size, block indices and offsets are computed with shifts.
+    uint8_t GetBlockShift() const { return shared_cache ? shared_cache->GetBlockShift() : block_shift; }
     const duckdb::string& GetPath() const { return path; }
 
     void AddRef();
     void RemoveRef();
 
+    //! Pin the current epoch of a cache opened through a registry for a file handle. The handle works with the
+    //! returned cache until it's closed, so closing the cache or switching its path takes effect for new handles
+    //! right away while handles in flight finish against the storage they started with. That storage is released
+    //! once the last handle of its epoch is closed. nullptr for other caches, handles then use the cache itself.
+    duckdb::shared_ptr<Cache> PinEpoch();
+
 private:
+    //! Holds the lock file of a shared cache for the duration of an operation (nested scopes reuse the lock),
+    //! and loads the changes written by other processes. No-op if shared access is disabled.
+    class SharedAccess {
+    public:
+        SharedAccess(Cache &cache, FileLock::Mode mode);
+        ~SharedAccess();
+
+    private:
+        Cache &cache;
+        bool active;
+    };
+
+    //! How new blocks are stored, taken from the cache handle storing them.
+    struct StorePolicy {
+        bool deduplicate;
+        uint64_t pack_threshold;
+    };
+
+    //! Storage settings a handle asks for, the shared cache applies the merge of the settings of all its handles.
+    struct HandleSettings {
+        uint64_t max_cache_size = std::numeric_limits<int64_t>::max();
+        bool auto_size_enabled = false;
+        uint64_t auto_size_min = 0;
+        uint64_t auto_size_reserved_percent = 0;
+        bool background_eviction_enabled = false;
+        uint64_t eviction_low_watermark = 0;
+        uint64_t eviction_high_watermark = 100;
+        uint64_t metadata_budget = 0;
+        bool page_cache_drop_enabled = false;
+        uint64_t warmup_size = 0;
+        duckdb::vector<MetadataManager::Quota> quotas;
+    };
+
     void Initialize();
+    //! Drop all cached data and close the cache, regardless of its users.
+    void ClearStorage();
+
+    void StoreBlockWithPolicy(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data,
+                              const StorePolicy &policy);
+    void StoreBlockInternal(const duckdb::string &file_path, int64_t block_index, duckdb::vector<uint8_t> &data,
+                            const StorePolicy &policy);
+
+    //! Load the cache state again if another process changed the file.
+    void ReloadIfChanged();
+    //! Restore block owner counts and extents from the loaded metadata.
+    void RestoreBlockState();
+    //! Write the changes to the file right away so other processes see them.
+    void PublishChanges();
+    //! Write the changes once a batch is complete, see PUBLISH_BATCH_SIZE. Only for changes that don't allocate
+    //! blocks: changes not published yet are dropped if another process publishes first, which only forgets them.
+    void PublishChangesBatched();
+    //! Apply the LRU updates of reads done under the shared lock, the exclusive lock must be held.
+    void ApplyDeferredLRUUpdates();
+
+    //! Evict after storing data: everything over the max cache size, or a few blocks with background eviction.
+    void EvictAfterStore(block_id_t keep_block_id);
+    //! One batch of the background evictor, returns true if another one is needed.
+    bool EvictBatch();
+    uint64_t GetWatermark(uint64_t percent) const;
+    //! The evictor runs while a cache with background eviction owns its storage.
+    void StartEvictor();
+    void StopEvictor();
+    //! The warm-up runs once after the cache owning its storage is opened, until it's closed.
+    void StartWarmup();
+    void StopWarmup();
+    //! Whether the cache is a handle of a cache shared through the registry, its storage settings then apply to the
+    //! shared cache.
+    bool IsSharedHandle() const { return registry && !read_only; }
+    //! Pass the settings this handle asks for to the shared cache, once it's open.
+    void RequestHandleSettings();
+    //! Record the settings a handle of this shared cache asks for (or drop them once the handle is closed) and apply
+    //! the merge of the settings of all handles. Only the settings that change are applied.
+    void SetHandleSettings(const Cache &handle, const HandleSettings &settings);
+    void DropHandleSettings(const Cache &handle);
+    void ApplyHandleSettings();
+    //! Drop file metadata until it fits into the metadata budget, the metadata of the file is kept.
+    void EnforceMetadataBudget(const duckdb::string &keep_file_path);
+    //! Drop the block (or extent) stored at the block index of the file.
+    void ReleaseFileBlock(const duckdb::string &file_path, int64_t block_index);
+    //! Evict a share of the least recently used blocks after the volume holding the cache file ran out of space,
+    //! the following stores reuse their blocks instead of growing the file.
+    void EvictForSpace();
+    //! Max cache size for the current free space of the volume, max_size if it can't be determined.
+    uint64_t ComputeAutoSize(uint64_t max_size) const;
+    void ValidateExtent(int64_t block_index, idx_t num_blocks) const;
+    void ValidateWritable() const;
+    //! Load an existing cache file read-only.
+    void OpenReadOnly(const duckdb::string &open_path);
+    //! Replace the storage with one using the new block size. The cache must be closed.
+    void ResetBlockSize(uint64_t new_block_size);
+    //! Rewrite the cache file written with another block size using the current block size.
+    void MigrateBlockSize(const duckdb::string &cache_path, uint64_t stored_block_size);
+
+    //! Try to reference an already stored block with the same content instead of storing a new one.
+    bool TryStoreDeduplicatedBlock(const duckdb::string &file_path, int64_t block_index, 
+                                   const duckdb::vector<uint8_t> &data, uint64_t checksum);
+    //! Append a small block to the open slab block, starting a new slab block if it doesn't fit.
+    void StorePackedBlock(const duckdb::string &file_path, int64_t block_index, const duckdb::vector<uint8_t> &data,
+                          uint64_t checksum);
 
     void SetDirty(bool dirty);
     bool IsDirty() const;
@@ -49,14 +299,59 @@ private:
 private:
     mutable std::recursive_mutex cache_mutex;
     uint64_t block_size = 0;
+    uint8_t block_shift = 0;
+    //! Whether the block size was set, existing cache files are migrated to it
+    bool block_size_set = false;
     uint64_t dirty = 0;
     duckdb::string path;
     bool opened = false;
+    bool deduplication_enabled = false;
+    uint64_t pack_threshold = DEFAULT_PACK_THRESHOLD;
+    bool shared_access_enabled = false;
+    bool page_cache_drop_enabled = false;
+    bool read_only = false;
+    StorageLayout storage_layout = StorageLayout::IN_PLACE;
+    //! Auto-sizing settings, the max cache size set and when the max cache size was derived last
+    bool auto_size_enabled = false;
+    uint64_t auto_size_min = 0;
+    uint64_t auto_size_reserved_percent = 0;
+    uint64_t configured_max_cache_size = 0;
+    std::chrono::steady_clock::time_point auto_size_updated;
+    //! Background eviction settings, whether the evictor is evicting down to the low watermark, and the evictor
+    bool background_eviction_enabled = false;
+    uint64_t eviction_low_watermark = 0;
+    uint64_t eviction_high_watermark = 100;
+    bool eviction_running = false;
+    duckdb::unique_ptr<BackgroundEvictor> evictor;
+    uint64_t metadata_budget = 0;
+    //! Warm-up size, whether the warm-up of the open cache started, the bytes it asked for and the warmer
+    uint64_t warmup_size = 0;
+    bool warmup_started = false;
+    uint64_t warmup_bytes = 0;
+    duckdb::unique_ptr<PageCacheWarmer> warmer;
+    duckdb::unique_ptr<FileLock> file_lock;
+    idx_t file_lock_depth = 0;
+    //! Changes not published yet and when the changes were published last
+    idx_t unpublished_changes = 0;
+    std::chrono::steady_clock::time_point last_published;
+    //! Blocks read under the shared lock, moved up in the LRU order under the exclusive lock
+    duckdb::vector<MetadataManager::BlockKey> deferred_lru_updates;
 
     duckdb::unique_ptr<BlockManager> block_mgr;
     duckdb::unique_ptr<MetadataManager> metadata_mgr;
 
     std::atomic<int64_t> current_cache_users = 0;
+
+    //! Registry providing the cache shared by all handles of the opened path, and the shared cache while open.
+    duckdb::optional_ptr<CacheRegistry> registry;
+    duckdb::shared_ptr<Cache> shared_cache;
+    //! Epoch pinned by the file handles opened since the cache was opened
+    duckdb::shared_ptr<Cache> epoch;
+    //! Whether the cache is the epoch pinned by a handle, only the settings of the handle count for the shared cache
+    bool is_epoch = false;
+    //! Storage settings of a handle, and the settings of the handles of a shared cache
+    HandleSettings handle_settings;
+    duckdb::map<const Cache *, HandleSettings> handles_settings;
 };
 
 }  // namespace quackstore
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+namespace quackstore {
+
+class Cache;
+
+// =============================================================================
+// CacheBundle
+// =============================================================================
+
+//! A portable snapshot of cached files: their metadata and cached byte ranges, independent of the block size
+//! and layout of the cache file they were exported from.
+//!
+//! Layout: magic, version, then per file a file tag, path, size, last modified and its byte ranges
+//! (each preceded by a range tag, followed by an end tag), and an end tag after the last file.
+class CacheBundle {
+public:
+    static constexpr const char *MAGIC = "QSBUNDLE";
+    static constexpr uint32_t VERSION = 1;
+
+    struct Stats {
+        idx_t files = 0;
+        idx_t blocks = 0;
+        idx_t bytes = 0;
+        //! Files left out of an import because the cache holds a newer version
+        idx_t skipped_files = 0;
+    };
+
+    //! Write the cached files of the caches whose path starts with the prefix (all files if it's empty).
+    static Stats Export(duckdb::FileSystem &fs, const duckdb::string &bundle_path,
+                        const duckdb::vector<duckdb::reference<Cache>> &caches, const duckdb::string &prefix);
+    //! Merge a bundle into live caches, route picks the cache of a file. Files the cache holds in another
+    //! version are replaced if the bundle's is newer and skipped otherwise, blocks already cached are kept.
+    //! Contiguous ranges are stored as extents.
+    static Stats Import(duckdb::FileSystem &fs, const duckdb::string &bundle_path,
+                        const std::function<Cache &(const duckdb::string &)> &route);
+};
+
+}  // namespace quackstore
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include "block_manager.hpp"
+
+namespace quackstore {
+
+class Cache;
+
+// =============================================================================
+// CacheRegistry
+// =============================================================================
+
+//! Process-wide registry of open caches keyed by their canonical cache path. Database instances of the
+//! process opening the same cache file share one cache (and its metadata in memory) instead of each
+//! opening the file on its own. The shared cache is closed once its last user releases it.
+class CacheRegistry {
+public:
+    //! The registry used by the extension, shared by all database instances of the process.
+    static CacheRegistry &Get();
+
+    //! Return the cache opened for the path, opening it if it isn't open yet. The layout applies only to a cache
+    //! opened here, the block size (with migrate_block_size) and shared access also to an open one. Unless
+    //! migrate_block_size is set, the cache keeps its block size (an existing cache file the one it was written
+    //! with). Every Acquire must be matched by a Release with the path of the returned cache.
+    duckdb::shared_ptr<Cache> Acquire(const duckdb::string &path, uint64_t block_size, bool migrate_block_size,
+                                      bool shared_access,
+                                      StorageLayout layout = StorageLayout::IN_PLACE);
+    //! Drop one user of the cache, key is the path of the cache returned by Acquire (its canonical path). The last
+    //! user closes it.
+    void Release(const duckdb::string &key);
+
+    //! Absolute path with symbolic links and relative components resolved, the cache file may not exist yet.
+    static duckdb::string CanonicalPath(const duckdb::string &path);
+
+    //! Used only for testing
+    idx_t GetCacheCount() const;
+
+private:
+    struct Entry {
+        duckdb::shared_ptr<Cache> cache;
+        idx_t users = 0;
+    };
+
+    mutable std::mutex registry_mutex;
+    duckdb::unordered_map<duckdb::string, Entry> caches;
+};
+
+}  // namespace quackstore
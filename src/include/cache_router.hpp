@@ -0,0 +1,50 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include "quackstore_params.hpp"
+
+namespace quackstore {
+
+class Cache;
+class CacheRegistry;
+
+// =============================================================================
+// CacheRouter
+// =============================================================================
+
+//! Routes files to caches: the named caches configured with quackstore_caches serve the files under their
+//! path prefix (the longest matching prefix wins), all other files are served by the default cache.
+class CacheRouter {
+public:
+    CacheRouter(Cache &default_cache, duckdb::optional_ptr<CacheRegistry> registry = nullptr);
+    ~CacheRouter();
+
+    //! The cache serving the file, opened and set up with the current settings.
+    Cache &Route(const duckdb::string &file_path, const ExtensionParams &params);
+    //! Close the named caches that are no longer configured or moved to another path.
+    void Configure(const duckdb::vector<NamedCacheConfig> &configs);
+    //! Call the function for the default cache and every named cache.
+    void ForEachCache(const std::function<void(Cache &)> &func);
+    //! The read-only cache consulted on misses of all caches, opened with the current settings.
+    //! nullptr if no lower tier is configured. File handles keep the lower tier they got open until they are closed.
+    duckdb::shared_ptr<Cache> GetLowerTier(const ExtensionParams &params);
+    //! Drop the lower tier, it's closed once the file handles using it are closed.
+    void CloseLowerTier();
+
+    //! The configuration of the named cache serving the file, nullptr if the default cache serves it.
+    static duckdb::optional_ptr<const NamedCacheConfig> FindRoute(const duckdb::string &file_path,
+                                                                  const ExtensionParams &params);
+
+private:
+    Cache &GetNamedCache(const NamedCacheConfig &config);
+
+private:
+    std::mutex router_mutex;
+    Cache &default_cache;
+    duckdb::optional_ptr<CacheRegistry> registry;
+    duckdb::map<duckdb::string, duckdb::unique_ptr<Cache>> named_caches;
+    duckdb::shared_ptr<Cache> lower_tier;
+};
+
+}  // namespace quackstore
@@ -8,15 +8,18 @@ namespace duckdb {
 namespace quackstore {
 
 class Cache;
+class CacheRouter;
 
 class ExtensionCallback : public duckdb::ExtensionCallback 
 {
 public:
-    ExtensionCallback(duckdb::unique_ptr<Cache> cache);
+    ExtensionCallback(duckdb::unique_ptr<Cache> cache, duckdb::unique_ptr<CacheRouter> router);
+    ~ExtensionCallback() override;
     void OnConnectionOpened(duckdb::ClientContext &context) override;
 
 private:
     duckdb::unique_ptr<Cache> cache;
+    duckdb::unique_ptr<CacheRouter> router;
 };
 
 }  // namespace quackstore
\ No newline at end of file
@@ -10,6 +10,7 @@ namespace quackstore {
 
 class QuackstoreFileSystem;
 class Cache;
+class CacheRouter;
 
 class ExtensionState : public duckdb::ClientContextState {
 public:
@@ -17,12 +18,16 @@ public:
 
     static duckdb::shared_ptr<ExtensionState> RetrieveFromContext(duckdb::ClientContext& context);
 
-    ExtensionState(Cache& cache);
+    ExtensionState(Cache& cache, duckdb::optional_ptr<CacheRouter> router = nullptr);
 
+    //! The default cache.
     Cache& GetCache() const;
+    //! Routes files to the named caches, nullptr if only the default cache is used.
+    duckdb::optional_ptr<CacheRouter> GetRouter() const;
 
 private:
     Cache& cache;
+    duckdb::optional_ptr<CacheRouter> router;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+namespace quackstore {
+
+// =============================================================================
+// FileLock
+// =============================================================================
+
+//! An advisory lock on a file shared between processes. Locking blocks until the lock is granted. Where the OS
+//! supports it, two locks of the same file in one process exclude each other like locks of different processes.
+class FileLock {
+public:
+    enum class Mode {
+        SHARED,
+        EXCLUSIVE
+    };
+
+    //! Opens (creating if needed) the lock file.
+    explicit FileLock(const duckdb::string &path);
+    ~FileLock();
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    void Lock(Mode mode);
+    void Unlock();
+
+    const duckdb::string &GetPath() const { return path; }
+
+private:
+    duckdb::string path;
+#ifdef _WIN32
+    void *handle;
+#else
+    int fd;
+#endif
+};
+
+}  // namespace quackstore
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include "block_manager.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// GzipReader
+// =============================================================================
+
+//! Reads the decompressed stream of a gzip file, concatenated members as one stream. On the way it keeps restart
+//! points (checkpoints): the state of the decompressor and its window every checkpoint_interval bytes of output,
+//! so seeking back decompresses from the closest checkpoint instead of the start of the file.
+class GzipReader {
+public:
+    static constexpr idx_t DEFAULT_CHECKPOINT_INTERVAL = Megabytes(16ULL);
+
+    //! Reads the compressed file with positional reads of the handle.
+    explicit GzipReader(duckdb::unique_ptr<duckdb::FileHandle> compressed_handle,
+                        idx_t checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL);
+    ~GzipReader();
+
+    GzipReader(const GzipReader &) = delete;
+    GzipReader &operator=(const GzipReader &) = delete;
+
+    //! Move to the offset of the decompressed stream, or to its end if it's shorter. Returns the new position.
+    idx_t Seek(idx_t offset);
+    //! Read until the buffer is full or the stream ends, returns the number of bytes read.
+    idx_t Read(duckdb::data_ptr_t out, idx_t size) { return ReadOutput(out, size); }
+
+    idx_t GetPosition() const { return position; }
+    //! Whether the end of the stream was reached, its size is the position then.
+    bool IsFinished() const { return finished; }
+    idx_t GetCheckpointCount() const { return checkpoints.size(); }
+
+private:
+    //! Decompressor and its window, defined with the decompressor
+    struct State;
+    struct Checkpoint {
+        idx_t position;
+        idx_t input_offset;
+        duckdb::unique_ptr<State> state;
+    };
+
+    //! Decompress the next piece of output into the window, moving on to the next member at the end of one.
+    void Inflate();
+    //! Parse the header of the member at the input offset. Returns false if there is no further member.
+    bool StartMember();
+    void AddCheckpoint();
+    void Restore(const Checkpoint &checkpoint);
+    void Restart();
+    //! Read the next bytes of output, they are discarded without a buffer.
+    idx_t ReadOutput(duckdb::data_ptr_t out, idx_t size);
+    [[noreturn]] void ThrowCorrupt() const;
+
+    idx_t GetInputOffset() const { return input_buffer_offset + input_pos; }
+    void SeekInput(idx_t offset);
+    //! Read the next part of the compressed file if the input buffer is consumed. Returns false at its end.
+    bool FillInput();
+    bool ReadInputByte(uint8_t &byte_out);
+
+private:
+    duckdb::unique_ptr<duckdb::FileHandle> handle;
+    const idx_t compressed_size;
+    const idx_t checkpoint_interval;
+
+    //! Part of the compressed file being decompressed
+    duckdb::vector<uint8_t> input_buffer;
+    idx_t input_buffer_offset = 0;
+    idx_t input_pos = 0;
+    idx_t input_end = 0;
+
+    duckdb::unique_ptr<State> state;
+    //! Output in the window not returned yet
+    idx_t output_start = 0;
+    idx_t output_available = 0;
+    //! Position in the decompressed stream, whether the input is inside a member and the stream ended
+    idx_t position = 0;
+    bool in_member = false;
+    bool finished = false;
+
+    //! Sorted by position
+    duckdb::vector<Checkpoint> checkpoints;
+};
+
+}  // namespace quackstore
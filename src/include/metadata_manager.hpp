@@ -35,6 +35,14 @@ public:
         int64_t block_index;
         block_id_t block_id;
         uint64_t checksum;
+        //! Location of the data inside the block: tail blocks store only their valid bytes, small ones
+        //! are packed into a shared slab block and extents span several blocks.
+        //! Zero length means the data occupies exactly one whole block.
+        uint64_t offset = 0;
+        uint64_t length = 0;
+
+        bool HasLength() const { return length != 0; }
+        uint64_t GetLength(uint64_t block_size) const { return HasLength() ? length : block_size; }
     };
 
     //! FileMetadata tracks file size and list of blocks allocated for the given file
@@ -52,43 +60,195 @@ public:
         static void ReadV1(duckdb::ReadStream &source, MetadataManager::FileMetadata& out);
         static void ReadV2(duckdb::ReadStream &source, MetadataManager::FileMetadata& out);
         static void ReadV3(duckdb::ReadStream &source, MetadataManager::FileMetadata& out);
+        static void ReadV4(duckdb::ReadStream &source, MetadataManager::FileMetadata& out);
+    };
+
+    //! Upper bound of the bytes cached for the files under a path prefix, as a number of bytes or as a
+    //! percentage of the max cache size.
+    struct Quota {
+        duckdb::string prefix;
+        uint64_t max_bytes = 0;
+        uint8_t percent = 0;
+
+        uint64_t GetLimit(uint64_t max_cache_size) const {
+            return percent != 0 ? max_cache_size / 100 * percent : max_bytes;
+        }
+        bool operator==(const Quota &other) const {
+            return prefix == other.prefix && max_bytes == other.max_bytes && percent == other.percent;
+        }
+    };
+
+    //! Bytes and blocks cached for the files of a quota group. The files matching no quota prefix form a
+    //! group with an empty prefix and no limit.
+    struct GroupUsage {
+        duckdb::string prefix;
+        uint64_t limit;
+        uint64_t cached_bytes;
+        idx_t block_count;
     };
 
     MetadataManager();
     ~MetadataManager();
 
+    //! Block size of the storage, used to account the bytes of full blocks.
+    void SetBlockSize(uint64_t block_size);
+
     void Clear();
 
     block_id_t GetBlockId(const duckdb::string &file_path, int64_t block_index) const;
-    void RegisterBlock(const duckdb::string &file_path, int64_t block_index, block_id_t block_id, uint64_t checksum);
+    void RegisterBlock(const duckdb::string &file_path, int64_t block_index, block_id_t block_id, uint64_t checksum,
+                       uint64_t offset = 0, uint64_t length = 0);
+    //! Remove the block and every file block that refers to it.
     void UnregisterBlock(block_id_t block_id);
+    //! Remove a single file block. Returns true if no other file block refers to the same block_id anymore.
+    bool UnregisterFileBlock(const duckdb::string &file_path, int64_t block_index);
     void SetFileSize(const duckdb::string &file_path, int64_t file_size);
     void SetFileLastModified(const duckdb::string &file_path, duckdb::timestamp_t timestamp);
     bool GetFileMetadata(const duckdb::string &file_path, FileMetadata &file_metadata_out) const;
+    duckdb::vector<duckdb::string> GetFilePaths() const;
+    //! Paths of the files starting with the prefix, found with a range scan of the sorted paths.
+    duckdb::vector<duckdb::string> GetFilePathsWithPrefix(const duckdb::string &prefix) const;
+    //! Paths of the files matching the glob pattern: `*` and `?` don't match `/`, `**` matches any path
+    //! and a pattern ending with `/` matches all files below. Only the paths starting with the part of the
+    //! pattern before its first wildcard are scanned.
+    duckdb::vector<duckdb::string> GetFilePathsMatching(const duckdb::string &pattern) const;
+    //! Remove all file blocks of the file, release_func is called with the block_id of each.
+    //! Returns the number of removed file blocks.
+    idx_t UnregisterFileBlocks(const duckdb::string &file_path, const std::function<void(block_id_t)> &release_func);
+    //! Move the entry and the file blocks of the file to new_path, the blocks keep their place in the LRU order and
+    //! their quota group. The blocks of new_path must have been unregistered, an entry without blocks is replaced.
+    //! Returns false if the file has no entry.
+    bool RenameFile(const duckdb::string &file_path, const duckdb::string &new_path);
 
     void UpdateLRUOrder(block_id_t block_id);
-    void EvictLRUBlockIfNeeded(std::function<void(block_id_t)> remove_from_storage_func);
+    //! Evict retained blocks only after all other blocks. Retention isn't persisted, it lasts until the
+    //! block is unregistered or the metadata is cleared or read again.
+    void RetainBlock(block_id_t block_id);
+    bool IsBlockRetained(block_id_t block_id) const;
+    //! Evict least recently used blocks until the cached bytes fit into the max cache size, the blocks of groups
+    //! over their quota first and retained blocks last. The keep_block_id block is never evicted. Returns true if
+    //! any block was evicted.
+    bool EvictLRUBlockIfNeeded(std::function<void(block_id_t)> remove_from_storage_func,
+                               block_id_t keep_block_id = BlockManager::INVALID_BLOCK_ID);
+    //! Evict least recently used blocks, retained blocks last, until the cached bytes are at most target_bytes
+    //! but no more than max_blocks of them. Quotas aren't considered. Returns the number of evicted blocks.
+    idx_t EvictLRUBlocks(uint64_t target_bytes, idx_t max_blocks,
+                         const std::function<void(block_id_t)> &remove_from_storage_func,
+                         block_id_t keep_block_id = BlockManager::INVALID_BLOCK_ID);
+    //! Evict the least recently used blocks of the groups over their quota, the group furthest over its quota
+    //! first, while the cached bytes are over target_bytes, but no more than max_blocks of them. Groups within
+    //! their quota are left alone. Returns the number of evicted blocks.
+    idx_t EvictOverQuotaBlocks(uint64_t target_bytes, idx_t max_blocks,
+                               const std::function<void(block_id_t)> &remove_from_storage_func,
+                               block_id_t keep_block_id = BlockManager::INVALID_BLOCK_ID);
 
     void WriteMetadata(MetadataWriter &writer);
     void ReadMetadata(MetadataReader &reader, uint32_t version);
 
-    void SetMaxCacheSize(idx_t max_cache_size_in_blocks);
+    void SetMaxCacheSize(idx_t max_cache_size_in_bytes);
+    idx_t GetMaxCacheSize() const { return max_cache_size; }
+    //! Files belong to the quota with the longest prefix matching their path. A group may exceed its quota while
+    //! the cache has room, eviction takes the blocks of groups over their quota first. A block shared between files
+    //! belongs to the group of its first file.
+    void SetQuotas(const duckdb::vector<Quota> &new_quotas);
+    const duckdb::vector<Quota> &GetQuotas() const { return quotas; }
+    duckdb::vector<GroupUsage> GetGroupUsage() const;
+    //! Number of bytes stored in the data blocks (shared blocks are counted once).
+    idx_t GetCachedBytes() const { return cached_bytes; }
+    //! Number of files with metadata, including the files without cached blocks.
+    idx_t GetFileCount() const { return files_metadata.size(); }
+    //! Estimate of the memory held by the metadata: the entries of the maps and lists, and the file paths.
+    uint64_t GetMetadataBytes() const;
+    //! Drop file entries until the metadata is estimated at most max_bytes: first the entries of files without
+    //! cached blocks (only their size and modification time), then the files of the least recently used blocks
+    //! along with all their blocks, release_func is called with the block_id of each. The metadata of the
+    //! keep_file_path file is never dropped. Returns the number of dropped files.
+    idx_t EvictFileMetadata(uint64_t max_bytes, const duckdb::string &keep_file_path,
+                            const std::function<void(block_id_t)> &release_func);
 
     FileMetadataBlockInfo GetBlockInfo(const duckdb::string &file_path, block_id_t block_id) const;
 
+    //! Find a stored block holding content with the given checksum that the file doesn't reference yet.
+    //! The checksum is only a hint, the caller has to compare the actual content.
+    bool FindBlockByChecksum(uint64_t checksum, const duckdb::string &file_path, FileMetadataBlockInfo &block_info_out) const;
+    //! Whether the file has a block stored in the given block_id.
+    bool FileHasBlock(const duckdb::string &file_path, block_id_t block_id) const;
+    //! Number of file blocks referring to the block_id.
+    idx_t GetBlockRefCount(block_id_t block_id) const;
+    //! Blocks referenced by more than one file block, with their reference counts.
+    duckdb::vector<std::pair<block_id_t, idx_t>> GetSharedBlocks() const;
+    //! Extents (blocks holding more than block size bytes), with their block counts.
+    duckdb::vector<std::pair<block_id_t, idx_t>> GetExtents() const;
+    //! Index of the file block covering the block_index: the block itself or an extent starting at a
+    //! block_index aligned to at most 2^max_extent_shift blocks. Returns -1 if there is no such block.
+    int64_t FindCoveringBlockIndex(const duckdb::string &file_path, int64_t block_index, uint8_t max_extent_shift) const;
+
+    //! The slab block small blocks are currently packed into and the offset of its free space.
+    //! Returns INVALID_BLOCK_ID if there is no such slab block.
+    block_id_t GetOpenSlab(uint64_t &end_offset_out) const;
+    void SetOpenSlab(block_id_t block_id, uint64_t end_offset);
+
+    //! Block ids from the most recently used one on, at most max_count.
+    duckdb::vector<block_id_t> GetRecentBlocks(idx_t max_count) const;
+
     //! Used for testing only
     duckdb::vector<BlockKey> GetLRUState() const;
 
 private:
+    //! Account the bytes of a file block stored in the block_id.
+    void AccountBlockBytes(const duckdb::string &file_path, block_id_t block_id, const FileMetadataBlockInfo &block_info);
+    //! Index of the quota group of the file, quotas.size() for files without a quota.
+    idx_t GetGroup(const duckdb::string &file_path) const;
+    //! Assign the cached blocks to the groups of the current quotas.
+    void RebuildGroups();
+    //! Order the blocks of each quota group like the LRU list.
+    void RebuildGroupLRU();
+    //! Move the block to the front of the LRU order of its group, if the group has a quota.
+    void UpdateGroupLRUOrder(block_id_t block_id);
+    void RemoveFromGroupLRU(block_id_t block_id);
+    //! Least recently used block of the quota group other than keep_block_id, INVALID_BLOCK_ID if there is none.
+    block_id_t GetGroupVictim(idx_t group, block_id_t keep_block_id) const;
+    //! The entry of the file, added without blocks if it has none yet.
+    duckdb::map<duckdb::string, FileMetadata>::iterator AddFile(const duckdb::string &file_path);
+    duckdb::map<duckdb::string, FileMetadata>::iterator EraseFile(duckdb::map<duckdb::string, FileMetadata>::iterator it);
+
     //! The mapping of file paths and block indices to block ids.
     duckdb::unordered_map<BlockKey, block_id_t, BlockKeyHash> block_mapping;
-    //! Reverse mapping from block_id to BlockKey to easily locate which file/block is associated with a block_id
-    duckdb::unordered_map<block_id_t, BlockKey> reverse_block_mapping;
-    //! The mapping of file paths and files metadata.
-    duckdb::unordered_map<duckdb::string, FileMetadata> files_metadata;
+    //! Reverse mapping from block_id to BlockKeys to easily locate which file/blocks are associated with a block_id.
+    //! There is more than one BlockKey when the block content is shared between files.
+    duckdb::unordered_map<block_id_t, duckdb::vector<BlockKey>> reverse_block_mapping;
+    //! Maps content checksums to the block location holding that content, used for block deduplication.
+    duckdb::unordered_map<uint64_t, FileMetadataBlockInfo> content_index;
+    //! The slab block being filled with packed blocks. It is reset when the block gets unregistered.
+    block_id_t open_slab_id = BlockManager::INVALID_BLOCK_ID;
+    uint64_t open_slab_end = 0;
+    //! The mapping of file paths and files metadata, sorted by path so the files under a prefix are a range.
+    duckdb::map<duckdb::string, FileMetadata> files_metadata;
+    //! Paths of the files without blocks (the keys in files_metadata), the first entries dropped over the budget
+    duckdb::unordered_set<const duckdb::string *> empty_files;
+    //! Lengths of the paths in files_metadata and block_mapping
+    uint64_t file_path_bytes = 0;
+    uint64_t block_key_path_bytes = 0;
 
-    //! Cache capacity (measured in number of blocks)
+    //! Cache capacity (measured in bytes)
     idx_t max_cache_size;
+    //! Block size of the storage
+    uint64_t block_size = 0;
+    //! Bytes used in each data block: valid bytes of a tail block, the filled part of a slab block
+    duckdb::unordered_map<block_id_t, uint64_t> block_bytes;
+    //! Sum of block_bytes
+    idx_t cached_bytes = 0;
+    //! Quotas per path prefix
+    duckdb::vector<Quota> quotas;
+    //! Quota group of each data block, and the bytes and blocks per group (the last group has no quota)
+    duckdb::unordered_map<block_id_t, idx_t> block_groups;
+    duckdb::vector<uint64_t> group_bytes = {0};
+    duckdb::vector<idx_t> group_blocks = {0};
+    //! LRU order of the blocks of each group with a quota, and the group and node of each block in it
+    duckdb::vector<duckdb::list<block_id_t>> group_lru_lists;
+    duckdb::unordered_map<block_id_t, std::pair<idx_t, duckdb::list<block_id_t>::iterator>> group_lru_map;
+    //! Blocks evicted only after all other blocks
+    duckdb::unordered_set<block_id_t> retained_blocks;
     //! Linked list to store lru order
     duckdb::list<block_id_t> lru_list;
     //! Maps block_id_t to the correspondent node in the linked list `lru_list` to get O(1) access time
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace quackstore {
+
+// =============================================================================
+// PageCacheWarmer
+// =============================================================================
+
+//! Thread asking the OS to read byte ranges of a file into its page cache, e.g. the most recently used blocks of a
+//! cache file after it's opened, so the first reads after a restart don't all wait for the disk. The reads are only
+//! hints (readahead), the thread stops early when it's destroyed. No-op where readahead hints aren't supported.
+class PageCacheWarmer {
+public:
+    struct FileRange {
+        uint64_t offset;
+        idx_t size;
+    };
+
+    //! Starts warming the ranges, in the given order.
+    PageCacheWarmer(duckdb::string path, duckdb::vector<FileRange> ranges);
+    //! Waits for the range being warmed.
+    ~PageCacheWarmer();
+
+    PageCacheWarmer(const PageCacheWarmer &) = delete;
+    PageCacheWarmer &operator=(const PageCacheWarmer &) = delete;
+
+    const duckdb::vector<FileRange> &GetRanges() const { return ranges; }
+
+private:
+    void Run();
+
+private:
+    const duckdb::string path;
+    const duckdb::vector<FileRange> ranges;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+}  // namespace quackstore
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace quackstore {
+
+// =============================================================================
+// Prefetcher
+// =============================================================================
+
+//! Runs prefetch tasks (reads that fill the cache ahead of the queries needing the data) on a few background
+//! threads, started with the first task. Prefetching is best effort: tasks are dropped when too many are
+//! waiting, and errors of tasks are ignored.
+class Prefetcher {
+public:
+    using Task = std::function<void()>;
+
+    static constexpr idx_t DEFAULT_THREAD_COUNT = 4;
+    static constexpr idx_t MAX_QUEUED_TASKS = 1024;
+
+    explicit Prefetcher(idx_t thread_count = DEFAULT_THREAD_COUNT);
+    //! Drops the waiting tasks and waits for the running ones.
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    //! Queue the task. Returns false if it was dropped because the queue is full.
+    bool Schedule(Task task);
+    //! Queue the task unless a task with the key was queued before, e.g. the prefetch of a path. Keys are
+    //! forgotten after a while, so data evicted in the meantime is prefetched again.
+    bool ScheduleOnce(const duckdb::string &key, Task task);
+    //! Wait until no task is queued or running.
+    void WaitIdle();
+
+private:
+    void Work();
+
+private:
+    const idx_t thread_count;
+    std::mutex prefetcher_mutex;
+    std::condition_variable work_available;
+    std::condition_variable idle;
+    std::deque<Task> tasks;
+    duckdb::vector<std::thread> threads;
+    idx_t running_tasks = 0;
+    bool stopping = false;
+    //! Keys of the tasks scheduled with ScheduleOnce
+    duckdb::unordered_set<duckdb::string> scheduled_keys;
+};
+
+}  // namespace quackstore
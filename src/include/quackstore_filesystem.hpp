@@ -1,16 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <duckdb.hpp>
 #include "cache.hpp"
+#include "cache_router.hpp"
+#include "prefetcher.hpp"
 
 namespace quackstore {
 
+struct ExtensionParams;
+
 class QuackstoreFileSystem : public duckdb::FileSystem {
 public:
     static constexpr const char* FILESYSTEM_NAME = "QuackstoreFileSystem";
     static constexpr const char* SCHEMA_PREFIX = "quackstore://";
+    //! Appended to the path of a compressed file to cache its decompressed stream under
+    static constexpr const char* DECOMPRESSED_SUFFIX = "#decompressed";
+    //! Artifact of a compressed file holding the size of its decompressed stream, stored once the whole stream is
+    static constexpr const char* DECOMPRESSED_SIZE_ARTIFACT = "decompressed_size";
+    //! Percentage of the max cache size the files of a glob may prefetch when less than that is free
+    static constexpr uint64_t GLOB_PREFETCH_PERCENT = 25;
 
+    //! Serve all files from the cache.
     QuackstoreFileSystem(Cache& cache);
+    //! Serve files from the caches picked by the router.
+    QuackstoreFileSystem(CacheRouter& router);
 
 public:
     // FileSystem methods
@@ -18,6 +33,10 @@ public:
                                     duckdb::optional_ptr<duckdb::FileOpener> opener = nullptr) override;
     void Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) override;
     int64_t Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) override;
+    //! Writes go to files opened for writing only, see quackstore_write_through
+    void Write(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) override;
+    int64_t Write(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) override;
+    void FileSync(duckdb::FileHandle &handle) override;
     int64_t GetFileSize(duckdb::FileHandle &handle) override;
     duckdb::string GetName() const override { return FILESYSTEM_NAME; }
     bool CanHandleFile(const duckdb::string &path) override;
@@ -27,11 +46,19 @@ public:
     idx_t SeekPosition(duckdb::FileHandle &handle) override;
     bool CanSeek() override { return true; }
     duckdb::timestamp_t GetLastModifiedTime(duckdb::FileHandle &handle) override;
+    //! Derived from the cached size and last modification time, so validating DuckDB's external file cache
+    //! doesn't ask the source
+    duckdb::string GetVersionTag(duckdb::FileHandle &handle) override;
     bool IsManuallySet() override { return true; }
 
 	//! Check if a file exists
 	bool FileExists(const duckdb::string &filename, duckdb::optional_ptr<duckdb::FileOpener> opener = nullptr) override;
 
+	//! Remove and move files of the source, their cached entries are evicted
+	void RemoveFile(const duckdb::string &filename, duckdb::optional_ptr<duckdb::FileOpener> opener = nullptr) override;
+	void MoveFile(const duckdb::string &source, const duckdb::string &target,
+	              duckdb::optional_ptr<duckdb::FileOpener> opener = nullptr) override;
+
 	//! Check if a directory exists
 	bool DirectoryExists(const duckdb::string &directory, duckdb::optional_ptr<duckdb::FileOpener> opener = nullptr) override;
 
@@ -44,9 +71,64 @@ public:
                                                                       duckdb::unique_ptr<duckdb::FileHandle> handle,
 	                                                                  bool write) override;
 
+    //! Used only for testing
+    void WaitForPrefetches() { prefetcher.WaitIdle(); }
+
+private:
+    static bool IsWriteHandle(duckdb::FileHandle &handle);
+    static void ValidateWriteHandle(duckdb::FileHandle &handle);
+    static void ValidateReadHandle(duckdb::FileHandle &handle);
+    void EvictWrittenFile(const duckdb::string &path);
+    //! Read the table metadata file into the cache in the background (if it isn't cached yet) and prefetch
+    //! the files it references, see quackstore_table_prefetch
+    void PrefetchTableMetadata(const duckdb::string &path, const ExtensionParams &params,
+                               duckdb::FileSystem &underlying_fs);
+    //! Fully cached files first (or alternating with the others, see quackstore_glob_order), the order of the
+    //! source is kept otherwise. The files not fully cached are prefetched.
+    duckdb::vector<duckdb::OpenFileInfo> OrderCachedFirst(duckdb::vector<duckdb::OpenFileInfo> entries,
+                                                          const ExtensionParams &params, duckdb::FileSystem &underlying_fs);
+    //! Read the whole file into the cache in the background, if its size is still within the budget (bytes left to
+    //! prefetch, shared by the files of a glob). The size is taken from the budget then.
+    void PrefetchFile(const duckdb::string &path, const ExtensionParams &params, duckdb::FileSystem &underlying_fs,
+                      std::shared_ptr<std::atomic<idx_t>> budget);
+    //! Read the footer of the Parquet file into the cache in the background
+    void PrefetchParquetFooter(const duckdb::string &path, const ExtensionParams &params,
+                               duckdb::FileSystem &underlying_fs);
+
+private:
+    duckdb::unique_ptr<CacheRouter> owned_router;
+    CacheRouter& router;
+    //! Declared last, so its tasks are done before the router goes away
+    Prefetcher prefetcher;
+};
+
+//! Registered for gzip-compressed files in place of DuckDB's gzip file system. Files read through the cache
+//! with quackstore_cache_decompressed set are decompressed into the cache once and then served from it like
+//! plain files, all other files are decompressed by DuckDB's gzip file system.
+class QuackstoreCompressedFileSystem : public duckdb::FileSystem {
+public:
+    static constexpr const char* FILESYSTEM_NAME = "QuackstoreCompressedFileSystem";
+
+    QuackstoreCompressedFileSystem();
+
+public:
+    duckdb::unique_ptr<duckdb::FileHandle> OpenCompressedFile(duckdb::QueryContext context,
+                                                              duckdb::unique_ptr<duckdb::FileHandle> handle,
+                                                              bool write) override;
+    void Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) override;
+    int64_t Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) override;
+    int64_t GetFileSize(duckdb::FileHandle &handle) override;
+    duckdb::timestamp_t GetLastModifiedTime(duckdb::FileHandle &handle) override;
+    duckdb::string GetVersionTag(duckdb::FileHandle &handle) override;
+    void Seek(duckdb::FileHandle &handle, idx_t location) override;
+    idx_t SeekPosition(duckdb::FileHandle &handle) override;
+    void Reset(duckdb::FileHandle &handle) override;
+    bool CanSeek() override { return true; }
+    bool OnDiskFile(duckdb::FileHandle &handle) override { return false; }
+    duckdb::string GetName() const override { return FILESYSTEM_NAME; }
 
 private:
-    Cache& cache;
+    duckdb::unique_ptr<duckdb::FileSystem> gzip_fs;
 };
 
 }  // namespace quackstore
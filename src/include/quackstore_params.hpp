@@ -1,6 +1,7 @@
 #pragma once
 
 #include "duckdb.hpp"
+#include "metadata_manager.hpp"
 
 namespace duckdb {
     class FileOpener;
@@ -11,6 +12,27 @@ namespace duckdb {
 
 namespace quackstore {
 
+//! A named cache serving the files under a path prefix, configured with the quackstore_caches setting.
+struct NamedCacheConfig {
+    duckdb::string name;
+    duckdb::string prefix;
+    duckdb::string path;
+    uint64_t max_cache_size = 0;
+    //! 0 keeps the block size of the cache
+    uint64_t block_size = 0;
+    bool dedup_enabled = false;
+};
+
+//! Order of the files matched by a glob, see quackstore_glob_order
+enum class GlobOrder {
+    //! The order of the source listing
+    SOURCE,
+    //! Fully cached files before the others
+    CACHED_FIRST,
+    //! Fully cached files alternating with the others
+    INTERLEAVED
+};
+
 struct ExtensionParams {
     static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_ENABLED = "quackstore_cache_enabled";
     static constexpr bool DEFAULT_QUACKSTORE_CACHE_ENABLED = false;
@@ -20,6 +42,45 @@ struct ExtensionParams {
     static constexpr uint64_t DEFAULT_QUACKSTORE_CACHE_SIZE = 2ULL * 1024 * 1024 * 1024; // 2 GB
     uint64_t max_cache_size = DEFAULT_QUACKSTORE_CACHE_SIZE;
 
+    static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_SIZE_AUTO = "quackstore_cache_size_auto";
+    static constexpr bool DEFAULT_QUACKSTORE_CACHE_SIZE_AUTO = false;
+    //! Derive the cache size from the free space of the cache volume, the cache size setting is the maximum
+    bool cache_size_auto = DEFAULT_QUACKSTORE_CACHE_SIZE_AUTO;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_SIZE_MIN = "quackstore_cache_size_min";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_CACHE_SIZE_MIN = 0;
+    uint64_t min_cache_size = DEFAULT_QUACKSTORE_CACHE_SIZE_MIN;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT = "quackstore_cache_reserved_free_percent";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT = 10;
+    //! Share of the cache volume left free for other use when the cache size is derived from the free space
+    uint64_t reserved_free_percent = DEFAULT_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_BACKGROUND_EVICTION = "quackstore_background_eviction";
+    static constexpr bool DEFAULT_QUACKSTORE_BACKGROUND_EVICTION = false;
+    //! Evict with a background thread between the watermarks instead of on every store
+    bool background_eviction = DEFAULT_QUACKSTORE_BACKGROUND_EVICTION;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_EVICTION_LOW_WATERMARK = "quackstore_eviction_low_watermark";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_EVICTION_LOW_WATERMARK = 90;
+    //! Percentage of the cache size background eviction evicts down to
+    uint64_t eviction_low_watermark = DEFAULT_QUACKSTORE_EVICTION_LOW_WATERMARK;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_EVICTION_HIGH_WATERMARK = "quackstore_eviction_high_watermark";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_EVICTION_HIGH_WATERMARK = 95;
+    //! Percentage of the cache size above which background eviction starts
+    uint64_t eviction_high_watermark = DEFAULT_QUACKSTORE_EVICTION_HIGH_WATERMARK;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_METADATA_BUDGET = "quackstore_metadata_budget";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_METADATA_BUDGET = 0;
+    //! Memory the metadata of a cache may hold, 0 for no budget
+    uint64_t metadata_budget = DEFAULT_QUACKSTORE_METADATA_BUDGET;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_WARMUP_SIZE = "quackstore_warmup_size";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_WARMUP_SIZE = 0;
+    //! Bytes of the most recently used blocks read into the OS page cache after a cache is opened, 0 for no warm-up
+    uint64_t warmup_size = DEFAULT_QUACKSTORE_WARMUP_SIZE;
+
     static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_PATH = "quackstore_cache_path";
     static constexpr const char* DEFAULT_QUACKSTORE_CACHE_PATH = "/tmp/duckdb_block_cache.bin";
     duckdb::string cache_path = DEFAULT_QUACKSTORE_CACHE_PATH;
@@ -28,6 +89,81 @@ struct ExtensionParams {
     static constexpr bool DEFAULT_QUACKSTORE_DATA_MUTABLE = true;
     bool data_mutable = DEFAULT_QUACKSTORE_DATA_MUTABLE;
 
+    static constexpr const auto PARAM_NAME_QUACKSTORE_DEDUP_ENABLED = "quackstore_dedup_enabled";
+    static constexpr bool DEFAULT_QUACKSTORE_DEDUP_ENABLED = false;
+    bool dedup_enabled = DEFAULT_QUACKSTORE_DEDUP_ENABLED;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_PACK_THRESHOLD = "quackstore_pack_threshold";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_PACK_THRESHOLD = 64ULL * 1024; // 64 KB
+    uint64_t pack_threshold = DEFAULT_QUACKSTORE_PACK_THRESHOLD;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_BLOCK_SIZE = "quackstore_block_size";
+    static constexpr uint64_t DEFAULT_QUACKSTORE_BLOCK_SIZE = 0; // Keep the block size of the cache (1 MB for new ones)
+    uint64_t block_size = DEFAULT_QUACKSTORE_BLOCK_SIZE;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_ADAPTIVE_BLOCK_SIZE = "quackstore_adaptive_block_size";
+    static constexpr bool DEFAULT_QUACKSTORE_ADAPTIVE_BLOCK_SIZE = false;
+    bool adaptive_block_size = DEFAULT_QUACKSTORE_ADAPTIVE_BLOCK_SIZE;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_CACHE_DECOMPRESSED = "quackstore_cache_decompressed";
+    static constexpr bool DEFAULT_QUACKSTORE_CACHE_DECOMPRESSED = false;
+    //! Cache the decompressed streams of gzip-compressed files instead of their compressed bytes
+    bool cache_decompressed = DEFAULT_QUACKSTORE_CACHE_DECOMPRESSED;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_WRITE_THROUGH = "quackstore_write_through";
+    static constexpr bool DEFAULT_QUACKSTORE_WRITE_THROUGH = false;
+    //! Store the blocks of files written through quackstore:// in the cache, they're only written to the source otherwise
+    bool write_through = DEFAULT_QUACKSTORE_WRITE_THROUGH;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_BACKING_TIER = "quackstore_backing_tier";
+    static constexpr bool DEFAULT_QUACKSTORE_BACKING_TIER = false;
+    //! The cache is the persistent tier behind DuckDB's external file cache, read blocks aren't kept in the page cache
+    bool backing_tier = DEFAULT_QUACKSTORE_BACKING_TIER;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_TABLE_PREFETCH = "quackstore_table_prefetch";
+    static constexpr bool DEFAULT_QUACKSTORE_TABLE_PREFETCH = false;
+    //! Prefetch the files referenced by Iceberg and Delta metadata files read through the cache, in the background
+    bool table_prefetch = DEFAULT_QUACKSTORE_TABLE_PREFETCH;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_GLOB_ORDER = "quackstore_glob_order";
+    static constexpr const char* DEFAULT_QUACKSTORE_GLOB_ORDER = "source";
+    //! Order of the files matched by globs, files not fully cached are prefetched unless it's the source order
+    GlobOrder glob_order = GlobOrder::SOURCE;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_STORAGE_LAYOUT = "quackstore_storage_layout";
+    static constexpr const char* DEFAULT_QUACKSTORE_STORAGE_LAYOUT = "in_place";
+    //! Layout of the cache files created, existing files keep theirs
+    StorageLayout storage_layout = StorageLayout::IN_PLACE;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_SHARED_CACHE = "quackstore_shared_cache";
+    static constexpr bool DEFAULT_QUACKSTORE_SHARED_CACHE = false;
+    bool shared_cache = DEFAULT_QUACKSTORE_SHARED_CACHE;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_LOWER_CACHE_PATH = "quackstore_lower_cache_path";
+    static constexpr const char* DEFAULT_QUACKSTORE_LOWER_CACHE_PATH = "";
+    //! Read-only cache file consulted on cache misses before the source file, empty for none
+    duckdb::string lower_cache_path = DEFAULT_QUACKSTORE_LOWER_CACHE_PATH;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_CACHES = "quackstore_caches";
+    static constexpr const char* DEFAULT_QUACKSTORE_CACHES = "";
+    //! Named caches, size, block size and deduplication default to the settings of the default cache
+    duckdb::vector<NamedCacheConfig> caches;
+
+    static constexpr const auto PARAM_NAME_QUACKSTORE_QUOTAS = "quackstore_quotas";
+    static constexpr const char* DEFAULT_QUACKSTORE_QUOTAS = "";
+    //! Byte quotas per path prefix within a cache
+    duckdb::vector<MetadataManager::Quota> quotas;
+
+    //! Parse the quotas: "prefix=bytes|percent%; ..."
+    static duckdb::vector<MetadataManager::Quota> ParseQuotas(const duckdb::string &value);
+    //! Parse the glob order: "source", "cached_first" or "interleaved"
+    static GlobOrder ParseGlobOrder(const duckdb::string &value);
+    //! Parse the storage layout: "in_place" or "segmented"
+    static StorageLayout ParseStorageLayout(const duckdb::string &value);
+    //! Parse the named caches: "name: prefix=..., path=...[, size=...][, block_size=...][, dedup=...]; ..."
+    static duckdb::vector<NamedCacheConfig> ParseNamedCaches(const duckdb::string &value,
+                                                             const ExtensionParams &defaults);
+
     static ExtensionParams ReadFrom(duckdb::optional_ptr<duckdb::FileOpener> opener);
     static ExtensionParams ReadFrom(const duckdb::ClientContext& context);
     static ExtensionParams ReadFrom(const duckdb::DatabaseInstance& instance);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+#include "block_manager.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// SegmentTable
+// =============================================================================
+
+//! Placement of the blocks of a segmented storage. The slots of the storage file are grouped into segments of
+//! equal size, blocks are appended at the head of the current segment and a block written again moves to the
+//! head, leaving a dead slot behind. Segments without live slots are reused once the head moves on and the table
+//! written to the storage file no longer refers to them, so a crash never leaves the stored table pointing to
+//! overwritten slots.
+class SegmentTable {
+public:
+    //! Location of a block: its first slot and the number of slots (more than one for extents).
+    struct Location {
+        uint64_t slot = 0;
+        uint64_t slot_count = 0;
+    };
+
+    explicit SegmentTable(uint64_t segment_slots);
+
+    void Clear();
+
+    uint64_t GetSegmentSlots() const { return segment_slots; }
+    //! Number of segments, the storage file holds this many times segment_slots slots.
+    uint64_t GetSegmentCount() const { return live_slots.size(); }
+    uint64_t GetLiveSlots(uint64_t segment) const { return live_slots[segment]; }
+    idx_t GetFreeSegmentCount() const { return free_segments.size(); }
+
+    bool TryGetLocation(block_id_t block_id, Location &location_out) const;
+    //! Place the block at the head, its previous location turns dead. A block longer than a segment is placed
+    //! into new segments at the end of the storage. Returns the first slot of the block.
+    uint64_t Place(block_id_t block_id, uint64_t slot_count);
+    //! Record a block at a known location, e.g. one stored outside of the table.
+    void Restore(block_id_t block_id, const Location &location);
+    //! The location of the block turns dead.
+    void Remove(block_id_t block_id);
+
+    //! The segment with the smallest share of live slots if it's below live_percent, not counting the head and
+    //! the segments holding the keep_block_id block. Returns false if there is no such segment.
+    bool FindSparseSegment(uint8_t live_percent, block_id_t keep_block_id, uint64_t &segment_out) const;
+    //! Blocks starting in the segment, in slot order.
+    duckdb::vector<block_id_t> GetSegmentBlocks(uint64_t segment) const;
+
+    //! Blocks with negative ids aren't written, their location is kept elsewhere.
+    void Write(duckdb::WriteStream &ser) const;
+    void Read(duckdb::ReadStream &source);
+    //! The segments emptied before the last Write become reusable. Called once the storage file refers to the
+    //! written table instead of the previous one.
+    void ReleasePendingSegments();
+
+private:
+    //! Move the head to a free segment, or to a new segment at the end of the storage.
+    void OpenSegment();
+    void AddLiveSlots(const Location &location);
+    void RemoveLiveSlots(const Location &location);
+
+    static constexpr uint64_t NO_SEGMENT = duckdb::NumericLimits<uint64_t>::Maximum();
+
+    uint64_t segment_slots;
+    duckdb::unordered_map<block_id_t, Location> locations;
+    //! Block starting at each used slot, sorted so the blocks of a segment are a range
+    duckdb::map<uint64_t, block_id_t> slot_blocks;
+    //! Number of live slots per segment
+    duckdb::vector<uint64_t> live_slots;
+    //! Segments without live slots, reused before the storage grows
+    duckdb::set<uint64_t> free_segments;
+    //! Segments without live slots the stored table may still refer to, freed by ReleasePendingSegments
+    duckdb::set<uint64_t> pending_segments;
+    //! The segment blocks are appended to and its next slot
+    uint64_t head_segment = NO_SEGMENT;
+    uint64_t head_slot = 0;
+};
+
+}  // namespace quackstore
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <duckdb.hpp>
+
+namespace quackstore {
+
+// =============================================================================
+// TableFormat
+// =============================================================================
+
+//! Recognizes the metadata files of lakehouse table formats and extracts the files they reference, so they can
+//! be prefetched before the table reader asks for them one after the other:
+//!   Iceberg table metadata (*.metadata.json) -> manifest list of the current snapshot
+//!   Iceberg manifest list (snap-*.avro)      -> manifests
+//!   Iceberg manifest (other *.avro)          -> data files
+//!   Delta log (_delta_log/*.json)            -> data files of the add actions
+//! The files are scanned for the references, without interpreting the schemas of the formats.
+class TableFormat {
+public:
+    enum class FileKind {
+        NONE,
+        ICEBERG_METADATA,
+        ICEBERG_MANIFEST_LIST,
+        ICEBERG_MANIFEST,
+        DELTA_LOG
+    };
+
+    struct References {
+        //! Metadata files, read whole (and scanned for their references in turn)
+        duckdb::vector<duckdb::string> metadata_files;
+        //! Data files, only their footers are read
+        duckdb::vector<duckdb::string> data_files;
+    };
+
+    //! Metadata files larger than this aren't scanned
+    static constexpr idx_t MAX_METADATA_FILE_SIZE = 64ULL << 20;
+
+    static FileKind Classify(const duckdb::string &path);
+    //! References of the file at the path, relative references are resolved against the table location.
+    static References ExtractReferences(FileKind kind, const duckdb::string &path, const duckdb::string &content);
+
+    //! Decoded data of the blocks of an Avro object container file (null and deflate codecs).
+    static duckdb::string ReadAvroData(const duckdb::string &content);
+    //! Avro strings (length-prefixed) in the data ending with one of the suffixes
+    static duckdb::vector<duckdb::string> FindAvroStrings(const duckdb::string &data,
+                                                          const duckdb::vector<duckdb::string> &suffixes);
+};
+
+}  // namespace quackstore
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <limits>
 #include <ctime>
 
@@ -20,6 +21,22 @@ void MetadataManager::FileMetadata::Write(duckdb::WriteStream &ser) const {
     }
     ser.Write(__last_modified_deprecated); // Write the last modified timestamp (deprecated field: __last_modified_deprecated)
     ser.Write(last_modified.value); // Write the last modified timestamp
+
+    // Write locations of partial blocks (added in v4, appended to keep the older layout a prefix of the new one)
+    uint32_t num_partial_blocks = 0;
+    for (const auto &block_entry : blocks) {
+        num_partial_blocks += block_entry.second.HasLength() ? 1 : 0;
+    }
+    ser.Write<uint32_t>(num_partial_blocks);
+    for (const auto &block_entry : blocks) {
+        const auto &block = block_entry.second;
+        if (!block.HasLength()) {
+            continue;
+        }
+        ser.Write(block.block_id);
+        ser.Write(block.offset);
+        ser.Write(block.length);
+    }
 }
 
 MetadataManager::FileMetadata MetadataManager::FileMetadata::Read(duckdb::ReadStream &source, uint32_t version) {
@@ -35,6 +52,11 @@ MetadataManager::FileMetadata MetadataManager::FileMetadata::Read(duckdb::ReadSt
         case 3:
             ReadV3(source, result);
         break;
+        case 4:
+        case 5: // v5 and v6 changed only the storage header
+        case 6:
+            ReadV4(source, result);
+        break;
         default:
             throw duckdb::IOException("Unsupported file metadata version [" + std::to_string(version) + "]");
         break;
@@ -48,7 +70,11 @@ duckdb::string MetadataManager::FileMetadata::ToString() const {
     result += " blocks={";
     for (const auto& pair: blocks) {
         const auto& block = pair.second;
-        result += " {" + std::to_string(block.block_index) + ": " + std::to_string(block.block_id) + "}";
+        result += " {" + std::to_string(block.block_index) + ": " + std::to_string(block.block_id);
+        if (block.HasLength()) {
+            result += " @" + std::to_string(block.offset) + "+" + std::to_string(block.length);
+        }
+        result += "}";
     }
     result += "}";
     result += " __last_modified_deprecated=" + std::to_string(__last_modified_deprecated);
@@ -83,6 +109,22 @@ void MetadataManager::FileMetadata::ReadV3(duckdb::ReadStream &source, MetadataM
     ReadV2(source, out);
     out.last_modified = duckdb::timestamp_t{source.Read<int64_t>()};
 }
+void MetadataManager::FileMetadata::ReadV4(duckdb::ReadStream &source, MetadataManager::FileMetadata& out)
+{
+    ReadV3(source, out);
+    uint32_t num_partial_blocks = source.Read<uint32_t>();
+    for (uint32_t i = 0; i < num_partial_blocks; ++i) {
+        block_id_t block_id = source.Read<int64_t>();
+        uint64_t offset = source.Read<uint64_t>();
+        uint64_t length = source.Read<uint64_t>();
+        auto it = out.blocks.find(block_id);
+        if (it == out.blocks.end()) {
+            throw duckdb::IOException("Partial block location refers to unknown block [" + std::to_string(block_id) + "]");
+        }
+        it->second.offset = offset;
+        it->second.length = length;
+    }
+}
 
 // =============================================================================
 // MetadataManager
@@ -91,12 +133,28 @@ void MetadataManager::FileMetadata::ReadV3(duckdb::ReadStream &source, MetadataM
 MetadataManager::MetadataManager() : max_cache_size(std::numeric_limits<int64_t>::max()) {}
 MetadataManager::~MetadataManager() {}
 
+void MetadataManager::SetBlockSize(uint64_t new_block_size) { block_size = new_block_size; }
+
 void MetadataManager::Clear() {
     block_mapping.clear();
     reverse_block_mapping.clear();
+    content_index.clear();
     files_metadata.clear();
+    empty_files.clear();
+    file_path_bytes = 0;
+    block_key_path_bytes = 0;
     lru_list.clear();
     lru_map.clear();
+    retained_blocks.clear();
+    block_bytes.clear();
+    cached_bytes = 0;
+    block_groups.clear();
+    group_bytes.assign(quotas.size() + 1, 0);
+    group_blocks.assign(quotas.size() + 1, 0);
+    group_lru_lists.assign(quotas.size(), {});
+    group_lru_map.clear();
+    open_slab_id = BlockManager::INVALID_BLOCK_ID;
+    open_slab_end = 0;
 }
 
 block_id_t MetadataManager::GetBlockId(const duckdb::string &file_path, int64_t block_index) const {
@@ -109,36 +167,71 @@ block_id_t MetadataManager::GetBlockId(const duckdb::string &file_path, int64_t
 }
 
 void MetadataManager::RegisterBlock(const duckdb::string &file_path, int64_t block_index, block_id_t block_id,
-                                    uint64_t checksum) {
+                                    uint64_t checksum, uint64_t offset, uint64_t length) {
     BlockKey key{file_path, block_index};
+    FileMetadataBlockInfo block_info{block_index, block_id, checksum, offset, length};
 
-    reverse_block_mapping[block_id] = key;
-    block_mapping[key] = block_id;
+    reverse_block_mapping[block_id].push_back(key);
+    if (block_mapping.insert_or_assign(key, block_id).second) {
+        block_key_path_bytes += file_path.size();
+    }
+    content_index[checksum] = block_info;
+    AccountBlockBytes(file_path, block_id, block_info);
 
-    FileMetadata &file_metadata = files_metadata[file_path];
-    FileMetadataBlockInfo block_info{block_index, block_id, checksum};
-    file_metadata.blocks[block_id] = block_info;
+    auto file_it = AddFile(file_path);
+    if (file_it->second.blocks.empty()) {
+        empty_files.erase(&file_it->first);
+    }
+    file_it->second.blocks[block_id] = block_info;
 }
 
 void MetadataManager::UnregisterBlock(block_id_t block_id) {
-    auto block_key_it = reverse_block_mapping.find(block_id);
-    if (block_key_it != reverse_block_mapping.end()) {
-        const BlockKey &key = block_key_it->second;
-
-        // Remove the block from the metadata
-        auto file_metadata_it = files_metadata.find(key.file_path);
-        if (file_metadata_it != files_metadata.end()) {
-            auto &blocks = file_metadata_it->second.blocks;
-            blocks.erase(block_id);
-            if (blocks.empty()) {
-                files_metadata.erase(file_metadata_it);
+    auto block_keys_it = reverse_block_mapping.find(block_id);
+    if (block_keys_it != reverse_block_mapping.end()) {
+        for (const BlockKey &key : block_keys_it->second) {
+            // Remove the block from the metadata
+            auto file_metadata_it = files_metadata.find(key.file_path);
+            if (file_metadata_it != files_metadata.end()) {
+                auto &blocks = file_metadata_it->second.blocks;
+                auto block_it = blocks.find(block_id);
+                if (block_it != blocks.end()) {
+                    auto content_it = content_index.find(block_it->second.checksum);
+                    if (content_it != content_index.end() && content_it->second.block_id == block_id) {
+                        content_index.erase(content_it);
+                    }
+                    blocks.erase(block_it);
+                }
+                if (blocks.empty()) {
+                    EraseFile(file_metadata_it);
+                }
+            }
+
+            // Remove from block_mapping
+            if (block_mapping.erase(key) != 0) {
+                block_key_path_bytes -= key.file_path.size();
             }
         }
+        reverse_block_mapping.erase(block_keys_it);
+    }
+
+    auto block_bytes_it = block_bytes.find(block_id);
+    if (block_bytes_it != block_bytes.end()) {
+        cached_bytes -= block_bytes_it->second;
+        RemoveFromGroupLRU(block_id);
+        auto group_it = block_groups.find(block_id);
+        if (group_it != block_groups.end()) {
+            group_bytes[group_it->second] -= block_bytes_it->second;
+            --group_blocks[group_it->second];
+            block_groups.erase(group_it);
+        }
+        block_bytes.erase(block_bytes_it);
+    }
 
-        // Remove from block_mapping and reverse_block_mapping
-        block_mapping.erase(key);
-        reverse_block_mapping.erase(block_key_it);
+    if (block_id == open_slab_id) {
+        open_slab_id = BlockManager::INVALID_BLOCK_ID;
+        open_slab_end = 0;
     }
+    retained_blocks.erase(block_id);
 
     // Remove from the LRU tracking
     auto lru_map_it = lru_map.find(block_id);
@@ -150,14 +243,53 @@ void MetadataManager::UnregisterBlock(block_id_t block_id) {
     }
 }
 
+bool MetadataManager::UnregisterFileBlock(const duckdb::string &file_path, int64_t block_index) {
+    BlockKey key{file_path, block_index};
+    auto block_it = block_mapping.find(key);
+    if (block_it == block_mapping.end()) {
+        return false;
+    }
+    const block_id_t block_id = block_it->second;
+
+    auto block_keys_it = reverse_block_mapping.find(block_id);
+    if (block_keys_it == reverse_block_mapping.end() || block_keys_it->second.size() <= 1) {
+        // This was the only file block referring to the block_id
+        UnregisterBlock(block_id);
+        return true;
+    }
+
+    auto &block_keys = block_keys_it->second;
+    block_keys.erase(std::remove(block_keys.begin(), block_keys.end(), key), block_keys.end());
+    block_mapping.erase(block_it);
+    block_key_path_bytes -= file_path.size();
+
+    auto file_metadata_it = files_metadata.find(file_path);
+    if (file_metadata_it != files_metadata.end()) {
+        auto &blocks = file_metadata_it->second.blocks;
+        auto block_info_it = blocks.find(block_id);
+        if (block_info_it != blocks.end()) {
+            // Packed data of this file block is gone, stop offering it for deduplication
+            const auto &block_info = block_info_it->second;
+            auto content_it = content_index.find(block_info.checksum);
+            if (content_it != content_index.end() && content_it->second.block_id == block_id &&
+                content_it->second.offset == block_info.offset) {
+                content_index.erase(content_it);
+            }
+            blocks.erase(block_info_it);
+        }
+        if (blocks.empty()) {
+            EraseFile(file_metadata_it);
+        }
+    }
+    return false;
+}
+
 void MetadataManager::SetFileSize(const duckdb::string &file_path, int64_t file_size) {
-    auto& entry = files_metadata[file_path];
-    entry.file_size = file_size;
+    AddFile(file_path)->second.file_size = file_size;
 }
 
 void MetadataManager::SetFileLastModified(const duckdb::string &file_path, duckdb::timestamp_t timestamp) {
-    auto& entry = files_metadata[file_path];
-    entry.last_modified = timestamp;
+    AddFile(file_path)->second.last_modified = timestamp;
 }
 
 bool MetadataManager::GetFileMetadata(const duckdb::string &file_path, FileMetadata &file_metadata_out) const {
@@ -170,24 +302,232 @@ bool MetadataManager::GetFileMetadata(const duckdb::string &file_path, FileMetad
     return true;
 }
 
+duckdb::vector<duckdb::string> MetadataManager::GetFilePaths() const {
+    duckdb::vector<duckdb::string> result;
+    result.reserve(files_metadata.size());
+    for (const auto &[file_path, _] : files_metadata) {
+        result.push_back(file_path);
+    }
+    return result;
+}
+
+duckdb::vector<duckdb::string> MetadataManager::GetFilePathsWithPrefix(const duckdb::string &prefix) const {
+    duckdb::vector<duckdb::string> result;
+    for (auto it = files_metadata.lower_bound(prefix);
+         it != files_metadata.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        result.push_back(it->first);
+    }
+    return result;
+}
+
+namespace {
+
+bool MatchCharClass(const char *&pattern, char c) {
+    // pattern points after '[', it's left after the closing ']'
+    const bool negate = *pattern == '!' || *pattern == '^';
+    if (negate) {
+        ++pattern;
+    }
+    bool matched = false;
+    for (bool first = true; *pattern && (first || *pattern != ']'); first = false) {
+        if (pattern[1] == '-' && pattern[2] && pattern[2] != ']') {
+            matched = matched || (pattern[0] <= c && c <= pattern[2]);
+            pattern += 3;
+        } else {
+            matched = matched || *pattern == c;
+            ++pattern;
+        }
+    }
+    if (*pattern == ']') {
+        ++pattern;
+    }
+    return matched != negate;
+}
+
+bool MatchGlob(const char *path, const char *pattern) {
+    while (*pattern) {
+        if (pattern[0] == '*' && pattern[1] == '*') {
+            pattern += 2;
+            for (const char *rest = path;; ++rest) {
+                if (MatchGlob(rest, pattern)) {
+                    return true;
+                }
+                if (!*rest) {
+                    return false;
+                }
+            }
+        }
+        if (*pattern == '*') {
+            ++pattern;
+            for (const char *rest = path;; ++rest) {
+                if (MatchGlob(rest, pattern)) {
+                    return true;
+                }
+                if (!*rest || *rest == '/') {
+                    return false;
+                }
+            }
+        }
+        if (!*path) {
+            return false;
+        }
+        if (*pattern == '?') {
+            if (*path == '/') {
+                return false;
+            }
+            ++pattern;
+        } else if (*pattern == '[') {
+            ++pattern;
+            if (*path == '/' || !MatchCharClass(pattern, *path)) {
+                return false;
+            }
+        } else if (*pattern++ != *path) {
+            return false;
+        }
+        ++path;
+    }
+    return !*path;
+}
+
+}  // namespace
+
+duckdb::vector<duckdb::string> MetadataManager::GetFilePathsMatching(const duckdb::string &pattern) const {
+    auto full_pattern = pattern;
+    if (!full_pattern.empty() && full_pattern.back() == '/') {
+        full_pattern += "**";
+    }
+    const auto literal_prefix = full_pattern.substr(0, full_pattern.find_first_of("*?["));
+
+    duckdb::vector<duckdb::string> result;
+    for (auto it = files_metadata.lower_bound(literal_prefix);
+         it != files_metadata.end() && it->first.compare(0, literal_prefix.size(), literal_prefix) == 0; ++it) {
+        if (MatchGlob(it->first.c_str(), full_pattern.c_str())) {
+            result.push_back(it->first);
+        }
+    }
+    return result;
+}
+
+idx_t MetadataManager::UnregisterFileBlocks(const duckdb::string &file_path,
+                                            const std::function<void(block_id_t)> &release_func) {
+    auto file_it = files_metadata.find(file_path);
+    if (file_it == files_metadata.end()) {
+        return 0;
+    }
+    // Unregistering the last block removes the file entry
+    duckdb::vector<std::pair<int64_t, block_id_t>> file_blocks;
+    file_blocks.reserve(file_it->second.blocks.size());
+    for (const auto &[block_id, block_info] : file_it->second.blocks) {
+        file_blocks.emplace_back(block_info.block_index, block_id);
+    }
+    for (const auto &[block_index, block_id] : file_blocks) {
+        UnregisterFileBlock(file_path, block_index);
+        release_func(block_id);
+    }
+    return file_blocks.size();
+}
+
+bool MetadataManager::RenameFile(const duckdb::string &file_path, const duckdb::string &new_path) {
+    auto file_it = files_metadata.find(file_path);
+    if (file_it == files_metadata.end() || file_path == new_path) {
+        return file_it != files_metadata.end();
+    }
+    auto target_it = files_metadata.find(new_path);
+    if (target_it != files_metadata.end()) {
+        D_ASSERT(target_it->second.blocks.empty());
+        EraseFile(target_it);
+    }
+    const bool empty = empty_files.erase(&file_it->first) != 0;
+
+    for (const auto &[block_id, block_info] : file_it->second.blocks) {
+        const BlockKey old_key{file_path, block_info.block_index};
+        const BlockKey new_key{new_path, block_info.block_index};
+        block_mapping.erase(old_key);
+        block_mapping[new_key] = block_id;
+        for (auto &key : reverse_block_mapping[block_id]) {
+            if (key == old_key) {
+                key = new_key;
+            }
+        }
+    }
+    block_key_path_bytes += file_it->second.blocks.size() * new_path.size();
+    block_key_path_bytes -= file_it->second.blocks.size() * file_path.size();
+
+    auto node = files_metadata.extract(file_it);
+    node.key() = new_path;
+    auto renamed_it = files_metadata.insert(std::move(node)).position;
+    if (empty) {
+        empty_files.insert(&renamed_it->first);
+    }
+    file_path_bytes += new_path.size();
+    file_path_bytes -= file_path.size();
+    return true;
+}
+
+void MetadataManager::RetainBlock(block_id_t block_id) {
+    if (reverse_block_mapping.find(block_id) == reverse_block_mapping.end()) {
+        return;
+    }
+    retained_blocks.insert(block_id);
+}
+
+bool MetadataManager::IsBlockRetained(block_id_t block_id) const {
+    return retained_blocks.find(block_id) != retained_blocks.end();
+}
+
 void MetadataManager::UpdateLRUOrder(block_id_t block_id) {
     if (lru_map.find(block_id) != lru_map.end()) {
         lru_list.erase(lru_map[block_id]);
     }
     lru_list.push_front(block_id);
     lru_map[block_id] = lru_list.begin();
+    UpdateGroupLRUOrder(block_id);
+}
+
+bool MetadataManager::EvictLRUBlockIfNeeded(std::function<void(block_id_t)> remove_from_storage_func,
+                                            block_id_t keep_block_id) {
+    const auto unlimited = duckdb::NumericLimits<idx_t>::Maximum();
+    const auto evicted = EvictOverQuotaBlocks(max_cache_size, unlimited, remove_from_storage_func, keep_block_id);
+    return EvictLRUBlocks(max_cache_size, unlimited, remove_from_storage_func, keep_block_id) + evicted > 0;
 }
 
-void MetadataManager::EvictLRUBlockIfNeeded(std::function<void(block_id_t)> remove_from_storage_func) {
-    while (lru_map.size() > max_cache_size) {
-        if (!lru_list.empty()) {
-            const auto &block_id = lru_list.back();
+idx_t MetadataManager::EvictLRUBlocks(uint64_t target_bytes, idx_t max_blocks,
+                                      const std::function<void(block_id_t)> &remove_from_storage_func,
+                                      block_id_t keep_block_id) {
+    idx_t evicted_blocks = 0;
+    if (retained_blocks.empty()) {
+        while (cached_bytes > target_bytes && evicted_blocks < max_blocks && !lru_list.empty()) {
+            const auto block_id = lru_list.back();
+            if (block_id == keep_block_id) {
+                // Only the block we have to keep is left
+                break;
+            }
             // Remove from the storage
             remove_from_storage_func(block_id);
             // Remove from the metadata
             UnregisterBlock(block_id);
+            ++evicted_blocks;
+        }
+        return evicted_blocks;
+    }
+
+    // Walk from the least recently used block, the retained blocks are taken only once no other block is left
+    for (bool evict_retained : {false, true}) {
+        for (auto it = lru_list.end();
+             it != lru_list.begin() && cached_bytes > target_bytes && evicted_blocks < max_blocks;) {
+            auto victim_it = std::prev(it);
+            const auto block_id = *victim_it;
+            if (block_id == keep_block_id || (!evict_retained && IsBlockRetained(block_id))) {
+                it = victim_it;
+                continue;
+            }
+            // Erases victim_it from the list, it stays valid
+            remove_from_storage_func(block_id);
+            UnregisterBlock(block_id);
+            ++evicted_blocks;
         }
     }
+    return evicted_blocks;
 }
 
 void MetadataManager::WriteMetadata(MetadataWriter &writer) {
@@ -215,8 +555,22 @@ void MetadataManager::WriteMetadata(MetadataWriter &writer) {
 
 void MetadataManager::ReadMetadata(MetadataReader &reader, uint32_t version) {
     files_metadata.clear();
+    empty_files.clear();
+    file_path_bytes = 0;
+    block_key_path_bytes = 0;
+    retained_blocks.clear();
     block_mapping.clear();
     reverse_block_mapping.clear();
+    content_index.clear();
+    block_bytes.clear();
+    cached_bytes = 0;
+    block_groups.clear();
+    group_bytes.assign(quotas.size() + 1, 0);
+    group_blocks.assign(quotas.size() + 1, 0);
+    group_lru_lists.assign(quotas.size(), {});
+    group_lru_map.clear();
+    open_slab_id = BlockManager::INVALID_BLOCK_ID;
+    open_slab_end = 0;
 
     uint64_t num_files = reader.Read<uint64_t>();
     // Deserialize each file's metadata
@@ -227,15 +581,23 @@ void MetadataManager::ReadMetadata(MetadataReader &reader, uint32_t version) {
         reader.ReadData(reinterpret_cast<uint8_t *>(&file_path[0]), path_size);
 
         // Deserialize the file metadata
-        FileMetadata file_metadata = FileMetadata::Read(reader, version);
-        files_metadata[file_path] = file_metadata;
+        auto file_it = AddFile(file_path);
+        auto &file_metadata = file_it->second;
+        file_metadata = FileMetadata::Read(reader, version);
+        if (!file_metadata.blocks.empty()) {
+            empty_files.erase(&file_it->first);
+        }
 
         // Update the block mapping with block indices and ids
         for (const auto &block_entry : file_metadata.blocks) {
             const auto &block = block_entry.second;
             BlockKey block_key{file_path, block.block_index};
-            block_mapping[block_key] = block.block_id;
-            reverse_block_mapping[block.block_id] = block_key;
+            if (block_mapping.insert_or_assign(block_key, block.block_id).second) {
+                block_key_path_bytes += file_path.size();
+            }
+            reverse_block_mapping[block.block_id].push_back(block_key);
+            content_index[block.checksum] = block;
+            AccountBlockBytes(file_path, block.block_id, block);
         }
     }
 
@@ -249,9 +611,131 @@ void MetadataManager::ReadMetadata(MetadataReader &reader, uint32_t version) {
         lru_list.push_back(block_id);
         lru_map[block_id] = std::prev(lru_list.end());
     }
+    RebuildGroupLRU();
 }
 
-void MetadataManager::SetMaxCacheSize(idx_t max_cache_size_in_blocks) { max_cache_size = max_cache_size_in_blocks; }
+void MetadataManager::SetMaxCacheSize(idx_t max_cache_size_in_bytes) { max_cache_size = max_cache_size_in_bytes; }
+
+void MetadataManager::SetQuotas(const duckdb::vector<Quota> &new_quotas) {
+    if (new_quotas == quotas) {
+        return;
+    }
+    quotas = new_quotas;
+    RebuildGroups();
+}
+
+duckdb::vector<MetadataManager::GroupUsage> MetadataManager::GetGroupUsage() const {
+    duckdb::vector<GroupUsage> result;
+    result.reserve(quotas.size() + 1);
+    for (idx_t group = 0; group < quotas.size(); ++group) {
+        result.push_back({quotas[group].prefix, quotas[group].GetLimit(max_cache_size), group_bytes[group],
+                          group_blocks[group]});
+    }
+    result.push_back({"", max_cache_size, group_bytes.back(), group_blocks.back()});
+    return result;
+}
+
+idx_t MetadataManager::GetGroup(const duckdb::string &file_path) const {
+    // Files are cached under their quackstore:// path, quotas are given for the paths of the source files
+    static const duckdb::string SCHEMA_PREFIX = "quackstore://";
+    const idx_t skip = file_path.rfind(SCHEMA_PREFIX, 0) == 0 ? SCHEMA_PREFIX.size() : 0;
+
+    idx_t result = quotas.size();
+    for (idx_t group = 0; group < quotas.size(); ++group) {
+        const auto &prefix = quotas[group].prefix;
+        if (file_path.compare(skip, prefix.size(), prefix) == 0 && (result == quotas.size() || prefix.size() > quotas[result].prefix.size())) {
+            result = group;
+        }
+    }
+    return result;
+}
+
+idx_t MetadataManager::EvictOverQuotaBlocks(uint64_t target_bytes, idx_t max_blocks,
+                                            const std::function<void(block_id_t)> &remove_from_storage_func,
+                                            block_id_t keep_block_id) {
+    idx_t evicted_blocks = 0;
+    while (cached_bytes > target_bytes && evicted_blocks < max_blocks) {
+        // The group furthest over its quota gives up its least recently used block
+        block_id_t victim = BlockManager::INVALID_BLOCK_ID;
+        uint64_t max_excess = 0;
+        for (idx_t group = 0; group < quotas.size(); ++group) {
+            const auto limit = quotas[group].GetLimit(max_cache_size);
+            if (group_bytes[group] <= limit || group_bytes[group] - limit <= max_excess) {
+                continue;
+            }
+            const auto group_victim = GetGroupVictim(group, keep_block_id);
+            if (group_victim != BlockManager::INVALID_BLOCK_ID) {
+                victim = group_victim;
+                max_excess = group_bytes[group] - limit;
+            }
+        }
+        if (victim == BlockManager::INVALID_BLOCK_ID) {
+            break;
+        }
+        remove_from_storage_func(victim);
+        UnregisterBlock(victim);
+        ++evicted_blocks;
+    }
+    return evicted_blocks;
+}
+
+void MetadataManager::RebuildGroups() {
+    block_groups.clear();
+    group_bytes.assign(quotas.size() + 1, 0);
+    group_blocks.assign(quotas.size() + 1, 0);
+    for (const auto &[block_id, bytes] : block_bytes) {
+        auto keys_it = reverse_block_mapping.find(block_id);
+        const idx_t group = keys_it != reverse_block_mapping.end() && !keys_it->second.empty()
+                                ? GetGroup(keys_it->second.front().file_path)
+                                : quotas.size();
+        block_groups[block_id] = group;
+        group_bytes[group] += bytes;
+        ++group_blocks[group];
+    }
+    RebuildGroupLRU();
+}
+
+void MetadataManager::RebuildGroupLRU() {
+    group_lru_lists.assign(quotas.size(), {});
+    group_lru_map.clear();
+    if (quotas.empty()) {
+        return;
+    }
+    // Walked from the least recently used block, each one moves to the front of its group
+    for (auto it = lru_list.rbegin(); it != lru_list.rend(); ++it) {
+        UpdateGroupLRUOrder(*it);
+    }
+}
+
+void MetadataManager::UpdateGroupLRUOrder(block_id_t block_id) {
+    auto group_it = block_groups.find(block_id);
+    if (group_it == block_groups.end() || group_it->second >= quotas.size()) {
+        return;
+    }
+    RemoveFromGroupLRU(block_id);
+    auto &group_lru = group_lru_lists[group_it->second];
+    group_lru.push_front(block_id);
+    group_lru_map[block_id] = {group_it->second, group_lru.begin()};
+}
+
+void MetadataManager::RemoveFromGroupLRU(block_id_t block_id) {
+    auto it = group_lru_map.find(block_id);
+    if (it == group_lru_map.end()) {
+        return;
+    }
+    group_lru_lists[it->second.first].erase(it->second.second);
+    group_lru_map.erase(it);
+}
+
+block_id_t MetadataManager::GetGroupVictim(idx_t group, block_id_t keep_block_id) const {
+    const auto &group_lru = group_lru_lists[group];
+    for (auto it = group_lru.rbegin(); it != group_lru.rend(); ++it) {
+        if (*it != keep_block_id) {
+            return *it;
+        }
+    }
+    return BlockManager::INVALID_BLOCK_ID;
+}
 
 MetadataManager::FileMetadataBlockInfo MetadataManager::GetBlockInfo(const duckdb::string &file_path,
                                                                      block_id_t block_id) const {
@@ -266,14 +750,205 @@ MetadataManager::FileMetadataBlockInfo MetadataManager::GetBlockInfo(const duckd
     throw std::runtime_error("Block info not found for the given file path and block index!");
 }
 
+bool MetadataManager::FindBlockByChecksum(uint64_t checksum, const duckdb::string &file_path,
+                                          FileMetadataBlockInfo &block_info_out) const {
+    auto content_it = content_index.find(checksum);
+    if (content_it == content_index.end()) {
+        return false;
+    }
+    const auto &block_info = content_it->second;
+
+    // The block may have been freed since (e.g. a slab block after its last packed block is gone)
+    if (reverse_block_mapping.find(block_info.block_id) == reverse_block_mapping.end()) {
+        return false;
+    }
+    // FileMetadata keeps blocks by block_id, hence one file can't refer to the same block twice
+    if (FileHasBlock(file_path, block_info.block_id)) {
+        return false;
+    }
+    block_info_out = block_info;
+    return true;
+}
+
+bool MetadataManager::FileHasBlock(const duckdb::string &file_path, block_id_t block_id) const {
+    auto file_it = files_metadata.find(file_path);
+    return file_it != files_metadata.end() && file_it->second.blocks.find(block_id) != file_it->second.blocks.end();
+}
+
+idx_t MetadataManager::GetBlockRefCount(block_id_t block_id) const {
+    auto it = reverse_block_mapping.find(block_id);
+    return it != reverse_block_mapping.end() ? it->second.size() : 0;
+}
+
+duckdb::vector<std::pair<block_id_t, idx_t>> MetadataManager::GetSharedBlocks() const {
+    duckdb::vector<std::pair<block_id_t, idx_t>> result;
+    for (const auto &[block_id, block_keys] : reverse_block_mapping) {
+        if (block_keys.size() > 1) {
+            result.emplace_back(block_id, block_keys.size());
+        }
+    }
+    return result;
+}
+
+duckdb::vector<std::pair<block_id_t, idx_t>> MetadataManager::GetExtents() const {
+    duckdb::vector<std::pair<block_id_t, idx_t>> result;
+    for (const auto &[block_id, bytes] : block_bytes) {
+        if (bytes > block_size) {
+            result.emplace_back(block_id, (bytes + block_size - 1) / block_size);
+        }
+    }
+    return result;
+}
+
+int64_t MetadataManager::FindCoveringBlockIndex(const duckdb::string &file_path, int64_t block_index,
+                                                uint8_t max_extent_shift) const {
+    auto file_it = files_metadata.find(file_path);
+    if (file_it == files_metadata.end()) {
+        return -1;
+    }
+
+    for (uint8_t shift = 0; shift <= max_extent_shift; ++shift) {
+        const int64_t start_index = block_index & ~((int64_t(1) << shift) - 1);
+        auto it = block_mapping.find({file_path, start_index});
+        if (it == block_mapping.end()) {
+            continue;
+        }
+        const auto &block_info = file_it->second.blocks.at(it->second);
+        const auto num_blocks = static_cast<int64_t>((block_info.GetLength(block_size) + block_size - 1) / block_size);
+        if (block_index < start_index + num_blocks) {
+            return start_index;
+        }
+    }
+    return -1;
+}
+
+block_id_t MetadataManager::GetOpenSlab(uint64_t &end_offset_out) const {
+    end_offset_out = open_slab_end;
+    return open_slab_id;
+}
+
+void MetadataManager::SetOpenSlab(block_id_t block_id, uint64_t end_offset) {
+    open_slab_id = block_id;
+    open_slab_end = end_offset;
+}
+
+uint64_t MetadataManager::GetMetadataBytes() const {
+    // Estimated from the entry counts with the usual node layouts: hash map entries take a node with the next
+    // pointer and the cached hash plus a bucket, tree nodes three pointers and the color, list nodes two pointers
+    constexpr uint64_t HASH_ENTRY = 3 * sizeof(void *);
+    constexpr uint64_t TREE_NODE = 4 * sizeof(void *);
+    constexpr uint64_t LIST_NODE = 2 * sizeof(void *);
+
+    uint64_t bytes = files_metadata.size() * (TREE_NODE + sizeof(std::pair<const duckdb::string, FileMetadata>));
+    // Every file block has an entry in its file, in block_mapping and in reverse_block_mapping
+    bytes += block_mapping.size() * (HASH_ENTRY + sizeof(std::pair<const block_id_t, FileMetadataBlockInfo>));
+    bytes += block_mapping.size() * (HASH_ENTRY + sizeof(std::pair<const BlockKey, block_id_t>) + sizeof(BlockKey));
+    bytes += reverse_block_mapping.size() * (HASH_ENTRY + sizeof(std::pair<const block_id_t, duckdb::vector<BlockKey>>));
+    bytes += file_path_bytes + 2 * block_key_path_bytes;
+    bytes += content_index.size() * (HASH_ENTRY + sizeof(std::pair<const uint64_t, FileMetadataBlockInfo>));
+    bytes += block_bytes.size() * (HASH_ENTRY + sizeof(std::pair<const block_id_t, uint64_t>));
+    bytes += block_groups.size() * (HASH_ENTRY + sizeof(std::pair<const block_id_t, idx_t>));
+    bytes += retained_blocks.size() * (HASH_ENTRY + sizeof(block_id_t));
+    bytes += lru_list.size() * (LIST_NODE + sizeof(block_id_t));
+    bytes += empty_files.size() * (HASH_ENTRY + sizeof(const duckdb::string *));
+    bytes += lru_map.size() * (HASH_ENTRY + sizeof(std::pair<const block_id_t, duckdb::list<block_id_t>::iterator>));
+    bytes += group_lru_map.size() * (LIST_NODE + sizeof(block_id_t) + HASH_ENTRY +
+                                     sizeof(std::pair<const block_id_t, std::pair<idx_t, duckdb::list<block_id_t>::iterator>>));
+    return bytes;
+}
+
+idx_t MetadataManager::EvictFileMetadata(uint64_t max_bytes, const duckdb::string &keep_file_path,
+                                         const std::function<void(block_id_t)> &release_func) {
+    idx_t dropped_files = 0;
+    // Entries without blocks only spare asking the source for the size and modification time
+    for (auto it = empty_files.begin(); it != empty_files.end() && GetMetadataBytes() > max_bytes;) {
+        if (**it == keep_file_path) {
+            ++it;
+            continue;
+        }
+        // Erasing the file removes it from empty_files
+        auto file_it = files_metadata.find(**it++);
+        EraseFile(file_it);
+        ++dropped_files;
+    }
+
+    // Then whole files, starting with the files of the least recently used block
+    while (GetMetadataBytes() > max_bytes) {
+        duckdb::vector<duckdb::string> file_paths;
+        for (auto it = lru_list.rbegin(); it != lru_list.rend() && file_paths.empty(); ++it) {
+            auto keys_it = reverse_block_mapping.find(*it);
+            if (keys_it == reverse_block_mapping.end()) {
+                continue;
+            }
+            for (const auto &key : keys_it->second) {
+                if (key.file_path != keep_file_path) {
+                    file_paths.push_back(key.file_path);
+                }
+            }
+        }
+        if (file_paths.empty()) {
+            break;
+        }
+        for (const auto &file_path : file_paths) {
+            UnregisterFileBlocks(file_path, release_func);
+            ++dropped_files;
+        }
+    }
+    return dropped_files;
+}
+
+duckdb::map<duckdb::string, MetadataManager::FileMetadata>::iterator
+MetadataManager::AddFile(const duckdb::string &file_path) {
+    auto result = files_metadata.try_emplace(file_path);
+    if (result.second) {
+        file_path_bytes += file_path.size();
+        empty_files.insert(&result.first->first);
+    }
+    return result.first;
+}
+
+duckdb::map<duckdb::string, MetadataManager::FileMetadata>::iterator
+MetadataManager::EraseFile(duckdb::map<duckdb::string, FileMetadata>::iterator it) {
+    file_path_bytes -= it->first.size();
+    empty_files.erase(&it->first);
+    return files_metadata.erase(it);
+}
+
+void MetadataManager::AccountBlockBytes(const duckdb::string &file_path, block_id_t block_id,
+                                        const FileMetadataBlockInfo &block_info) {
+    // A block belongs to the quota group of the first file stored in it
+    auto group_it = block_groups.find(block_id);
+    if (group_it == block_groups.end()) {
+        group_it = block_groups.emplace(block_id, GetGroup(file_path)).first;
+        ++group_blocks[group_it->second];
+    }
+
+    // A block shared by several file blocks is as large as its furthest stored byte
+    const uint64_t end_offset = block_info.offset + block_info.GetLength(block_size);
+    auto &bytes = block_bytes[block_id];
+    if (end_offset > bytes) {
+        cached_bytes += end_offset - bytes;
+        group_bytes[group_it->second] += end_offset - bytes;
+        bytes = end_offset;
+    }
+}
+
+duckdb::vector<block_id_t> MetadataManager::GetRecentBlocks(idx_t max_count) const {
+    duckdb::vector<block_id_t> result;
+    for (auto it = lru_list.begin(); it != lru_list.end() && result.size() < max_count; ++it) {
+        result.push_back(*it);
+    }
+    return result;
+}
+
 duckdb::vector<MetadataManager::BlockKey> MetadataManager::GetLRUState() const {
     duckdb::vector<BlockKey> lru_state;
     lru_state.reserve(lru_list.size());
 
     for (const auto &block_id : lru_list) {
         auto it = reverse_block_mapping.find(block_id);
-        if (it != reverse_block_mapping.end()) {
-            lru_state.push_back(it->second);
+        if (it != reverse_block_mapping.end() && !it->second.empty()) {
+            lru_state.push_back(it->second.front());
         }
     }
 
@@ -0,0 +1,42 @@
+#include "page_cache_warmer.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace quackstore {
+
+// =============================================================================
+// PageCacheWarmer
+// =============================================================================
+
+PageCacheWarmer::PageCacheWarmer(duckdb::string path, duckdb::vector<FileRange> ranges)
+    : path(std::move(path))
+    , ranges(std::move(ranges))
+    , thread([this]() { Run(); }) {
+}
+
+PageCacheWarmer::~PageCacheWarmer() {
+    stopping = true;
+    thread.join();
+}
+
+void PageCacheWarmer::Run() {
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    // The page cache belongs to the file, a descriptor of our own doesn't get in the way of the cache handle
+    const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    for (const auto &range : ranges) {
+        if (stopping) {
+            break;
+        }
+        posix_fadvise(fd, static_cast<off_t>(range.offset), static_cast<off_t>(range.size), POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+#endif
+}
+
+}  // namespace quackstore
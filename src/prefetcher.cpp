@@ -0,0 +1,92 @@
+#include "prefetcher.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// Prefetcher
+// =============================================================================
+
+//! Number of keys remembered by ScheduleOnce before they are forgotten all at once
+static constexpr idx_t MAX_SCHEDULED_KEYS = 16384;
+
+Prefetcher::Prefetcher(idx_t thread_count) : thread_count(duckdb::MaxValue<idx_t>(thread_count, 1)) {
+}
+
+Prefetcher::~Prefetcher() {
+    {
+        std::lock_guard<std::mutex> lock{prefetcher_mutex};
+        stopping = true;
+        tasks.clear();
+    }
+    work_available.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+bool Prefetcher::Schedule(Task task) {
+    {
+        std::lock_guard<std::mutex> lock{prefetcher_mutex};
+        if (stopping || tasks.size() >= MAX_QUEUED_TASKS) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+        if (threads.size() < thread_count) {
+            threads.emplace_back([this]() { Work(); });
+        }
+    }
+    work_available.notify_one();
+    return true;
+}
+
+bool Prefetcher::ScheduleOnce(const duckdb::string &key, Task task) {
+    {
+        std::lock_guard<std::mutex> lock{prefetcher_mutex};
+        if (scheduled_keys.size() >= MAX_SCHEDULED_KEYS) {
+            scheduled_keys.clear();
+        }
+        if (!scheduled_keys.insert(key).second) {
+            return false;
+        }
+    }
+    if (!Schedule(std::move(task))) {
+        // Dropped tasks may be scheduled again
+        std::lock_guard<std::mutex> lock{prefetcher_mutex};
+        scheduled_keys.erase(key);
+        return false;
+    }
+    return true;
+}
+
+void Prefetcher::WaitIdle() {
+    std::unique_lock<std::mutex> lock{prefetcher_mutex};
+    idle.wait(lock, [&]() { return tasks.empty() && running_tasks == 0; });
+}
+
+void Prefetcher::Work() {
+    std::unique_lock<std::mutex> lock{prefetcher_mutex};
+    while (true) {
+        work_available.wait(lock, [&]() { return stopping || !tasks.empty(); });
+        if (stopping) {
+            return;
+        }
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        ++running_tasks;
+
+        lock.unlock();
+        try {
+            task();
+        } catch (...) {
+            // The data is read when it's needed
+        }
+        lock.lock();
+
+        --running_tasks;
+        if (tasks.empty() && running_tasks == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+}  // namespace quackstore
@@ -13,6 +13,8 @@
 
 #include "quackstore_filesystem.hpp"
 #include "cache.hpp"
+#include "cache_registry.hpp"
+#include "cache_router.hpp"
 #include "quackstore_params.hpp"
 #include "quackstore_extension.hpp"
 #include "extension_callback.hpp"
@@ -31,10 +33,17 @@ static void LoadInternal(ExtensionLoader &loader) {
     quackstore::ExtensionParams::AddExtensionOptions(config);
 
     // NOTE: Cache is initialized here but will be lazily opened in the cache file system when first file is opened.
-    unique_ptr<quackstore::Cache> cache = make_uniq<quackstore::Cache>(QuackstoreExtension::BLOCK_SIZE);
+    // Database instances of the process opening the same cache file share it through the registry.
+    unique_ptr<quackstore::Cache> cache = make_uniq<quackstore::Cache>(QuackstoreExtension::BLOCK_SIZE, nullptr, nullptr,
+                                                                       &quackstore::CacheRegistry::Get());
+    // Files under the prefixes of named caches are served by them instead of the default cache
+    auto router = make_uniq<quackstore::CacheRouter>(*cache, &quackstore::CacheRegistry::Get());
 
     // Register block caching file system
-    instance.GetFileSystem().RegisterSubSystem(make_uniq<quackstore::QuackstoreFileSystem>(*cache));
+    instance.GetFileSystem().RegisterSubSystem(make_uniq<quackstore::QuackstoreFileSystem>(*router));
+    // Gzip-compressed files read through the cache can be decompressed into it
+    instance.GetFileSystem().RegisterSubSystem(FileCompressionType::GZIP,
+                                               make_uniq<quackstore::QuackstoreCompressedFileSystem>());
 
     // Register extension functions
 	for (auto& fun : quackstore::Functions::GetTableFunctions(instance)) {
@@ -43,7 +52,7 @@ static void LoadInternal(ExtensionLoader &loader) {
 		loader.RegisterFunction(std::move(info));
 	}
 
-    auto extension_callback = duckdb::make_shared_ptr<quackstore::ExtensionCallback>(std::move(cache));
+    auto extension_callback = duckdb::make_shared_ptr<quackstore::ExtensionCallback>(std::move(cache), std::move(router));
     for (auto& connection : ConnectionManager::Get(instance).GetConnectionList()) {
         extension_callback->OnConnectionOpened(*connection);
     }
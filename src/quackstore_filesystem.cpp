@@ -1,17 +1,27 @@
 #include <algorithm>
+#include <iterator>
 #include <duckdb/common/file_opener.hpp>
+#include <duckdb/common/gzip_file_system.hpp>
+#include <duckdb/common/string_util.hpp>
 #include <duckdb/common/types/timestamp.hpp>
 #include <duckdb/common/types/interval.hpp>
 
 #include "quackstore_filesystem.hpp"
 #include "quackstore_params.hpp"
 #include "cache.hpp"
+#include "table_format.hpp"
+#include "gzip_reader.hpp"
 
 namespace {
     duckdb::string StripPrefix(const duckdb::string &text, const duckdb::string &prefix) {
         return text.rfind(prefix, 0) == 0 ? text.substr(prefix.length()) : text;
     }
 
+    //! Files of the same size and last modification time are taken as the same version
+    duckdb::string MakeVersionTag(int64_t file_size, duckdb::timestamp_t last_modified) {
+        return duckdb::StringUtil::Format("%d-%d", file_size, last_modified.value);
+    }
+
     bool TryGetUnderlyingFileSystem(duckdb::optional_ptr<duckdb::FileOpener> opener, duckdb::FileSystem*& out_fs) {
         if (!opener) {
             return false;
@@ -44,13 +54,18 @@ public:
         QuackstoreFileSystem &cache_fs, 
         const duckdb::string &path,
         duckdb::FileSystem& underlying_fs,
-        Cache& cache,
+        Cache& routed_cache,
+        duckdb::shared_ptr<Cache> lower_tier_cache,
         ExtensionParams params
     )
     : duckdb::FileHandle(cache_fs, path, duckdb::FileOpenFlags::FILE_FLAGS_READ)
     , underlying_fs(underlying_fs)
-    , cache(cache)
+    , cache_epoch(routed_cache.PinEpoch())
+    , cache(cache_epoch ? *cache_epoch : routed_cache)
+    , lower_tier(std::move(lower_tier_cache))
     , is_open(true)
+    , adaptive_block_size(params.adaptive_block_size)
+    , cache_decompressed(params.cache_decompressed)
     {
         // Lazy getters to avoid unnecessary IO calls
         duckdb::timestamp_t underlying_last_modified = duckdb::timestamp_t::epoch();
@@ -74,6 +89,9 @@ public:
         };
 
         cache.AddRef();
+        if (lower_tier) {
+            lower_tier->AddRef();
+        }
         try
         {
             // Check if file metadata exists in cache
@@ -81,10 +99,21 @@ public:
             if (!cache.RetrieveFileMetadata(path, md))
             {
                 // First time caching this file - store metadata
-                auto file_size = get_underlying_filesize();
-                auto last_modified = get_underlying_last_modified();
-                cache.StoreFileSize(GetPath(), file_size);
-                cache.StoreFileLastModified(GetPath(), last_modified);
+                MetadataManager::FileMetadata lower_md;
+                if (lower_tier && !params.data_mutable && lower_tier->RetrieveFileMetadata(path, lower_md))
+                {
+                    // Immutable data known to the lower tier, no need to ask the source
+                    cache.StoreFileSize(GetPath(), lower_md.file_size);
+                    cache.StoreFileLastModified(GetPath(), lower_md.last_modified);
+                }
+                else
+                {
+                    auto file_size = get_underlying_filesize();
+                    auto last_modified = get_underlying_last_modified();
+                    cache.StoreFileSize(GetPath(), file_size);
+                    cache.StoreFileLastModified(GetPath(), last_modified);
+                }
+                ValidateLowerTier();
                 return;
             }
 
@@ -116,14 +145,15 @@ public:
 
             if (evict_file_entry)
             {
-                // File changed - invalidate cache and update metadata
-                cache.Evict(path);
+                // File changed - invalidate cache (and the decompressed stream of the file) and update metadata
+                cache.EvictFiles({path, path + QuackstoreFileSystem::DECOMPRESSED_SUFFIX});
 
                 auto last_modified = get_underlying_last_modified();
                 auto file_size = get_underlying_filesize();
                 cache.StoreFileLastModified(GetPath(), last_modified);
                 cache.StoreFileSize(GetPath(), file_size);
             }
+            ValidateLowerTier();
         }
         catch (...)
         {
@@ -133,7 +163,11 @@ public:
     };
 
     ~CacheFileHandle() override {
-        Close();
+        // Flushing the cache or the close callback may throw, which must not escape a destructor
+        try {
+            Close();
+        } catch (...) {
+        }
     }
 
 public:
@@ -149,6 +183,18 @@ public:
         }
         cache.Flush();
         cache.RemoveRef();
+        if (lower_tier) {
+            lower_tier->RemoveRef();
+        }
+        if (close_callback) {
+            auto callback = std::move(close_callback);
+            callback();
+        }
+    }
+
+    //! Called once the handle is closed, e.g. to prefetch the files referenced by the data read
+    void SetCloseCallback(std::function<void()> callback) {
+        close_callback = std::move(callback);
     }
 
     void ReadChunk(void *buffer, int64_t nr_bytes, idx_t location) const {
@@ -171,26 +217,50 @@ public:
         }
 
         auto block_size = cache.GetBlockSize();
+        auto block_shift = cache.GetBlockShift();
+        auto extent_shift = UpdateAccessPattern(nr_bytes);
         duckdb::vector<uint8_t> block_data(block_size);
 
+        const idx_t read_start = current_location;
+        const idx_t read_end = current_location + nr_bytes;
         while (nr_bytes > 0) {
-            idx_t block_index = current_location / block_size;
-            idx_t block_offset = current_location % block_size;
-
-            // Calculate the remaining bytes to read in the current block
-            idx_t bytes_to_read = std::min(static_cast<idx_t>(nr_bytes), block_size - block_offset);
-
-            // Check if the block is in the cache
-            if (!cache.RetrieveBlock(GetPath(), block_index, block_data)) {
-                idx_t bytes_left_in_file = file_size - (block_index * block_size);
-                idx_t bytes_to_read_from_file = std::min(static_cast<idx_t>(block_size), bytes_left_in_file);
-
-                UnderlyingFileHandle()->Read(block_data.data(), bytes_to_read_from_file, block_index * block_size);
+            int64_t block_index = current_location >> block_shift;
+
+            // Check if the block, or an extent covering it, is in the cache
+            int64_t start_index = block_index;
+            block_data.resize(block_size);
+            if (!cache.RetrieveCoveringBlock(GetPath(), block_index, start_index, block_data)) {
+                if (database_file) {
+                    // Storage blocks of a database file don't line up with the cache blocks, a miss fetches the
+                    // cache blocks up to the end of the read with one request
+                    start_index = block_index;
+                    FetchBlocks(block_index, static_cast<int64_t>((read_end - 1) >> block_shift), file_size, block_data);
+                } else {
+                    // Sequential reads fetch an extent of several blocks at once, extents start at aligned block indices
+                    while (extent_shift > 0 && (block_index & ((int64_t(1) << extent_shift) - 1)) != 0) {
+                        --extent_shift;
+                    }
+                    start_index = block_index;
+
+                    idx_t bytes_left_in_file = file_size - (block_index << block_shift);
+                    idx_t bytes_to_read_from_file = std::min(static_cast<idx_t>(block_size) << extent_shift, bytes_left_in_file);
+
+                    // Save the block to the cache, only the bytes that belong to the file. The read-only lower tier
+                    // serves the miss if it holds the whole range, the source file is read otherwise.
+                    block_data.resize(bytes_to_read_from_file);
+                    ReadSource(static_cast<idx_t>(block_index) << block_shift, bytes_to_read_from_file, block_data.data());
+                    cache.StoreBlock(GetPath(), block_index, block_data);
+                }
+            }
 
-                // Save the block to the cache.
-                cache.StoreBlock(GetPath(), block_index, block_data);
+            idx_t block_offset = current_location - (static_cast<idx_t>(start_index) << block_shift);
+            if (block_offset >= block_data.size()) {
+                throw duckdb::IOException("Cached block of \"%s\" is shorter than the file", GetPath());
             }
 
+            // Calculate the remaining bytes to read in the current block
+            idx_t bytes_to_read = std::min(static_cast<idx_t>(nr_bytes), block_data.size() - block_offset);
+
             std::copy(block_data.begin() + block_offset, block_data.begin() + block_offset + bytes_to_read,
                       read_buffer);
 
@@ -199,10 +269,30 @@ public:
             current_location += bytes_to_read;
             total_bytes_read += bytes_to_read;
         }
+        cache.DropReadPages();
 
+        if (read_start == 0 && !database_file_checked) {
+            DetectDatabaseFile(duckdb::char_ptr_cast(buffer), total_bytes_read);
+        }
         return total_bytes_read;
     }
 
+    Cache &GetCache() const {
+        return cache;
+    }
+
+    //! Whether the decompressed stream of the file is cached instead of its compressed bytes
+    bool CachesDecompressed() const {
+        return cache_decompressed;
+    }
+
+    //! Open the source file on its own, reads of it bypass the cache.
+    duckdb::unique_ptr<duckdb::FileHandle> OpenUnderlyingFile() const {
+        ValidateIsOpen();
+        return underlying_fs.OpenFile(StripPrefix(path, QuackstoreFileSystem::SCHEMA_PREFIX),
+                                      duckdb::FileOpenFlags::FILE_FLAGS_READ);
+    }
+
     duckdb::unique_ptr<duckdb::FileHandle>& UnderlyingFileHandle() const {
         ValidateIsOpen();
         if (!underlying_file_handle) {
@@ -269,6 +359,166 @@ private:
         return underlying_fs.GetLastModifiedTime(*UnderlyingFileHandle());
     }
 
+    //! Record the read and pick how many blocks (as a shift) are fetched at once on a cache miss:
+    //! random reads fetch single blocks, long sequential runs fetch extents up to the size of the run.
+    uint8_t UpdateAccessPattern(int64_t nr_bytes) const
+    {
+        if (nr_bytes <= 0) {
+            return 0;
+        }
+        if (current_location == last_read_end) {
+            sequential_bytes += nr_bytes;
+        } else {
+            sequential_bytes = nr_bytes;
+        }
+        last_read_end = current_location + nr_bytes;
+
+        if (!adaptive_block_size) {
+            return 0;
+        }
+        const idx_t sequential_blocks = sequential_bytes >> cache.GetBlockShift();
+        uint8_t extent_shift = 0;
+        while (extent_shift < Cache::MAX_EXTENT_SHIFT && (idx_t(2) << extent_shift) <= sequential_blocks) {
+            ++extent_shift;
+        }
+        return extent_shift;
+    }
+
+    //! Read a range of the file from the read-only lower tier if it holds all of it, from the source file otherwise.
+    void ReadSource(idx_t offset, idx_t size, duckdb::data_ptr_t out) const
+    {
+        if (!lower_tier || !lower_tier->RetrieveRange(GetPath(), offset, size, out)) {
+            UnderlyingFileHandle()->Read(out, size, offset);
+        }
+    }
+
+    //! Fetch the blocks first_index to last_index with one read and store them in the cache one by one,
+    //! first_block_out receives the first of them. The read stops before the first block that is cached already.
+    void FetchBlocks(int64_t first_index, int64_t last_index, idx_t file_size,
+                     duckdb::vector<uint8_t> &first_block_out) const
+    {
+        for (auto index = first_index + 1; index <= last_index; ++index) {
+            if (cache.IsBlockCached(GetPath(), index)) {
+                last_index = index - 1;
+                break;
+            }
+        }
+        const auto block_size = cache.GetBlockSize();
+        const auto block_shift = cache.GetBlockShift();
+        const idx_t offset = static_cast<idx_t>(first_index) << block_shift;
+        const idx_t size = std::min(static_cast<idx_t>(last_index - first_index + 1) << block_shift, file_size - offset);
+
+        duckdb::vector<uint8_t> data(size);
+        ReadSource(offset, size, data.data());
+        for (idx_t begin = 0; begin < size; begin += block_size) {
+            duckdb::vector<uint8_t> block(data.begin() + begin, data.begin() + std::min<idx_t>(begin + block_size, size));
+            cache.StoreBlock(GetPath(), first_index + static_cast<int64_t>(begin >> block_shift), block);
+            if (begin == 0) {
+                first_block_out = std::move(block);
+            }
+        }
+    }
+
+    //! DuckDB database files start with a main header holding the magic bytes after its checksum. DuckDB reads
+    //! its storage blocks from them, whose cache misses are then fetched whole, and the headers and catalog
+    //! blocks are retained in the cache so attaching the database again doesn't download them.
+    void DetectDatabaseFile(const char *data, idx_t size) const
+    {
+        database_file_checked = true;
+        if (size < DATABASE_MAGIC_OFFSET + 4 || memcmp(data + DATABASE_MAGIC_OFFSET, "DUCK", 4) != 0) {
+            return;
+        }
+        database_file = true;
+
+        // The reads of the catalog don't count as reads of the caller
+        const auto saved_location = current_location;
+        const auto saved_read_end = last_read_end;
+        const auto saved_sequential_bytes = sequential_bytes;
+        try {
+            RetainCatalog();
+        } catch (duckdb::Exception &) {
+            // Retaining the catalog is only an optimization, DuckDB reports a damaged file itself
+        }
+        current_location = saved_location;
+        last_read_end = saved_read_end;
+        sequential_bytes = saved_sequential_bytes;
+    }
+
+    //! Walk the chain of catalog metadata blocks from the current database header, fetching the storage blocks
+    //! holding it and retaining them together with the headers.
+    void RetainCatalog() const
+    {
+        // Fields of the database header following its checksum
+        struct DatabaseHeader {
+            uint64_t iteration;
+            uint64_t meta_block;
+            uint64_t free_list;
+            uint64_t block_count;
+            uint64_t block_alloc_size;
+        };
+        DatabaseHeader header {};
+        for (idx_t header_offset : {DATABASE_HEADER_SIZE, 2 * DATABASE_HEADER_SIZE}) {
+            DatabaseHeader candidate {};
+            ReadChunk(&candidate, sizeof(candidate), header_offset + sizeof(uint64_t));
+            if (candidate.iteration > header.iteration) {
+                header = candidate;
+            }
+        }
+        cache.RetainRange(GetPath(), 0, DATABASE_BLOCK_START);
+
+        // Files written before the block size was configurable use the default one
+        const uint64_t alloc_size = header.block_alloc_size >= Kilobytes(16) && header.block_alloc_size <= Megabytes(256ULL) &&
+                                            (header.block_alloc_size & (header.block_alloc_size - 1)) == 0
+                                        ? header.block_alloc_size
+                                        : DATABASE_DEFAULT_BLOCK_ALLOC_SIZE;
+        const idx_t metadata_size = (alloc_size - sizeof(uint64_t)) / DATABASE_METADATA_BLOCK_COUNT;
+        const idx_t file_size = GetFileSize();
+
+        duckdb::unordered_set<uint64_t> visited_blocks;
+        duckdb::vector<uint8_t> block(alloc_size);
+        uint64_t block_id = DATABASE_INVALID_POINTER;
+        uint64_t pointer = header.meta_block;
+        for (idx_t steps = 0; pointer != DATABASE_INVALID_POINTER && steps < header.block_count * DATABASE_METADATA_BLOCK_COUNT; ++steps) {
+            // The upper byte of a metadata pointer is the index of the metadata block in its storage block
+            const uint64_t index = pointer >> 56;
+            const uint64_t pointer_block_id = pointer & ((uint64_t(1) << 56) - 1);
+            const idx_t block_offset = DATABASE_BLOCK_START + pointer_block_id * alloc_size;
+            if (index >= DATABASE_METADATA_BLOCK_COUNT || pointer_block_id >= header.block_count || block_offset >= file_size) {
+                break;
+            }
+            if (pointer_block_id != block_id) {
+                block_id = pointer_block_id;
+                block.resize(std::min<idx_t>(alloc_size, file_size - block_offset));
+                ReadChunk(block.data(), block.size(), block_offset);
+                if (visited_blocks.insert(block_id).second) {
+                    cache.RetainRange(GetPath(), block_offset, block.size());
+                }
+            }
+            // Each metadata block starts with the pointer to the next one, after the storage block checksum
+            const idx_t next_offset = sizeof(uint64_t) + index * metadata_size;
+            if (next_offset + sizeof(uint64_t) > block.size()) {
+                break;
+            }
+            memcpy(&pointer, block.data() + next_offset, sizeof(pointer));
+        }
+    }
+
+    //! The lower tier is only used if it cached the same version of the file.
+    void ValidateLowerTier()
+    {
+        if (!lower_tier) {
+            return;
+        }
+        MetadataManager::FileMetadata md;
+        MetadataManager::FileMetadata lower_md;
+        if (cache.RetrieveFileMetadata(GetPath(), md) && lower_tier->RetrieveFileMetadata(GetPath(), lower_md) &&
+            md.file_size == lower_md.file_size && md.last_modified == lower_md.last_modified) {
+            return;
+        }
+        lower_tier->RemoveRef();
+        lower_tier = nullptr;
+    }
+
     void ValidateIsOpen() const
     {
         if (!is_open) 
@@ -280,11 +530,380 @@ private:
 public:
     mutable int64_t current_location = 0;
 
+private:
+    //! Layout of DuckDB database files
+    static constexpr idx_t DATABASE_MAGIC_OFFSET = sizeof(uint64_t);
+    static constexpr idx_t DATABASE_HEADER_SIZE = 4096;
+    static constexpr idx_t DATABASE_BLOCK_START = 3 * DATABASE_HEADER_SIZE;
+    static constexpr idx_t DATABASE_METADATA_BLOCK_COUNT = 64;
+    static constexpr uint64_t DATABASE_DEFAULT_BLOCK_ALLOC_SIZE = Kilobytes(256);
+    static constexpr uint64_t DATABASE_INVALID_POINTER = ~uint64_t(0);
+
 private:
     duckdb::FileSystem& underlying_fs;
     mutable duckdb::unique_ptr<duckdb::FileHandle> underlying_file_handle;
+    //! Epoch of the cache the handle was opened in, released with the handle. nullptr if the cache has no epochs.
+    duckdb::shared_ptr<Cache> cache_epoch;
     Cache& cache;
+    //! Read-only cache consulted on misses, nullptr if there is none or it doesn't hold this file
+    duckdb::shared_ptr<Cache> lower_tier;
     bool is_open = false;
+    //! Whether cache misses of sequential reads fetch extents of several blocks
+    bool adaptive_block_size = false;
+    //! Whether gzip-compressed files are decompressed into the cache when opened as such
+    bool cache_decompressed = false;
+    //! Where the previous read ended and how many bytes were read sequentially up to there
+    mutable idx_t last_read_end = 0;
+    mutable idx_t sequential_bytes = 0;
+    //! Whether the file was checked for being a DuckDB database file (on the first read of its start)
+    mutable bool database_file_checked = false;
+    mutable bool database_file = false;
+    std::function<void()> close_callback;
+};
+
+// =============================================================================
+// WriteThroughFileHandle
+// =============================================================================
+
+//! Writes a file to the source file system and stores the written blocks in the cache on the way. Once the file
+//! is closed its size and last modification time are taken from the source, so the first read after the write
+//! is a hit. Only sequentially written files are cached, a write elsewhere evicts the file again.
+class WriteThroughFileHandle : public duckdb::FileHandle {
+public:
+    WriteThroughFileHandle(
+        QuackstoreFileSystem &cache_fs,
+        const duckdb::string &path,
+        duckdb::FileSystem &underlying_fs,
+        Cache &routed_cache,
+        duckdb::FileOpenFlags flags
+    )
+    : duckdb::FileHandle(cache_fs, path, flags)
+    , underlying_fs(underlying_fs)
+    , cache_epoch(routed_cache.PinEpoch())
+    , cache(cache_epoch ? *cache_epoch : routed_cache)
+    {
+        underlying_file_handle = underlying_fs.OpenFile(StripPrefix(path, QuackstoreFileSystem::SCHEMA_PREFIX), flags);
+
+        cache.AddRef();
+        try {
+            // Whatever was cached of the file before is outdated
+            caching = !cache.IsReadOnly();
+            if (caching) {
+                cache.EvictFiles({path, path + QuackstoreFileSystem::DECOMPRESSED_SUFFIX});
+            }
+        } catch (...) {
+            cache.RemoveRef();
+            throw;
+        }
+    }
+
+    ~WriteThroughFileHandle() override {
+        Close();
+    }
+
+public:
+    void Close() override {
+        if (!underlying_file_handle) {
+            return;
+        }
+
+        // The file is complete once the source handle is closed (e.g. the upload is finished)
+        auto handle = std::move(underlying_file_handle);
+        try {
+            handle->Close();
+            if (caching) {
+                FinishCaching();
+            }
+        } catch (...) {
+            StopCaching();
+            cache.RemoveRef();
+            throw;
+        }
+        cache.Flush();
+        cache.RemoveRef();
+    }
+
+    void Write(void *buffer, int64_t nr_bytes) {
+        ValidateIsOpen();
+        try {
+            underlying_file_handle->Write(buffer, nr_bytes);
+        } catch (...) {
+            StopCaching();
+            throw;
+        }
+        if (current_location != cached_bytes) {
+            StopCaching();
+        }
+        Append(buffer, nr_bytes);
+        current_location += nr_bytes;
+        write_position = std::max<idx_t>(write_position, current_location);
+    }
+
+    void Seek(idx_t location) {
+        ValidateIsOpen();
+        underlying_fs.Seek(*underlying_file_handle, location);
+        current_location = location;
+    }
+
+    idx_t SeekPosition() const {
+        return current_location;
+    }
+
+    void Write(void *buffer, int64_t nr_bytes, idx_t location) {
+        ValidateIsOpen();
+        try {
+            underlying_fs.Write(*underlying_file_handle, buffer, nr_bytes, location);
+        } catch (...) {
+            StopCaching();
+            throw;
+        }
+        if (location != cached_bytes) {
+            StopCaching();
+        }
+        Append(buffer, nr_bytes);
+        write_position = std::max<idx_t>(write_position, location + nr_bytes);
+    }
+
+    void Sync() {
+        ValidateIsOpen();
+        underlying_fs.FileSync(*underlying_file_handle);
+    }
+
+    int64_t GetFileSize() const {
+        return static_cast<int64_t>(write_position);
+    }
+
+    duckdb::timestamp_t GetFileLastModified() const {
+        ValidateIsOpen();
+        return underlying_fs.GetLastModifiedTime(*underlying_file_handle);
+    }
+
+private:
+    //! Add the written bytes to the block being filled, full blocks are stored in the cache
+    void Append(void *buffer, int64_t nr_bytes) {
+        if (!caching) {
+            return;
+        }
+        try {
+            const auto block_size = cache.GetBlockSize();
+            auto data = duckdb::const_data_ptr_cast(buffer);
+            while (nr_bytes > 0) {
+                const auto bytes_to_copy = std::min<idx_t>(block_size - block_data.size(), nr_bytes);
+                block_data.insert(block_data.end(), data, data + bytes_to_copy);
+                data += bytes_to_copy;
+                nr_bytes -= bytes_to_copy;
+                cached_bytes += bytes_to_copy;
+                if (block_data.size() == block_size) {
+                    cache.StoreBlock(GetPath(), block_index++, block_data);
+                    block_data.clear();
+                }
+            }
+        } catch (...) {
+            // Caching is an optimization, the write to the source succeeded
+            StopCaching();
+        }
+    }
+
+    //! Store the tail block and stamp the file metadata, the file is evicted if the source doesn't match
+    //! what was written
+    void FinishCaching() {
+        if (!block_data.empty()) {
+            cache.StoreBlock(GetPath(), block_index++, block_data);
+            block_data.clear();
+        }
+
+        auto handle = underlying_fs.OpenFile(StripPrefix(path, QuackstoreFileSystem::SCHEMA_PREFIX),
+                                             duckdb::FileOpenFlags::FILE_FLAGS_READ);
+        const auto file_size = underlying_fs.GetFileSize(*handle);
+        if (file_size < 0 || static_cast<idx_t>(file_size) != cached_bytes) {
+            StopCaching();
+            return;
+        }
+        cache.StoreFileSize(GetPath(), file_size);
+        cache.StoreFileLastModified(GetPath(), underlying_fs.GetLastModifiedTime(*handle));
+    }
+
+    void StopCaching() {
+        if (!caching) {
+            return;
+        }
+        caching = false;
+        block_data.clear();
+        try {
+            cache.Evict(GetPath());
+        } catch (...) {
+            // Nothing was stamped, reads validate the file against the source
+        }
+    }
+
+    void ValidateIsOpen() const {
+        if (!underlying_file_handle) {
+            throw duckdb::InternalException("Can't operate on a closed handle");
+        }
+    }
+
+private:
+    duckdb::FileSystem &underlying_fs;
+    duckdb::unique_ptr<duckdb::FileHandle> underlying_file_handle;
+    //! Epoch of the cache the handle was opened in, released with the handle. nullptr if the cache has no epochs.
+    duckdb::shared_ptr<Cache> cache_epoch;
+    Cache &cache;
+    //! Whether the written blocks are stored in the cache
+    bool caching = false;
+    //! The block being filled and its index
+    duckdb::vector<uint8_t> block_data;
+    int64_t block_index = 0;
+    //! Bytes written sequentially from the start of the file, all of them were passed to the cache
+    idx_t cached_bytes = 0;
+    //! End of the data written so far, and the position of the writes without a location
+    idx_t write_position = 0;
+    idx_t current_location = 0;
+};
+
+// =============================================================================
+// DecompressedFileHandle
+// =============================================================================
+
+//! Serves the decompressed stream of a gzip-compressed file from the cache. The stream is stored in blocks under
+//! the path of the file followed by DECOMPRESSED_SUFFIX, so the handle can seek like one of a plain file. Blocks are
+//! decompressed and stored when they're first read, the size of the stream is known once it was decompressed to its
+//! end (readers asking for the size on open decompress it all then). Blocks evicted later are decompressed again
+//! from the closest checkpoint of the stream.
+class DecompressedFileHandle : public duckdb::FileHandle {
+public:
+    DecompressedFileHandle(duckdb::FileSystem &compressed_fs, duckdb::unique_ptr<duckdb::FileHandle> compressed_handle)
+    : duckdb::FileHandle(compressed_fs, compressed_handle->GetPath(), duckdb::FileOpenFlags::FILE_FLAGS_READ)
+    , source_handle(std::move(compressed_handle))
+    , source(source_handle->Cast<CacheFileHandle>())
+    , cache(source.GetCache())
+    , cache_key(GetPath() + QuackstoreFileSystem::DECOMPRESSED_SUFFIX)
+    {
+        // The handle of the compressed file validated its metadata, the decompressed stream was evicted with it
+        // if the file changed. The stream is complete once its size was stored as an artifact of the file, after
+        // its last block (storing a block already adds an entry for the stream).
+        duckdb::vector<uint8_t> marker;
+        if (cache.RetrieveArtifact(GetPath(), QuackstoreFileSystem::DECOMPRESSED_SIZE_ARTIFACT, marker) &&
+            marker.size() == sizeof(int64_t)) {
+            file_size = static_cast<idx_t>(duckdb::Load<int64_t>(marker.data()));
+            size_known = true;
+            return;
+        }
+        // Blocks stored by a handle that didn't reach the end are decompressed again
+        cache.Evict(cache_key);
+    }
+
+    ~DecompressedFileHandle() override {
+        Close();
+    }
+
+public:
+    void Close() override {
+        reader.reset();
+        if (source_handle) {
+            source_handle->Close();
+        }
+    }
+
+    int64_t ReadChunk(void *buffer, int64_t nr_bytes) const {
+        const auto block_shift = cache.GetBlockShift();
+        auto read_buffer = duckdb::char_ptr_cast(buffer);
+        int64_t total_bytes_read = 0;
+        duckdb::vector<uint8_t> block_data;
+        while (nr_bytes > 0) {
+            if (size_known) {
+                if (current_location >= file_size) {
+                    break;
+                }
+                nr_bytes = std::min<int64_t>(nr_bytes, file_size - current_location);
+            }
+            const int64_t block_index = current_location >> block_shift;
+            int64_t start_index = block_index;
+            block_data.resize(cache.GetBlockSize());
+            if (!cache.RetrieveCoveringBlock(cache_key, block_index, start_index, block_data)) {
+                start_index = block_index;
+                DecompressBlock(block_index, block_data);
+                if (size_known && current_location >= file_size) {
+                    break;
+                }
+            }
+
+            const idx_t block_offset = current_location - (static_cast<idx_t>(start_index) << block_shift);
+            if (block_offset >= block_data.size()) {
+                throw duckdb::IOException("Cached decompressed block of \"%s\" is shorter than the stream", GetPath());
+            }
+            const idx_t bytes_to_read = std::min(static_cast<idx_t>(nr_bytes), block_data.size() - block_offset);
+            std::copy(block_data.begin() + block_offset, block_data.begin() + block_offset + bytes_to_read, read_buffer);
+
+            read_buffer += bytes_to_read;
+            nr_bytes -= bytes_to_read;
+            current_location += bytes_to_read;
+            total_bytes_read += bytes_to_read;
+        }
+        cache.DropReadPages();
+        return total_bytes_read;
+    }
+
+    int64_t GetFileSize() const {
+        if (!size_known) {
+            DecompressToEnd();
+        }
+        return file_size;
+    }
+
+    duckdb::timestamp_t GetFileLastModified() const {
+        return source.GetFileLastModified();
+    }
+
+public:
+    mutable idx_t current_location = 0;
+
+private:
+    //! Decompress and store the blocks from the position of the stream to its end
+    void DecompressToEnd() const {
+        auto block_index = reader ? static_cast<int64_t>(reader->GetPosition() >> cache.GetBlockShift()) : 0;
+        duckdb::vector<uint8_t> block_data;
+        while (!size_known) {
+            DecompressBlock(block_index++, block_data);
+        }
+    }
+
+    //! Decompress the block and store it, block_data is empty if the stream ends before the block
+    void DecompressBlock(int64_t block_index, duckdb::vector<uint8_t> &block_data) const {
+        if (!reader) {
+            reader = duckdb::make_uniq<GzipReader>(source.OpenUnderlyingFile());
+        }
+        const auto block_size = cache.GetBlockSize();
+        const idx_t offset = static_cast<idx_t>(block_index) << cache.GetBlockShift();
+        block_data.resize(block_size);
+        block_data.resize(reader->Seek(offset) == offset ? reader->Read(block_data.data(), block_size) : 0);
+        if (size_known && block_data.size() < std::min<idx_t>(block_size, file_size - std::min(offset, file_size))) {
+            throw duckdb::IOException("Decompressed stream of \"%s\" is shorter than when it was cached", GetPath());
+        }
+        if (!block_data.empty()) {
+            cache.StoreBlock(cache_key, block_index, block_data);
+        }
+        if (!size_known && block_data.size() < block_size) {
+            // Only the last block is short
+            file_size = reader->GetPosition();
+            size_known = true;
+            cache.StoreFileSize(cache_key, file_size);
+            cache.StoreFileLastModified(cache_key, source.GetFileLastModified());
+            uint8_t marker[sizeof(int64_t)];
+            duckdb::Store<int64_t>(static_cast<int64_t>(file_size), marker);
+            cache.StoreArtifact(GetPath(), QuackstoreFileSystem::DECOMPRESSED_SIZE_ARTIFACT, marker, sizeof(marker));
+        }
+    }
+
+private:
+    //! Handle of the compressed file, keeps the cache it's served from open
+    duckdb::unique_ptr<duckdb::FileHandle> source_handle;
+    CacheFileHandle &source;
+    Cache &cache;
+    const duckdb::string cache_key;
+    mutable idx_t file_size = 0;
+    mutable bool size_known = false;
+    //! Decompressed stream of the source file, opened on the first block that isn't cached
+    mutable duckdb::unique_ptr<GzipReader> reader;
 };
 
 // =============================================================================
@@ -292,7 +911,12 @@ private:
 // =============================================================================
 
 QuackstoreFileSystem::QuackstoreFileSystem(Cache& cache)
-: cache(cache)
+: owned_router(duckdb::make_uniq<CacheRouter>(cache))
+, router(*owned_router)
+{}
+
+QuackstoreFileSystem::QuackstoreFileSystem(CacheRouter& router)
+: router(router)
 {}
 
 duckdb::unique_ptr<duckdb::FileHandle> QuackstoreFileSystem::OpenFile(const duckdb::string &path, duckdb::FileOpenFlags flags,
@@ -327,13 +951,36 @@ duckdb::unique_ptr<duckdb::FileHandle> QuackstoreFileSystem::OpenFile(const duck
         return underlying_fs.OpenFile(actual_path, flags);
     }
 
-    if (!cache.IsOpen()) {
-        cache.Open(params.cache_path);
+    // Databases must be attached with READ_ONLY, opening them for writing takes a write lock. Read locks are ignored,
+    // the cached copy of the file is never written to.
+    if (flags.Lock() == duckdb::FileLockType::WRITE_LOCK ||
+        (flags.OpenForReading() && (flags.CreateFileIfNotExists() || flags.OverwriteExistingFile()))) {
+        throw duckdb::IOException("Cannot open \"%s\" for writing, files read through the cache are read-only", path);
+    }
+    // Files are written through to the source (e.g. by COPY TO), and only cached on the way with write-through
+    if (flags.OpenForWriting() && !flags.OpenForReading()) {
+        if (!params.write_through) {
+            // Whatever was cached of the file before is outdated
+            EvictWrittenFile(path);
+            return underlying_fs.OpenFile(StripPrefix(path, SCHEMA_PREFIX), flags);
+        }
+        return duckdb::make_uniq<WriteThroughFileHandle>(*this, path, underlying_fs, router.Route(path, params), flags);
+    }
+    if (flags.ReturnNullIfNotExists() && !underlying_fs.FileExists(StripPrefix(path, SCHEMA_PREFIX))) {
+        return nullptr;
     }
 
-    cache.SetMaxCacheSize(params.max_cache_size);
-
-    return duckdb::make_uniq<CacheFileHandle>(*this, path, underlying_fs, cache, std::move(params));
+    auto& cache = router.Route(path, params);
+    auto lower_tier = router.GetLowerTier(params);
+    auto handle = duckdb::make_uniq<CacheFileHandle>(*this, path, underlying_fs, cache, lower_tier, params);
+    // Prefetches outlive the client, they go through the file system of the database
+    if (params.table_prefetch && optional_db && TableFormat::Classify(path) != TableFormat::FileKind::NONE) {
+        auto &database_fs = duckdb::FileSystem::GetFileSystem(*optional_db);
+        handle->SetCloseCallback([this, path, params, &database_fs]() {
+            PrefetchTableMetadata(path, params, database_fs);
+        });
+    }
+    return std::move(handle);
 }
 
 bool QuackstoreFileSystem::CanHandleFile(const duckdb::string &path) {
@@ -342,11 +989,13 @@ bool QuackstoreFileSystem::CanHandleFile(const duckdb::string &path) {
 
 
 void QuackstoreFileSystem::Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) {
+    ValidateReadHandle(handle);
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     caching_file_handle.ReadChunk(buffer, nr_bytes, location);
 }
 
 int64_t QuackstoreFileSystem::Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) {
+    ValidateReadHandle(handle);
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     return caching_file_handle.ReadChunk(buffer, nr_bytes);
 }
@@ -358,35 +1007,253 @@ duckdb::vector<duckdb::OpenFileInfo> QuackstoreFileSystem::Glob(const duckdb::st
     }
 
     auto entries = underlying_fs_ptr->Glob(StripPrefix(path, SCHEMA_PREFIX));
-    if (path.rfind(SCHEMA_PREFIX, 0) == 0) {
-        for (auto &e : entries) {
-            e.path = SCHEMA_PREFIX + e.path;
+    if (path.rfind(SCHEMA_PREFIX, 0) != 0) {
+        return entries;
+    }
+    for (auto &e : entries) {
+        e.path = SCHEMA_PREFIX + e.path;
+    }
+
+    auto params = ExtensionParams::ReadFrom(opener);
+    auto optional_db = opener->TryGetDatabase();
+    if (!params.cache_enabled || params.glob_order == GlobOrder::SOURCE || !optional_db) {
+        return entries;
+    }
+    return OrderCachedFirst(std::move(entries), params, duckdb::FileSystem::GetFileSystem(*optional_db));
+}
+
+duckdb::vector<duckdb::OpenFileInfo> QuackstoreFileSystem::OrderCachedFirst(duckdb::vector<duckdb::OpenFileInfo> entries,
+                                                                            const ExtensionParams &params,
+                                                                            duckdb::FileSystem &underlying_fs) {
+    duckdb::vector<duckdb::OpenFileInfo> cached;
+    duckdb::vector<duckdb::OpenFileInfo> cold;
+    // Bytes left to prefetch into each cache
+    duckdb::unordered_map<Cache *, std::shared_ptr<std::atomic<idx_t>>> budgets;
+    for (auto &entry : entries) {
+        auto &cache = router.Route(entry.path, params);
+        if (cache.IsFileCached(entry.path)) {
+            cached.push_back(std::move(entry));
+            continue;
+        }
+        // Fetched while the cached files are scanned, up to the free space of the cache (or a share of it if
+        // it's full), so the prefetched files don't evict each other or the files being scanned
+        auto &budget = budgets[&cache];
+        if (!budget) {
+            const auto max_size = cache.GetMaxCacheSize();
+            const auto free_space = max_size - std::min(cache.GetCachedBytes(), max_size);
+            budget = std::make_shared<std::atomic<idx_t>>(
+                std::max<idx_t>(free_space, max_size / 100 * GLOB_PREFETCH_PERCENT));
+        }
+        PrefetchFile(entry.path, params, underlying_fs, budget);
+        cold.push_back(std::move(entry));
+    }
+
+    duckdb::vector<duckdb::OpenFileInfo> result;
+    result.reserve(cached.size() + cold.size());
+    if (params.glob_order == GlobOrder::CACHED_FIRST) {
+        std::move(cached.begin(), cached.end(), std::back_inserter(result));
+        std::move(cold.begin(), cold.end(), std::back_inserter(result));
+        return result;
+    }
+    for (idx_t i = 0; i < std::max(cached.size(), cold.size()); ++i) {
+        if (i < cached.size()) {
+            result.push_back(std::move(cached[i]));
         }
+        if (i < cold.size()) {
+            result.push_back(std::move(cold[i]));
+        }
+    }
+    return result;
+}
+
+void QuackstoreFileSystem::Write(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) {
+    ValidateWriteHandle(handle);
+    handle.Cast<WriteThroughFileHandle>().Write(buffer, nr_bytes, location);
+}
+
+int64_t QuackstoreFileSystem::Write(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) {
+    ValidateWriteHandle(handle);
+    handle.Cast<WriteThroughFileHandle>().Write(buffer, nr_bytes);
+    return nr_bytes;
+}
+
+void QuackstoreFileSystem::FileSync(duckdb::FileHandle &handle) {
+    ValidateWriteHandle(handle);
+    handle.Cast<WriteThroughFileHandle>().Sync();
+}
+
+void QuackstoreFileSystem::ValidateWriteHandle(duckdb::FileHandle &handle) {
+    if (!IsWriteHandle(handle)) {
+        throw duckdb::IOException("Cannot write to \"%s\", it was opened for reading", handle.GetPath());
     }
+}
 
-    return entries;
+void QuackstoreFileSystem::ValidateReadHandle(duckdb::FileHandle &handle) {
+    if (IsWriteHandle(handle)) {
+        throw duckdb::IOException("Cannot read from \"%s\", it was opened for writing", handle.GetPath());
+    }
+}
+
+bool QuackstoreFileSystem::IsWriteHandle(duckdb::FileHandle &handle) {
+    // Files are opened either for reading from the cache or for writing through it
+    return handle.GetFlags().OpenForWriting() && !handle.GetFlags().OpenForReading();
 }
 
 int64_t QuackstoreFileSystem::GetFileSize(duckdb::FileHandle &handle) {
+    if (IsWriteHandle(handle)) {
+        return handle.Cast<WriteThroughFileHandle>().GetFileSize();
+    }
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     return caching_file_handle.GetFileSize();
 }
 
 void QuackstoreFileSystem::Seek(duckdb::FileHandle &handle, idx_t location) {
+    if (IsWriteHandle(handle)) {
+        handle.Cast<WriteThroughFileHandle>().Seek(location);
+        return;
+    }
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     caching_file_handle.current_location = location;
 }
 
 idx_t QuackstoreFileSystem::SeekPosition(duckdb::FileHandle &handle) {
+    if (IsWriteHandle(handle)) {
+        return handle.Cast<WriteThroughFileHandle>().SeekPosition();
+    }
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     return caching_file_handle.current_location;
 }
 
 duckdb::timestamp_t QuackstoreFileSystem::GetLastModifiedTime(duckdb::FileHandle &handle) {
+    if (IsWriteHandle(handle)) {
+        return handle.Cast<WriteThroughFileHandle>().GetFileLastModified();
+    }
     auto &caching_file_handle = handle.Cast<CacheFileHandle>();
     return caching_file_handle.GetFileLastModified();
 }
 
+duckdb::string QuackstoreFileSystem::GetVersionTag(duckdb::FileHandle &handle) {
+    if (IsWriteHandle(handle)) {
+        auto &write_handle = handle.Cast<WriteThroughFileHandle>();
+        return MakeVersionTag(write_handle.GetFileSize(), write_handle.GetFileLastModified());
+    }
+    auto &caching_file_handle = handle.Cast<CacheFileHandle>();
+    return MakeVersionTag(caching_file_handle.GetFileSize(), caching_file_handle.GetFileLastModified());
+}
+
+void QuackstoreFileSystem::RemoveFile(const duckdb::string &filename, duckdb::optional_ptr<duckdb::FileOpener> opener) {
+    duckdb::FileSystem* underlying_fs_ptr = nullptr;
+    if (!TryGetUnderlyingFileSystem(opener, underlying_fs_ptr)) {
+        throw duckdb::InvalidInputException("Unable to get underlying FileSystem for RemoveFile operation");
+    }
+
+    underlying_fs_ptr->RemoveFile(StripPrefix(filename, SCHEMA_PREFIX));
+    EvictWrittenFile(filename);
+}
+
+void QuackstoreFileSystem::MoveFile(const duckdb::string &source, const duckdb::string &target,
+                                    duckdb::optional_ptr<duckdb::FileOpener> opener) {
+    duckdb::FileSystem* underlying_fs_ptr = nullptr;
+    if (!TryGetUnderlyingFileSystem(opener, underlying_fs_ptr)) {
+        throw duckdb::InvalidInputException("Unable to get underlying FileSystem for MoveFile operation");
+    }
+
+    underlying_fs_ptr->MoveFile(StripPrefix(source, SCHEMA_PREFIX), StripPrefix(target, SCHEMA_PREFIX));
+    // The cached data of the source moves along, reading the target checks its size and modification time as usual
+    router.ForEachCache([&](Cache &cache) {
+        if (cache.IsOpen() && !cache.IsReadOnly()) {
+            cache.RenameFile(source, target);
+            cache.RenameFile(source + DECOMPRESSED_SUFFIX, target + DECOMPRESSED_SUFFIX);
+        }
+    });
+}
+
+void QuackstoreFileSystem::EvictWrittenFile(const duckdb::string &path) {
+    router.ForEachCache([&](Cache &cache) {
+        if (cache.IsOpen() && !cache.IsReadOnly()) {
+            cache.EvictFiles({path, path + DECOMPRESSED_SUFFIX});
+        }
+    });
+}
+
+void QuackstoreFileSystem::PrefetchTableMetadata(const duckdb::string &path, const ExtensionParams &params,
+                                                 duckdb::FileSystem &underlying_fs) {
+    const auto kind = TableFormat::Classify(path);
+    if (kind == TableFormat::FileKind::NONE) {
+        return;
+    }
+    prefetcher.ScheduleOnce(path, [this, path, kind, params, &underlying_fs]() {
+        CacheFileHandle handle(*this, path, underlying_fs, router.Route(path, params), router.GetLowerTier(params), params);
+        const auto file_size = static_cast<idx_t>(handle.GetFileSize());
+        if (file_size > TableFormat::MAX_METADATA_FILE_SIZE) {
+            return;
+        }
+        duckdb::string content(file_size, '\0');
+        handle.ReadChunk(&content[0], file_size, 0);
+        handle.Close();
+
+        // Metadata files are scanned in turn, down to the data files
+        auto references = TableFormat::ExtractReferences(kind, path, content);
+        for (auto &metadata_file : references.metadata_files) {
+            PrefetchTableMetadata(metadata_file, params, underlying_fs);
+        }
+        for (auto &data_file : references.data_files) {
+            PrefetchParquetFooter(data_file, params, underlying_fs);
+        }
+    });
+}
+
+void QuackstoreFileSystem::PrefetchFile(const duckdb::string &path, const ExtensionParams &params,
+                                        duckdb::FileSystem &underlying_fs, std::shared_ptr<std::atomic<idx_t>> budget) {
+    prefetcher.ScheduleOnce(path, [this, path, params, &underlying_fs, budget]() {
+        CacheFileHandle handle(*this, path, underlying_fs, router.Route(path, params), router.GetLowerTier(params), params);
+        const auto file_size = static_cast<idx_t>(handle.GetFileSize());
+        // Files that don't fit the budget anymore are left to the query
+        auto remaining = budget->load();
+        do {
+            if (remaining < file_size) {
+                return;
+            }
+        } while (!budget->compare_exchange_weak(remaining, remaining - file_size));
+
+        // Read in chunks of the largest extent, the misses of each chunk are fetched with one request
+        const idx_t chunk_size = handle.GetCache().GetBlockSize() << Cache::MAX_EXTENT_SHIFT;
+        duckdb::vector<char> chunk(chunk_size);
+        for (idx_t offset = 0; offset < file_size; offset += chunk_size) {
+            handle.ReadChunk(chunk.data(), std::min(chunk_size, file_size - offset), offset);
+        }
+    });
+}
+
+void QuackstoreFileSystem::PrefetchParquetFooter(const duckdb::string &path, const ExtensionParams &params,
+                                                 duckdb::FileSystem &underlying_fs) {
+    // Parquet files end with the size of the footer and the magic bytes
+    static constexpr idx_t PARQUET_TAIL_SIZE = 8;
+    static const duckdb::string PARQUET_MAGIC = "PAR1";
+    if (!duckdb::StringUtil::EndsWith(path, ".parquet")) {
+        return;
+    }
+    // Keyed apart from the prefetch of the whole file
+    prefetcher.ScheduleOnce(path + "#footer", [this, path, params, &underlying_fs]() {
+        CacheFileHandle handle(*this, path, underlying_fs, router.Route(path, params), router.GetLowerTier(params), params);
+        const auto file_size = static_cast<idx_t>(handle.GetFileSize());
+        if (file_size < PARQUET_TAIL_SIZE + PARQUET_MAGIC.size()) {
+            return;
+        }
+        char tail[PARQUET_TAIL_SIZE];
+        handle.ReadChunk(tail, PARQUET_TAIL_SIZE, file_size - PARQUET_TAIL_SIZE);
+        if (PARQUET_MAGIC.compare(0, PARQUET_MAGIC.size(), tail + 4, PARQUET_MAGIC.size()) != 0) {
+            return;
+        }
+        const auto footer_size = static_cast<idx_t>(duckdb::Load<uint32_t>(duckdb::const_data_ptr_cast(tail)));
+        if (footer_size + PARQUET_TAIL_SIZE > file_size) {
+            return;
+        }
+        duckdb::vector<char> footer(footer_size);
+        handle.ReadChunk(footer.data(), footer_size, file_size - PARQUET_TAIL_SIZE - footer_size);
+    });
+}
+
 bool QuackstoreFileSystem::FileExists(const duckdb::string &filename, duckdb::optional_ptr<duckdb::FileOpener> opener) {
     duckdb::FileSystem* underlying_fs_ptr = nullptr;
     if (!TryGetUnderlyingFileSystem(opener, underlying_fs_ptr)) {
@@ -422,7 +1289,62 @@ bool QuackstoreFileSystem::ListFiles(const duckdb::string &directory,
 duckdb::unique_ptr<duckdb::FileHandle> QuackstoreFileSystem::OpenCompressedFile(duckdb::QueryContext context,
                                                                     duckdb::unique_ptr<duckdb::FileHandle> handle,
                                                                     bool write) {
+    // DuckDB applies compression through the file systems registered per compression type, see
+    // QuackstoreCompressedFileSystem
     throw duckdb::NotImplementedException("%s: OpenCompressedFile is not implemented!", GetName());
 }
 
+// =============================================================================
+// QuackstoreCompressedFileSystem
+// =============================================================================
+
+QuackstoreCompressedFileSystem::QuackstoreCompressedFileSystem()
+: gzip_fs(duckdb::make_uniq<duckdb::GZipFileSystem>())
+{}
+
+duckdb::unique_ptr<duckdb::FileHandle> QuackstoreCompressedFileSystem::OpenCompressedFile(duckdb::QueryContext context,
+                                                                              duckdb::unique_ptr<duckdb::FileHandle> handle,
+                                                                              bool write) {
+    if (write || handle->file_system.GetName() != QuackstoreFileSystem::FILESYSTEM_NAME ||
+        !handle->Cast<CacheFileHandle>().CachesDecompressed()) {
+        return gzip_fs->OpenCompressedFile(context, std::move(handle), write);
+    }
+    return duckdb::make_uniq<DecompressedFileHandle>(*this, std::move(handle));
+}
+
+void QuackstoreCompressedFileSystem::Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) {
+    auto &decompressed_handle = handle.Cast<DecompressedFileHandle>();
+    decompressed_handle.current_location = location;
+    decompressed_handle.ReadChunk(buffer, nr_bytes);
+}
+
+int64_t QuackstoreCompressedFileSystem::Read(duckdb::FileHandle &handle, void *buffer, int64_t nr_bytes) {
+    return handle.Cast<DecompressedFileHandle>().ReadChunk(buffer, nr_bytes);
+}
+
+int64_t QuackstoreCompressedFileSystem::GetFileSize(duckdb::FileHandle &handle) {
+    return handle.Cast<DecompressedFileHandle>().GetFileSize();
+}
+
+duckdb::timestamp_t QuackstoreCompressedFileSystem::GetLastModifiedTime(duckdb::FileHandle &handle) {
+    return handle.Cast<DecompressedFileHandle>().GetFileLastModified();
+}
+
+duckdb::string QuackstoreCompressedFileSystem::GetVersionTag(duckdb::FileHandle &handle) {
+    auto &decompressed_handle = handle.Cast<DecompressedFileHandle>();
+    return MakeVersionTag(decompressed_handle.GetFileSize(), decompressed_handle.GetFileLastModified());
+}
+
+void QuackstoreCompressedFileSystem::Seek(duckdb::FileHandle &handle, idx_t location) {
+    handle.Cast<DecompressedFileHandle>().current_location = location;
+}
+
+idx_t QuackstoreCompressedFileSystem::SeekPosition(duckdb::FileHandle &handle) {
+    return handle.Cast<DecompressedFileHandle>().current_location;
+}
+
+void QuackstoreCompressedFileSystem::Reset(duckdb::FileHandle &handle) {
+    Seek(handle, 0);
+}
+
 }  // namespace quackstore
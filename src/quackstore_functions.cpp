@@ -7,6 +7,8 @@
 #include "quackstore_functions.hpp"
 #include "extension_state.hpp"
 #include "cache.hpp"
+#include "cache_router.hpp"
+#include "cache_bundle.hpp"
 
 namespace quackstore {
 
@@ -14,6 +16,42 @@ struct ClearCacheFunctionData : public duckdb::TableFunctionData {
     bool finished = false;
 };
 
+struct CacheGroupsFunctionData : public duckdb::TableFunctionData {
+    struct Row {
+        duckdb::string cache_path;
+        MetadataManager::GroupUsage usage;
+        bool has_quota;
+    };
+    duckdb::vector<Row> rows;
+    idx_t offset = 0;
+};
+
+struct CacheStatsFunctionData : public duckdb::TableFunctionData {
+    struct Row {
+        duckdb::string cache_path;
+        uint64_t files;
+        uint64_t cached_bytes;
+        uint64_t max_cache_size;
+        uint64_t metadata_bytes;
+        uint64_t metadata_budget;
+    };
+    duckdb::vector<Row> rows;
+    idx_t offset = 0;
+};
+
+struct BundleFunctionData : public duckdb::TableFunctionData {
+    duckdb::string bundle_path;
+    //! Path prefix of the exported files
+    duckdb::string prefix;
+    bool finished = false;
+};
+
+struct EvictMatchingFunctionData : public duckdb::TableFunctionData {
+    //! Path prefix or glob pattern of the files to evict
+    duckdb::string pattern;
+    bool finished = false;
+};
+
 struct EvictFilesFunctionData : public duckdb::TableFunctionData {
     duckdb::vector<duckdb::string> paths;
     bool finished = false;
@@ -65,6 +103,227 @@ static duckdb::unique_ptr<duckdb::FunctionData> BindEvictFilesFunction(duckdb::C
     return std::move(res);
 }
 
+static duckdb::unique_ptr<duckdb::FunctionData> BindEvictMatchingFunction(duckdb::ClientContext &context, duckdb::TableFunctionBindInput &input,
+                                               duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("evicted_files");
+
+    auto res = duckdb::make_uniq<EvictMatchingFunctionData>();
+    if (input.inputs.front().IsNull()) {
+        throw duckdb::BinderException("%s argument cannot be NULL", input.table_function.name);
+    }
+    res->pattern = duckdb::StringValue::Get(input.inputs.front());
+    return std::move(res);
+}
+
+static duckdb::unique_ptr<duckdb::FunctionData> BindCacheGroupsFunction(duckdb::ClientContext &context, duckdb::TableFunctionBindInput &input,
+                                               duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    return_types.push_back(duckdb::LogicalType::VARCHAR);
+    names.emplace_back("cache_path");
+    return_types.push_back(duckdb::LogicalType::VARCHAR);
+    names.emplace_back("prefix");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("quota_bytes");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("cached_bytes");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("cached_blocks");
+
+    auto res = duckdb::make_uniq<CacheGroupsFunctionData>();
+
+    auto quackstore_state = ExtensionState::RetrieveFromContext(context);
+    if (!quackstore_state) {
+        return std::move(res);
+    }
+    const auto add_cache = [&](Cache &cache) {
+        if (!cache.IsOpen()) {
+            return;
+        }
+        auto usage = cache.GetGroupUsage();
+        for (idx_t group = 0; group < usage.size(); ++group) {
+            // The last group holds the files without a quota
+            res->rows.push_back({cache.GetPath(), std::move(usage[group]), group + 1 < usage.size()});
+        }
+    };
+    if (quackstore_state->GetRouter()) {
+        quackstore_state->GetRouter()->ForEachCache(add_cache);
+    } else {
+        add_cache(quackstore_state->GetCache());
+    }
+
+    return std::move(res);
+}
+
+static duckdb::unique_ptr<duckdb::FunctionData> BindCacheStatsFunction(duckdb::ClientContext &context, duckdb::TableFunctionBindInput &input,
+                                               duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    return_types.push_back(duckdb::LogicalType::VARCHAR);
+    names.emplace_back("cache_path");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("files");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("cached_bytes");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("max_cache_size");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("metadata_bytes");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("metadata_budget");
+
+    auto res = duckdb::make_uniq<CacheStatsFunctionData>();
+
+    auto quackstore_state = ExtensionState::RetrieveFromContext(context);
+    if (!quackstore_state) {
+        return std::move(res);
+    }
+    const auto add_cache = [&](Cache &cache) {
+        if (!cache.IsOpen()) {
+            return;
+        }
+        res->rows.push_back({cache.GetPath(), cache.GetFileCount(), cache.GetCachedBytes(), cache.GetMaxCacheSize(),
+                             cache.GetMetadataBytes(), cache.GetMetadataBudget()});
+    };
+    if (quackstore_state->GetRouter()) {
+        quackstore_state->GetRouter()->ForEachCache(add_cache);
+    } else {
+        add_cache(quackstore_state->GetCache());
+    }
+
+    return std::move(res);
+}
+
+static duckdb::string GetStringArgument(const duckdb::TableFunctionBindInput &input, idx_t index, const char *function_name) {
+    const auto &value = input.inputs[index];
+    if (value.IsNull()) {
+        throw duckdb::BinderException("%s arguments cannot be NULL", function_name);
+    }
+    return duckdb::StringValue::Get(value);
+}
+
+static void AddBundleStatsColumns(duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("files");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("blocks");
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("bytes");
+}
+
+static duckdb::unique_ptr<duckdb::FunctionData> BindExportFunction(duckdb::ClientContext &context, duckdb::TableFunctionBindInput &input,
+                                               duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    AddBundleStatsColumns(return_types, names);
+
+    auto res = duckdb::make_uniq<BundleFunctionData>();
+    res->bundle_path = GetStringArgument(input, 0, "quackstore_export");
+    if (input.inputs.size() > 1) {
+        res->prefix = GetStringArgument(input, 1, "quackstore_export");
+    }
+    return std::move(res);
+}
+
+static duckdb::unique_ptr<duckdb::FunctionData> BindImportFunction(duckdb::ClientContext &context, duckdb::TableFunctionBindInput &input,
+                                               duckdb::vector<duckdb::LogicalType> &return_types, duckdb::vector<duckdb::string> &names) {
+    AddBundleStatsColumns(return_types, names);
+    return_types.push_back(duckdb::LogicalType::UBIGINT);
+    names.emplace_back("skipped_files");
+
+    auto res = duckdb::make_uniq<BundleFunctionData>();
+    res->bundle_path = GetStringArgument(input, 0, "quackstore_import");
+    return std::move(res);
+}
+
+static void OutputBundleStats(const CacheBundle::Stats &stats, duckdb::DataChunk &output) {
+    output.SetCardinality(1);
+    output.data[0].SetValue(0, duckdb::Value::UBIGINT(stats.files));
+    output.data[1].SetValue(0, duckdb::Value::UBIGINT(stats.blocks));
+    output.data[2].SetValue(0, duckdb::Value::UBIGINT(stats.bytes));
+    if (output.ColumnCount() > 3) {
+        output.data[3].SetValue(0, duckdb::Value::UBIGINT(stats.skipped_files));
+    }
+}
+
+static void ExecExportFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    auto &data = data_p.bind_data->CastNoConst<BundleFunctionData>();
+    if (data.finished) {
+        return;
+    }
+    data.finished = true;
+
+    auto quackstore_state = ExtensionState::RetrieveFromContext(context);
+    if (!quackstore_state) {
+        throw duckdb::InvalidInputException("quackstore extension is not loaded");
+    }
+    const auto params = ExtensionParams::ReadFrom(context);
+    quackstore_state->GetCache().Open(params.cache_path);
+
+    duckdb::vector<duckdb::reference<Cache>> caches;
+    if (quackstore_state->GetRouter()) {
+        quackstore_state->GetRouter()->ForEachCache([&](Cache &cache) { caches.push_back(cache); });
+    } else {
+        caches.push_back(quackstore_state->GetCache());
+    }
+    auto stats = CacheBundle::Export(duckdb::FileSystem::GetFileSystem(context), data.bundle_path, caches, data.prefix);
+    OutputBundleStats(stats, output);
+}
+
+static void ExecImportFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    auto &data = data_p.bind_data->CastNoConst<BundleFunctionData>();
+    if (data.finished) {
+        return;
+    }
+    data.finished = true;
+
+    auto quackstore_state = ExtensionState::RetrieveFromContext(context);
+    if (!quackstore_state) {
+        throw duckdb::InvalidInputException("quackstore extension is not loaded");
+    }
+    const auto params = ExtensionParams::ReadFrom(context);
+    auto &default_cache = quackstore_state->GetCache();
+    auto router = quackstore_state->GetRouter();
+    if (!router) {
+        default_cache.SetStorageLayout(params.storage_layout);
+        default_cache.Open(params.cache_path);
+    }
+
+    // Files are merged into the cache their path is routed to
+    auto stats = CacheBundle::Import(duckdb::FileSystem::GetFileSystem(context), data.bundle_path,
+                                     [&](const duckdb::string &file_path) -> Cache & {
+                                         return router ? router->Route(file_path, params) : default_cache;
+                                     });
+    OutputBundleStats(stats, output);
+}
+
+static void ExecCacheGroupsFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    auto &data = data_p.bind_data->CastNoConst<CacheGroupsFunctionData>();
+
+    idx_t count = 0;
+    while (data.offset < data.rows.size() && count < STANDARD_VECTOR_SIZE) {
+        const auto &row = data.rows[data.offset++];
+        output.data[0].SetValue(count, duckdb::Value(row.cache_path));
+        output.data[1].SetValue(count, duckdb::Value(row.usage.prefix));
+        output.data[2].SetValue(count, row.has_quota ? duckdb::Value::UBIGINT(row.usage.limit) : duckdb::Value(duckdb::LogicalType::UBIGINT));
+        output.data[3].SetValue(count, duckdb::Value::UBIGINT(row.usage.cached_bytes));
+        output.data[4].SetValue(count, duckdb::Value::UBIGINT(row.usage.block_count));
+        ++count;
+    }
+    output.SetCardinality(count);
+}
+
+static void ExecCacheStatsFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    auto &data = data_p.bind_data->CastNoConst<CacheStatsFunctionData>();
+
+    idx_t count = 0;
+    while (data.offset < data.rows.size() && count < STANDARD_VECTOR_SIZE) {
+        const auto &row = data.rows[data.offset++];
+        output.data[0].SetValue(count, duckdb::Value(row.cache_path));
+        output.data[1].SetValue(count, duckdb::Value::UBIGINT(row.files));
+        output.data[2].SetValue(count, duckdb::Value::UBIGINT(row.cached_bytes));
+        output.data[3].SetValue(count, duckdb::Value::UBIGINT(row.max_cache_size));
+        output.data[4].SetValue(count, duckdb::Value::UBIGINT(row.metadata_bytes));
+        output.data[5].SetValue(count, row.metadata_budget != 0 ? duckdb::Value::UBIGINT(row.metadata_budget) : duckdb::Value(duckdb::LogicalType::UBIGINT));
+        ++count;
+    }
+    output.SetCardinality(count);
+}
 
 static void ExecClearCacheFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
     auto &data = data_p.bind_data->CastNoConst<ClearCacheFunctionData>();
@@ -86,7 +345,12 @@ static void ExecClearCacheFunction(duckdb::ClientContext &context, duckdb::Table
         params = ExtensionParams::ReadFrom(context);
 
         quackstore_state->GetCache().Open(params.cache_path);
-        quackstore_state->GetCache().Clear();
+        if (quackstore_state->GetRouter()) {
+            // Named caches are cleared along with the default cache
+            quackstore_state->GetRouter()->ForEachCache([](Cache &cache) { cache.Clear(); });
+        } else {
+            quackstore_state->GetCache().Clear();
+        }
         // Set output to indicate success
         output.SetCardinality(1);
         output.data[0].SetValue(0, true);
@@ -116,12 +380,15 @@ static void ExecEvictFilesFunction(duckdb::ClientContext &context, duckdb::Table
     
     auto& cache = quackstore_state->GetCache();
     bool success = true;
-    for(const auto& path: data.paths) {
-        try {
-            cache.Evict(path);
-        } catch (...) {
-            success = false;
+    try {
+        // One batch per cache, published at once
+        if (quackstore_state->GetRouter()) {
+            quackstore_state->GetRouter()->ForEachCache([&](Cache &cache) { cache.EvictFiles(data.paths); });
+        } else {
+            cache.EvictFiles(data.paths);
         }
+    } catch (...) {
+        success = false;
     }
     
     // Set output to indicate success/failure
@@ -130,6 +397,40 @@ static void ExecEvictFilesFunction(duckdb::ClientContext &context, duckdb::Table
     data.finished = true;
 }
 
+static void ExecEvictMatching(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output,
+                              idx_t (Cache::*evict)(const duckdb::string &)) {
+    auto &data = data_p.bind_data->CastNoConst<EvictMatchingFunctionData>();
+    if (data.finished) {
+        return;
+    }
+    data.finished = true;
+
+    idx_t evicted_files = 0;
+    auto quackstore_state = ExtensionState::RetrieveFromContext(context);
+    if (quackstore_state) {
+        const auto evict_from = [&](Cache &cache) {
+            if (cache.IsOpen()) {
+                evicted_files += (cache.*evict)(data.pattern);
+            }
+        };
+        if (quackstore_state->GetRouter()) {
+            quackstore_state->GetRouter()->ForEachCache(evict_from);
+        } else {
+            evict_from(quackstore_state->GetCache());
+        }
+    }
+    output.SetCardinality(1);
+    output.data[0].SetValue(0, duckdb::Value::UBIGINT(evicted_files));
+}
+
+static void ExecEvictPrefixFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    ExecEvictMatching(context, data_p, output, &Cache::EvictPrefix);
+}
+
+static void ExecEvictGlobFunction(duckdb::ClientContext &context, duckdb::TableFunctionInput &data_p, duckdb::DataChunk &output) {
+    ExecEvictMatching(context, data_p, output, &Cache::EvictGlob);
+}
+
 duckdb::TableFunctionSet GetClearCacheFunctions(duckdb::DatabaseInstance& instance)
 {
     auto function_set = duckdb::TableFunctionSet{"quackstore_clear_cache"};
@@ -144,11 +445,60 @@ duckdb::TableFunctionSet GetEvictFilesFunctions(duckdb::DatabaseInstance& instan
     return function_set;
 }
 
+duckdb::TableFunctionSet GetEvictPrefixFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_evict_prefix"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_evict_prefix", {duckdb::LogicalType::VARCHAR}, ExecEvictPrefixFunction, BindEvictMatchingFunction});
+    return function_set;
+}
+
+duckdb::TableFunctionSet GetEvictGlobFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_evict_glob"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_evict_glob", {duckdb::LogicalType::VARCHAR}, ExecEvictGlobFunction, BindEvictMatchingFunction});
+    return function_set;
+}
+
+duckdb::TableFunctionSet GetCacheGroupsFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_cache_groups"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_cache_groups", {}, ExecCacheGroupsFunction, BindCacheGroupsFunction});
+    return function_set;
+}
+
+duckdb::TableFunctionSet GetCacheStatsFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_cache_stats"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_cache_stats", {}, ExecCacheStatsFunction, BindCacheStatsFunction});
+    return function_set;
+}
+
+duckdb::TableFunctionSet GetExportFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_export"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_export", {duckdb::LogicalType::VARCHAR}, ExecExportFunction, BindExportFunction});
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_export", {duckdb::LogicalType::VARCHAR, duckdb::LogicalType::VARCHAR}, ExecExportFunction, BindExportFunction});
+    return function_set;
+}
+
+duckdb::TableFunctionSet GetImportFunctions(duckdb::DatabaseInstance& instance)
+{
+    auto function_set = duckdb::TableFunctionSet{"quackstore_import"};
+    function_set.AddFunction(duckdb::TableFunction{"quackstore_import", {duckdb::LogicalType::VARCHAR}, ExecImportFunction, BindImportFunction});
+    return function_set;
+}
+
 duckdb::vector<duckdb::TableFunctionSet> Functions::GetTableFunctions(duckdb::DatabaseInstance& instance) 
 {
     return duckdb::vector<duckdb::TableFunctionSet> {
         GetClearCacheFunctions(instance),
-        GetEvictFilesFunctions(instance)
+        GetEvictFilesFunctions(instance),
+        GetEvictPrefixFunctions(instance),
+        GetEvictGlobFunctions(instance),
+        GetCacheGroupsFunctions(instance),
+        GetCacheStatsFunctions(instance),
+        GetExportFunctions(instance),
+        GetImportFunctions(instance)
     };
 }
 
@@ -1,10 +1,13 @@
 #include "quackstore_params.hpp"
 
 #include <duckdb/common/file_opener.hpp>
+#include <duckdb/common/string_util.hpp>
+#include <duckdb/main/config.hpp>
 
 #include "extension_state.hpp"
 #include "quackstore_filesystem.hpp"
 #include "cache.hpp"
+#include "cache_router.hpp"
 
 namespace
 {
@@ -31,6 +34,109 @@ namespace
         }
         state_ptr->GetCache().SetMaxCacheSize(val);
     }    
+    void callback_set_auto_size(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        // Applied to the caches when files are opened, together with the settings it's combined with
+        ValidateGlobalScope(scope);
+    }
+    void callback_set_reserved_free_percent(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        if (value.GetValue<uint64_t>() >= 100) {
+            throw duckdb::InvalidInputException("The reserved free space must be a percentage below 100");
+        }
+    }
+    void callback_set_background_eviction(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        // Applied to the caches when files are opened, together with the settings it's combined with
+        ValidateGlobalScope(scope);
+    }
+    void callback_set_eviction_watermark(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        if (value.GetValue<uint64_t>() > 100) {
+            throw duckdb::InvalidInputException("Eviction watermarks are percentages of the cache size");
+        }
+    }
+    void callback_set_metadata_budget(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto budget = value.GetValue<uint64_t>();
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        if (state_ptr->GetRouter()) {
+            state_ptr->GetRouter()->ForEachCache([&](quackstore::Cache &cache) { cache.SetMetadataBudget(budget); });
+        } else {
+            state_ptr->GetCache().SetMetadataBudget(budget);
+        }
+    }
+    void callback_set_warmup_size(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto warmup_size = value.GetValue<uint64_t>();
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        if (state_ptr->GetRouter()) {
+            state_ptr->GetRouter()->ForEachCache([&](quackstore::Cache &cache) { cache.SetWarmupSize(warmup_size); });
+        } else {
+            state_ptr->GetCache().SetWarmupSize(warmup_size);
+        }
+    }
+    void callback_set_dedup_enabled(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        state_ptr->GetCache().SetDeduplicationEnabled(value.GetValue<bool>());
+    }
+    void callback_set_pack_threshold(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        state_ptr->GetCache().SetPackThreshold(value.GetValue<uint64_t>());
+    }
+    void callback_set_block_size(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto val = value.GetValue<uint64_t>();
+        if (val == 0) {
+            return;
+        }
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        state_ptr->GetCache().SetBlockSize(val);
+    }
+    void callback_set_shared_cache(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        state_ptr->GetCache().SetSharedAccessEnabled(value.GetValue<bool>());
+    }
     void callback_set_cache_path(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
     {
         ValidateGlobalScope(scope);
@@ -48,6 +154,66 @@ namespace
 
         cache.Close();
     }
+    void callback_set_lower_cache_path(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto new_path = value.GetValue<duckdb::string>();
+        auto local_fs = duckdb::FileSystem::CreateLocal();
+        if (!new_path.empty() && !local_fs->FileExists(new_path)) {
+            throw duckdb::IOException("Read-only cache file \"%s\" doesn't exist", new_path);
+        }
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        if (state_ptr->GetRouter()) {
+            state_ptr->GetRouter()->CloseLowerTier();
+        }
+    }
+    void callback_set_quotas(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        auto quotas = quackstore::ExtensionParams::ParseQuotas(value.GetValue<duckdb::string>());
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        if (state_ptr->GetRouter()) {
+            state_ptr->GetRouter()->ForEachCache([&](quackstore::Cache &cache) { cache.SetQuotas(quotas); });
+        } else {
+            state_ptr->GetCache().SetQuotas(quotas);
+        }
+    }
+    void callback_set_glob_order(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        // Validate the order before it is stored
+        quackstore::ExtensionParams::ParseGlobOrder(value.GetValue<duckdb::string>());
+    }
+    void callback_set_storage_layout(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        // Applied when cache files are created
+        ValidateGlobalScope(scope);
+        quackstore::ExtensionParams::ParseStorageLayout(value.GetValue<duckdb::string>());
+    }
+    void callback_set_caches(duckdb::ClientContext& context, duckdb::SetScope scope, duckdb::Value& value)
+    {
+        ValidateGlobalScope(scope);
+
+        // Validate the definitions before they are stored
+        auto caches = quackstore::ExtensionParams::ParseNamedCaches(value.GetValue<duckdb::string>(), {});
+
+        auto state_ptr = quackstore::ExtensionState::RetrieveFromContext(context);
+        if (!state_ptr) {
+            throw duckdb::InternalException("Cache file system state is not initialized");
+        }
+        if (state_ptr->GetRouter()) {
+            state_ptr->GetRouter()->Configure(caches);
+        }
+    }
 }
 
 namespace quackstore {
@@ -68,6 +234,38 @@ ExtensionParams ExtensionParams::ReadFrom(duckdb::optional_ptr<duckdb::FileOpene
         auto cache_size_in_bytes = value.GetValue<uint64_t>();
         result.max_cache_size = cache_size_in_bytes;
     }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHE_SIZE_AUTO, value)) {
+        auto cache_size_auto = value.GetValue<bool>();
+        result.cache_size_auto = cache_size_auto;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHE_SIZE_MIN, value)) {
+        auto min_cache_size = value.GetValue<uint64_t>();
+        result.min_cache_size = min_cache_size;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT, value)) {
+        auto reserved_free_percent = value.GetValue<uint64_t>();
+        result.reserved_free_percent = reserved_free_percent;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_BACKGROUND_EVICTION, value)) {
+        auto background_eviction = value.GetValue<bool>();
+        result.background_eviction = background_eviction;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_EVICTION_LOW_WATERMARK, value)) {
+        auto eviction_low_watermark = value.GetValue<uint64_t>();
+        result.eviction_low_watermark = eviction_low_watermark;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_EVICTION_HIGH_WATERMARK, value)) {
+        auto eviction_high_watermark = value.GetValue<uint64_t>();
+        result.eviction_high_watermark = eviction_high_watermark;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_METADATA_BUDGET, value)) {
+        auto metadata_budget = value.GetValue<uint64_t>();
+        result.metadata_budget = metadata_budget;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_WARMUP_SIZE, value)) {
+        auto warmup_size = value.GetValue<uint64_t>();
+        result.warmup_size = warmup_size;
+    }
     if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHE_PATH, value)) {
         auto path = value.GetValue<duckdb::string>();
         result.cache_path = path;
@@ -76,6 +274,58 @@ ExtensionParams ExtensionParams::ReadFrom(duckdb::optional_ptr<duckdb::FileOpene
         auto data_mutable = value.GetValue<bool>();
         result.data_mutable = data_mutable;
     }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_DEDUP_ENABLED, value)) {
+        auto dedup_enabled = value.GetValue<bool>();
+        result.dedup_enabled = dedup_enabled;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_PACK_THRESHOLD, value)) {
+        auto pack_threshold = value.GetValue<uint64_t>();
+        result.pack_threshold = pack_threshold;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_BLOCK_SIZE, value)) {
+        auto block_size = value.GetValue<uint64_t>();
+        result.block_size = block_size;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_ADAPTIVE_BLOCK_SIZE, value)) {
+        auto adaptive_block_size = value.GetValue<bool>();
+        result.adaptive_block_size = adaptive_block_size;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHE_DECOMPRESSED, value)) {
+        auto cache_decompressed = value.GetValue<bool>();
+        result.cache_decompressed = cache_decompressed;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_WRITE_THROUGH, value)) {
+        auto write_through = value.GetValue<bool>();
+        result.write_through = write_through;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_BACKING_TIER, value)) {
+        auto backing_tier = value.GetValue<bool>();
+        result.backing_tier = backing_tier;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_TABLE_PREFETCH, value)) {
+        auto table_prefetch = value.GetValue<bool>();
+        result.table_prefetch = table_prefetch;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_GLOB_ORDER, value)) {
+        result.glob_order = ParseGlobOrder(value.GetValue<duckdb::string>());
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_STORAGE_LAYOUT, value)) {
+        result.storage_layout = ParseStorageLayout(value.GetValue<duckdb::string>());
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_SHARED_CACHE, value)) {
+        auto shared_cache = value.GetValue<bool>();
+        result.shared_cache = shared_cache;
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_LOWER_CACHE_PATH, value)) {
+        result.lower_cache_path = value.GetValue<duckdb::string>();
+    }
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_QUOTAS, value)) {
+        result.quotas = ParseQuotas(value.GetValue<duckdb::string>());
+    }
+    // Parsed last, the named caches default to the other settings
+    if (duckdb::FileOpener::TryGetCurrentSetting(opener, PARAM_NAME_QUACKSTORE_CACHES, value)) {
+        result.caches = ParseNamedCaches(value.GetValue<duckdb::string>(), result);
+    }
 
     return result;
 }
@@ -92,6 +342,38 @@ ExtensionParams ExtensionParams::ReadFrom(const duckdb::ClientContext& context)
         auto cache_size_in_bytes = value.GetValue<uint64_t>();
         result.max_cache_size = cache_size_in_bytes;
     }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_SIZE_AUTO, value)) {
+        auto cache_size_auto = value.GetValue<bool>();
+        result.cache_size_auto = cache_size_auto;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_SIZE_MIN, value)) {
+        auto min_cache_size = value.GetValue<uint64_t>();
+        result.min_cache_size = min_cache_size;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT, value)) {
+        auto reserved_free_percent = value.GetValue<uint64_t>();
+        result.reserved_free_percent = reserved_free_percent;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BACKGROUND_EVICTION, value)) {
+        auto background_eviction = value.GetValue<bool>();
+        result.background_eviction = background_eviction;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_EVICTION_LOW_WATERMARK, value)) {
+        auto eviction_low_watermark = value.GetValue<uint64_t>();
+        result.eviction_low_watermark = eviction_low_watermark;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_EVICTION_HIGH_WATERMARK, value)) {
+        auto eviction_high_watermark = value.GetValue<uint64_t>();
+        result.eviction_high_watermark = eviction_high_watermark;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_METADATA_BUDGET, value)) {
+        auto metadata_budget = value.GetValue<uint64_t>();
+        result.metadata_budget = metadata_budget;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_WARMUP_SIZE, value)) {
+        auto warmup_size = value.GetValue<uint64_t>();
+        result.warmup_size = warmup_size;
+    }
     if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_PATH, value)) {
         auto path = value.GetValue<duckdb::string>();
         result.cache_path = path;
@@ -100,6 +382,58 @@ ExtensionParams ExtensionParams::ReadFrom(const duckdb::ClientContext& context)
         auto data_mutable = value.GetValue<bool>();
         result.data_mutable = data_mutable;
     }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_DEDUP_ENABLED, value)) {
+        auto dedup_enabled = value.GetValue<bool>();
+        result.dedup_enabled = dedup_enabled;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_PACK_THRESHOLD, value)) {
+        auto pack_threshold = value.GetValue<uint64_t>();
+        result.pack_threshold = pack_threshold;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BLOCK_SIZE, value)) {
+        auto block_size = value.GetValue<uint64_t>();
+        result.block_size = block_size;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_ADAPTIVE_BLOCK_SIZE, value)) {
+        auto adaptive_block_size = value.GetValue<bool>();
+        result.adaptive_block_size = adaptive_block_size;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_DECOMPRESSED, value)) {
+        auto cache_decompressed = value.GetValue<bool>();
+        result.cache_decompressed = cache_decompressed;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_WRITE_THROUGH, value)) {
+        auto write_through = value.GetValue<bool>();
+        result.write_through = write_through;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BACKING_TIER, value)) {
+        auto backing_tier = value.GetValue<bool>();
+        result.backing_tier = backing_tier;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_TABLE_PREFETCH, value)) {
+        auto table_prefetch = value.GetValue<bool>();
+        result.table_prefetch = table_prefetch;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_GLOB_ORDER, value)) {
+        result.glob_order = ParseGlobOrder(value.GetValue<duckdb::string>());
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_STORAGE_LAYOUT, value)) {
+        result.storage_layout = ParseStorageLayout(value.GetValue<duckdb::string>());
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_SHARED_CACHE, value)) {
+        auto shared_cache = value.GetValue<bool>();
+        result.shared_cache = shared_cache;
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_LOWER_CACHE_PATH, value)) {
+        result.lower_cache_path = value.GetValue<duckdb::string>();
+    }
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_QUOTAS, value)) {
+        result.quotas = ParseQuotas(value.GetValue<duckdb::string>());
+    }
+    // Parsed last, the named caches default to the other settings
+    if (context.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHES, value)) {
+        result.caches = ParseNamedCaches(value.GetValue<duckdb::string>(), result);
+    }
 
     return result;
 }
@@ -117,6 +451,38 @@ ExtensionParams ExtensionParams::ReadFrom(const duckdb::DatabaseInstance& instan
         auto cache_size_in_bytes = value.GetValue<uint64_t>();
         result.max_cache_size = cache_size_in_bytes;
     }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_SIZE_AUTO, value)) {
+        auto cache_size_auto = value.GetValue<bool>();
+        result.cache_size_auto = cache_size_auto;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_SIZE_MIN, value)) {
+        auto min_cache_size = value.GetValue<uint64_t>();
+        result.min_cache_size = min_cache_size;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT, value)) {
+        auto reserved_free_percent = value.GetValue<uint64_t>();
+        result.reserved_free_percent = reserved_free_percent;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BACKGROUND_EVICTION, value)) {
+        auto background_eviction = value.GetValue<bool>();
+        result.background_eviction = background_eviction;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_EVICTION_LOW_WATERMARK, value)) {
+        auto eviction_low_watermark = value.GetValue<uint64_t>();
+        result.eviction_low_watermark = eviction_low_watermark;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_EVICTION_HIGH_WATERMARK, value)) {
+        auto eviction_high_watermark = value.GetValue<uint64_t>();
+        result.eviction_high_watermark = eviction_high_watermark;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_METADATA_BUDGET, value)) {
+        auto metadata_budget = value.GetValue<uint64_t>();
+        result.metadata_budget = metadata_budget;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_WARMUP_SIZE, value)) {
+        auto warmup_size = value.GetValue<uint64_t>();
+        result.warmup_size = warmup_size;
+    }
     if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_PATH, value)) {
         auto path = value.GetValue<duckdb::string>();
         result.cache_path = path;
@@ -125,6 +491,58 @@ ExtensionParams ExtensionParams::ReadFrom(const duckdb::DatabaseInstance& instan
         auto data_mutable = value.GetValue<bool>();
         result.data_mutable = data_mutable;
     }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_DEDUP_ENABLED, value)) {
+        auto dedup_enabled = value.GetValue<bool>();
+        result.dedup_enabled = dedup_enabled;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_PACK_THRESHOLD, value)) {
+        auto pack_threshold = value.GetValue<uint64_t>();
+        result.pack_threshold = pack_threshold;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BLOCK_SIZE, value)) {
+        auto block_size = value.GetValue<uint64_t>();
+        result.block_size = block_size;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_ADAPTIVE_BLOCK_SIZE, value)) {
+        auto adaptive_block_size = value.GetValue<bool>();
+        result.adaptive_block_size = adaptive_block_size;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHE_DECOMPRESSED, value)) {
+        auto cache_decompressed = value.GetValue<bool>();
+        result.cache_decompressed = cache_decompressed;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_WRITE_THROUGH, value)) {
+        auto write_through = value.GetValue<bool>();
+        result.write_through = write_through;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_BACKING_TIER, value)) {
+        auto backing_tier = value.GetValue<bool>();
+        result.backing_tier = backing_tier;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_TABLE_PREFETCH, value)) {
+        auto table_prefetch = value.GetValue<bool>();
+        result.table_prefetch = table_prefetch;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_GLOB_ORDER, value)) {
+        result.glob_order = ParseGlobOrder(value.GetValue<duckdb::string>());
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_STORAGE_LAYOUT, value)) {
+        result.storage_layout = ParseStorageLayout(value.GetValue<duckdb::string>());
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_SHARED_CACHE, value)) {
+        auto shared_cache = value.GetValue<bool>();
+        result.shared_cache = shared_cache;
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_LOWER_CACHE_PATH, value)) {
+        result.lower_cache_path = value.GetValue<duckdb::string>();
+    }
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_QUOTAS, value)) {
+        result.quotas = ParseQuotas(value.GetValue<duckdb::string>());
+    }
+    // Parsed last, the named caches default to the other settings
+    if (instance.TryGetCurrentSetting(PARAM_NAME_QUACKSTORE_CACHES, value)) {
+        result.caches = ParseNamedCaches(value.GetValue<duckdb::string>(), result);
+    }
 
     return result;
 }
@@ -147,6 +565,62 @@ void ExtensionParams::AddExtensionOptions(duckdb::DBConfig &config) {
         duckdb::Value::UBIGINT(default_params.max_cache_size),
         callback_set_cache_size
     );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_CACHE_SIZE_AUTO, 
+        "Derive the cache size from the free space of the cache volume, recomputed periodically (quackstore_cache_size is the maximum)",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.cache_size_auto),
+        callback_set_auto_size
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_CACHE_SIZE_MIN, 
+        "Minimum cache size (bytes) when the cache size is derived from the free space",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.min_cache_size),
+        callback_set_auto_size
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_CACHE_RESERVED_FREE_PERCENT, 
+        "Percentage of the cache volume kept free when the cache size is derived from the free space",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.reserved_free_percent),
+        callback_set_reserved_free_percent
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_BACKGROUND_EVICTION, 
+        "Evict in batches on a background thread between the eviction watermarks instead of on every store",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.background_eviction),
+        callback_set_background_eviction
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_EVICTION_LOW_WATERMARK, 
+        "Percentage of the cache size background eviction evicts down to",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.eviction_low_watermark),
+        callback_set_eviction_watermark
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_EVICTION_HIGH_WATERMARK, 
+        "Percentage of the cache size above which background eviction starts",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.eviction_high_watermark),
+        callback_set_eviction_watermark
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_METADATA_BUDGET, 
+        "Memory budget (bytes) of the cache metadata, least recently used files are dropped beyond it (0 for no budget)",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.metadata_budget),
+        callback_set_metadata_budget
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_WARMUP_SIZE, 
+        "Bytes of the most recently used blocks read into the OS page cache in the background after a cache is opened (0 for no warm-up)",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.warmup_size),
+        callback_set_warmup_size
+    );
     config.AddExtensionOption(
         PARAM_NAME_QUACKSTORE_CACHE_PATH, 
         "Cache path",
@@ -160,6 +634,229 @@ void ExtensionParams::AddExtensionOptions(duckdb::DBConfig &config) {
         duckdb::LogicalTypeId::BOOLEAN,
         duckdb::Value::BOOLEAN(default_params.data_mutable)
     );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_DEDUP_ENABLED, 
+        "Store blocks with identical content only once, sharing them between files",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.dedup_enabled),
+        callback_set_dedup_enabled
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_PACK_THRESHOLD, 
+        "Tail blocks smaller than this (bytes) are packed together into shared blocks, 0 disables packing",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.pack_threshold),
+        callback_set_pack_threshold
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_BLOCK_SIZE, 
+        "Cache block size (bytes, power of two), 0 keeps the block size of the cache",
+        duckdb::LogicalTypeId::UBIGINT,
+        duckdb::Value::UBIGINT(default_params.block_size),
+        callback_set_block_size
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_ADAPTIVE_BLOCK_SIZE, 
+        "Fetch and store extents of several blocks for sequentially read regions of a file",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.adaptive_block_size)
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_CACHE_DECOMPRESSED, 
+        "Cache the decompressed streams of gzip-compressed files as seekable blocks",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.cache_decompressed)
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_WRITE_THROUGH, 
+        "Store the blocks of files written through quackstore:// (e.g. by COPY TO) in the cache",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.write_through)
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_BACKING_TIER, 
+        "Act as the persistent tier behind DuckDB's external file cache, blocks read from the cache file are dropped from the OS page cache",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.backing_tier)
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_TABLE_PREFETCH, 
+        "Prefetch the manifests and data file footers referenced by Iceberg and Delta metadata read through quackstore://",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.table_prefetch)
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_GLOB_ORDER, 
+        "Order of the files matched by globs: 'source', 'cached_first' or 'interleaved' (files not fully cached are prefetched)",
+        duckdb::LogicalTypeId::VARCHAR,
+        duckdb::Value{DEFAULT_QUACKSTORE_GLOB_ORDER},
+        callback_set_glob_order
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_STORAGE_LAYOUT, 
+        "Layout of new cache files: 'in_place' (blocks overwritten in place) or 'segmented' (blocks appended to segments)",
+        duckdb::LogicalTypeId::VARCHAR,
+        duckdb::Value{DEFAULT_QUACKSTORE_STORAGE_LAYOUT},
+        callback_set_storage_layout
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_SHARED_CACHE, 
+        "Share the cache file with other processes using the same cache path",
+        duckdb::LogicalTypeId::BOOLEAN,
+        duckdb::Value::BOOLEAN(default_params.shared_cache),
+        callback_set_shared_cache
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_CACHES, 
+        "Named caches serving the files under a path prefix: 'name: prefix=..., path=...[, size=...][, block_size=...][, dedup=...]; ...'",
+        duckdb::LogicalTypeId::VARCHAR,
+        duckdb::Value{DEFAULT_QUACKSTORE_CACHES},
+        callback_set_caches
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_LOWER_CACHE_PATH, 
+        "Read-only cache file (e.g. a pre-warmed image on a shared volume) consulted on cache misses before the source",
+        duckdb::LogicalTypeId::VARCHAR,
+        duckdb::Value{default_params.lower_cache_path},
+        callback_set_lower_cache_path
+    );
+    config.AddExtensionOption(
+        PARAM_NAME_QUACKSTORE_QUOTAS, 
+        "Byte quotas of the files under path prefixes, evicted first when exceeded: 'prefix=bytes|percent%; ...'",
+        duckdb::LogicalTypeId::VARCHAR,
+        duckdb::Value{DEFAULT_QUACKSTORE_QUOTAS},
+        callback_set_quotas
+    );
+}
+
+GlobOrder ExtensionParams::ParseGlobOrder(const duckdb::string &value) {
+    auto order = duckdb::StringUtil::Lower(value);
+    duckdb::StringUtil::Trim(order);
+    if (order == "source") {
+        return GlobOrder::SOURCE;
+    }
+    if (order == "cached_first") {
+        return GlobOrder::CACHED_FIRST;
+    }
+    if (order == "interleaved") {
+        return GlobOrder::INTERLEAVED;
+    }
+    throw duckdb::InvalidInputException("Glob order \"%s\" must be 'source', 'cached_first' or 'interleaved'", value);
+}
+
+StorageLayout ExtensionParams::ParseStorageLayout(const duckdb::string &value) {
+    auto layout = duckdb::StringUtil::Lower(value);
+    duckdb::StringUtil::Trim(layout);
+    if (layout == "in_place") {
+        return StorageLayout::IN_PLACE;
+    }
+    if (layout == "segmented") {
+        return StorageLayout::SEGMENTED;
+    }
+    throw duckdb::InvalidInputException("Storage layout \"%s\" must be 'in_place' or 'segmented'", value);
+}
+
+duckdb::vector<MetadataManager::Quota> ExtensionParams::ParseQuotas(const duckdb::string &value) {
+    duckdb::vector<MetadataManager::Quota> result;
+    for (auto &definition : duckdb::StringUtil::Split(value, ';')) {
+        duckdb::StringUtil::Trim(definition);
+        if (definition.empty()) {
+            continue;
+        }
+
+        // Prefixes may contain '=' themselves, the quota follows the last one
+        auto assignment = definition.rfind('=');
+        if (assignment == duckdb::string::npos) {
+            throw duckdb::InvalidInputException("Quota \"%s\" must be \"prefix=quota\"", definition);
+        }
+        MetadataManager::Quota quota;
+        quota.prefix = definition.substr(0, assignment);
+        auto limit = definition.substr(assignment + 1);
+        duckdb::StringUtil::Trim(quota.prefix);
+        duckdb::StringUtil::Trim(limit);
+        if (quota.prefix.empty() || limit.empty()) {
+            throw duckdb::InvalidInputException("Quota \"%s\" must be \"prefix=quota\"", definition);
+        }
+        for (const auto &existing : result) {
+            if (existing.prefix == quota.prefix) {
+                throw duckdb::InvalidInputException("Quota for prefix \"%s\" is defined more than once", quota.prefix);
+            }
+        }
+
+        if (limit.back() == '%') {
+            auto percent = duckdb::Value(limit.substr(0, limit.size() - 1)).GetValue<int64_t>();
+            if (percent <= 0 || percent > 100) {
+                throw duckdb::InvalidInputException("Quota percentage for prefix \"%s\" must be between 1 and 100",
+                                                    quota.prefix);
+            }
+            quota.percent = static_cast<uint8_t>(percent);
+        } else {
+            quota.max_bytes = duckdb::DBConfig::ParseMemoryLimit(limit);
+        }
+        result.push_back(std::move(quota));
+    }
+    return result;
+}
+
+duckdb::vector<NamedCacheConfig> ExtensionParams::ParseNamedCaches(const duckdb::string &value,
+                                                                   const ExtensionParams &defaults) {
+    duckdb::vector<NamedCacheConfig> result;
+    for (auto &definition : duckdb::StringUtil::Split(value, ';')) {
+        duckdb::StringUtil::Trim(definition);
+        if (definition.empty()) {
+            continue;
+        }
+
+        auto separator = definition.find(':');
+        if (separator == duckdb::string::npos) {
+            throw duckdb::InvalidInputException("Named cache \"%s\" must start with \"<name>:\"", definition);
+        }
+        NamedCacheConfig config;
+        config.name = definition.substr(0, separator);
+        duckdb::StringUtil::Trim(config.name);
+        config.max_cache_size = defaults.max_cache_size;
+        config.block_size = defaults.block_size;
+        config.dedup_enabled = defaults.dedup_enabled;
+        if (config.name.empty()) {
+            throw duckdb::InvalidInputException("Named cache \"%s\" has an empty name", definition);
+        }
+        for (const auto &existing : result) {
+            if (existing.name == config.name) {
+                throw duckdb::InvalidInputException("Named cache \"%s\" is defined more than once", config.name);
+            }
+        }
+
+        for (auto &option : duckdb::StringUtil::Split(definition.substr(separator + 1), ',')) {
+            auto assignment = option.find('=');
+            if (assignment == duckdb::string::npos) {
+                throw duckdb::InvalidInputException("Option \"%s\" of named cache \"%s\" must be \"key=value\"",
+                                                    option, config.name);
+            }
+            auto key = duckdb::StringUtil::Lower(option.substr(0, assignment));
+            auto option_value = option.substr(assignment + 1);
+            duckdb::StringUtil::Trim(key);
+            duckdb::StringUtil::Trim(option_value);
+            if (key == "prefix") {
+                config.prefix = option_value;
+            } else if (key == "path") {
+                config.path = option_value;
+            } else if (key == "size") {
+                config.max_cache_size = duckdb::DBConfig::ParseMemoryLimit(option_value);
+            } else if (key == "block_size") {
+                config.block_size = duckdb::DBConfig::ParseMemoryLimit(option_value);
+            } else if (key == "dedup") {
+                config.dedup_enabled = duckdb::Value(option_value).GetValue<bool>();
+            } else {
+                throw duckdb::InvalidInputException("Unknown option \"%s\" of named cache \"%s\"", key, config.name);
+            }
+        }
+
+        if (config.prefix.empty() || config.path.empty()) {
+            throw duckdb::InvalidInputException("Named cache \"%s\" requires a prefix and a path", config.name);
+        }
+        result.push_back(std::move(config));
+    }
+    return result;
 }
 
 }  // namespace quackstore
@@ -0,0 +1,196 @@
+#include "segment_table.hpp"
+
+namespace quackstore {
+
+// =============================================================================
+// SegmentTable
+// =============================================================================
+
+SegmentTable::SegmentTable(uint64_t segment_slots) : segment_slots(segment_slots) {
+    D_ASSERT(segment_slots > 0);
+}
+
+void SegmentTable::Clear() {
+    locations.clear();
+    slot_blocks.clear();
+    live_slots.clear();
+    free_segments.clear();
+    pending_segments.clear();
+    head_segment = NO_SEGMENT;
+    head_slot = 0;
+}
+
+bool SegmentTable::TryGetLocation(block_id_t block_id, Location &location_out) const {
+    auto it = locations.find(block_id);
+    if (it == locations.end()) {
+        return false;
+    }
+    location_out = it->second;
+    return true;
+}
+
+uint64_t SegmentTable::Place(block_id_t block_id, uint64_t slot_count) {
+    D_ASSERT(slot_count > 0);
+    Remove(block_id);
+
+    Location location{0, slot_count};
+    if (slot_count > segment_slots) {
+        // Whole segments of their own, they're reused as regular segments once the block is gone
+        const auto first_segment = live_slots.size();
+        live_slots.resize(first_segment + (slot_count + segment_slots - 1) / segment_slots, 0);
+        location.slot = first_segment * segment_slots;
+    } else {
+        if (head_segment == NO_SEGMENT || head_slot + slot_count > segment_slots) {
+            OpenSegment();
+        }
+        location.slot = head_segment * segment_slots + head_slot;
+        head_slot += slot_count;
+    }
+    Restore(block_id, location);
+    return location.slot;
+}
+
+void SegmentTable::Restore(block_id_t block_id, const Location &location) {
+    Remove(block_id);
+    const auto end_segment = (location.slot + location.slot_count + segment_slots - 1) / segment_slots;
+    if (live_slots.size() < end_segment) {
+        live_slots.resize(end_segment, 0);
+    }
+    locations[block_id] = location;
+    slot_blocks[location.slot] = block_id;
+    AddLiveSlots(location);
+}
+
+void SegmentTable::Remove(block_id_t block_id) {
+    auto it = locations.find(block_id);
+    if (it == locations.end()) {
+        return;
+    }
+    RemoveLiveSlots(it->second);
+    slot_blocks.erase(it->second.slot);
+    locations.erase(it);
+}
+
+bool SegmentTable::FindSparseSegment(uint8_t live_percent, block_id_t keep_block_id, uint64_t &segment_out) const {
+    uint64_t keep_begin = 0;
+    uint64_t keep_end = 0;
+    Location keep_location;
+    if (TryGetLocation(keep_block_id, keep_location)) {
+        keep_begin = keep_location.slot / segment_slots;
+        keep_end = (keep_location.slot + keep_location.slot_count + segment_slots - 1) / segment_slots;
+    }
+
+    bool found = false;
+    for (uint64_t segment = 0; segment < live_slots.size(); ++segment) {
+        const auto live = live_slots[segment];
+        if (segment == head_segment || live == 0 || (keep_begin <= segment && segment < keep_end) ||
+            live * 100 >= segment_slots * live_percent) {
+            continue;
+        }
+        if (!found || live < live_slots[segment_out]) {
+            segment_out = segment;
+            found = true;
+        }
+    }
+    return found;
+}
+
+duckdb::vector<block_id_t> SegmentTable::GetSegmentBlocks(uint64_t segment) const {
+    duckdb::vector<block_id_t> result;
+    for (auto it = slot_blocks.lower_bound(segment * segment_slots);
+         it != slot_blocks.end() && it->first < (segment + 1) * segment_slots; ++it) {
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+void SegmentTable::Write(duckdb::WriteStream &ser) const {
+    uint64_t num_locations = 0;
+    for (const auto &entry : locations) {
+        num_locations += entry.first >= 0 ? 1 : 0;
+    }
+    ser.Write<uint64_t>(segment_slots);
+    ser.Write<uint64_t>(live_slots.size());
+    ser.Write<uint64_t>(num_locations);
+    for (const auto &[block_id, location] : locations) {
+        if (block_id < 0) {
+            continue;
+        }
+        ser.Write<int64_t>(block_id);
+        ser.Write<uint64_t>(location.slot);
+        ser.Write<uint64_t>(location.slot_count);
+    }
+}
+
+void SegmentTable::Read(duckdb::ReadStream &source) {
+    Clear();
+    const auto stored_segment_slots = source.Read<uint64_t>();
+    if (stored_segment_slots != segment_slots) {
+        throw duckdb::IOException("Segment size mismatch: stored %llu slots per segment, expected %llu",
+                                  stored_segment_slots, segment_slots);
+    }
+    live_slots.resize(source.Read<uint64_t>(), 0);
+    const auto num_locations = source.Read<uint64_t>();
+    for (uint64_t i = 0; i < num_locations; ++i) {
+        const auto block_id = source.Read<int64_t>();
+        Location location;
+        location.slot = source.Read<uint64_t>();
+        location.slot_count = source.Read<uint64_t>();
+        Restore(block_id, location);
+    }
+    // The head isn't stored, appending starts in a segment without live slots
+    for (uint64_t segment = 0; segment < live_slots.size(); ++segment) {
+        if (live_slots[segment] == 0) {
+            free_segments.insert(segment);
+        }
+    }
+}
+
+void SegmentTable::ReleasePendingSegments() {
+    for (const auto segment : pending_segments) {
+        if (live_slots[segment] == 0 && segment != head_segment) {
+            free_segments.insert(segment);
+        }
+    }
+    pending_segments.clear();
+}
+
+void SegmentTable::OpenSegment() {
+    if (head_segment != NO_SEGMENT && live_slots[head_segment] == 0) {
+        pending_segments.insert(head_segment);
+    }
+    if (!free_segments.empty()) {
+        head_segment = *free_segments.begin();
+        free_segments.erase(free_segments.begin());
+    } else {
+        head_segment = live_slots.size();
+        live_slots.push_back(0);
+    }
+    head_slot = 0;
+}
+
+void SegmentTable::AddLiveSlots(const Location &location) {
+    for (auto slot = location.slot; slot < location.slot + location.slot_count;) {
+        const auto segment = slot / segment_slots;
+        const auto segment_end = std::min((segment + 1) * segment_slots, location.slot + location.slot_count);
+        live_slots[segment] += segment_end - slot;
+        free_segments.erase(segment);
+        pending_segments.erase(segment);
+        slot = segment_end;
+    }
+}
+
+void SegmentTable::RemoveLiveSlots(const Location &location) {
+    for (auto slot = location.slot; slot < location.slot + location.slot_count;) {
+        const auto segment = slot / segment_slots;
+        const auto segment_end = std::min((segment + 1) * segment_slots, location.slot + location.slot_count);
+        live_slots[segment] -= segment_end - slot;
+        // The head keeps filling up, it's freed once the head moves on
+        if (live_slots[segment] == 0 && segment != head_segment) {
+            pending_segments.insert(segment);
+        }
+        slot = segment_end;
+    }
+}
+
+}  // namespace quackstore
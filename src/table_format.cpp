@@ -0,0 +1,338 @@
+#include "table_format.hpp"
+
+#include <algorithm>
+
+#include <duckdb/common/string_util.hpp>
+
+#include "miniz.hpp"
+
+namespace quackstore {
+
+using duckdb::StringUtil;
+
+namespace {
+    const duckdb::string SCHEMA_PREFIX = "quackstore://";
+    const duckdb::string DELTA_LOG_DIRECTORY = "/_delta_log/";
+
+    //! Read a JSON string value starting at the opening quote, escapes other than \uXXXX are resolved
+    bool ReadJsonString(const duckdb::string &content, idx_t pos, duckdb::string &out) {
+        if (pos >= content.size() || content[pos] != '"') {
+            return false;
+        }
+        out.clear();
+        for (++pos; pos < content.size(); ++pos) {
+            const char c = content[pos];
+            if (c == '"') {
+                return true;
+            }
+            if (c == '\\' && pos + 1 < content.size()) {
+                const char escaped = content[++pos];
+                switch (escaped) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'u': out += "\\u"; break;
+                default: out += escaped; break;
+                }
+                continue;
+            }
+            out += c;
+        }
+        return false;
+    }
+
+    //! Position of the value of the JSON key found at key_pos (the position of its opening quote)
+    idx_t FindJsonValue(const duckdb::string &content, idx_t key_pos, const duckdb::string &key) {
+        auto pos = key_pos + key.size() + 2;
+        while (pos < content.size() && (content[pos] == ' ' || content[pos] == '\n' || content[pos] == '\r' ||
+                                        content[pos] == '\t' || content[pos] == ':')) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    duckdb::string FindJsonNumber(const duckdb::string &content, idx_t key_pos, const duckdb::string &key) {
+        auto pos = FindJsonValue(content, key_pos, key);
+        auto end = pos;
+        while (end < content.size() && (content[end] == '-' || (content[end] >= '0' && content[end] <= '9'))) {
+            ++end;
+        }
+        return content.substr(pos, end - pos);
+    }
+
+    idx_t FindJsonKey(const duckdb::string &content, const duckdb::string &key, idx_t from = 0) {
+        return content.find("\"" + key + "\"", from);
+    }
+
+    //! Position past the end of the JSON object or array opening at pos, npos if it isn't closed
+    idx_t FindJsonEnd(const duckdb::string &content, idx_t pos) {
+        idx_t depth = 0;
+        for (; pos < content.size(); ++pos) {
+            const char c = content[pos];
+            if (c == '"') {
+                // Brackets in strings don't count
+                for (++pos; pos < content.size() && content[pos] != '"'; ++pos) {
+                    if (content[pos] == '\\') {
+                        ++pos;
+                    }
+                }
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return pos + 1;
+            }
+        }
+        return duckdb::string::npos;
+    }
+
+    //! Delta stores the paths of data files as URIs relative to the table, with special characters escaped
+    duckdb::string DecodeUri(const duckdb::string &uri) {
+        duckdb::string result;
+        for (idx_t i = 0; i < uri.size(); ++i) {
+            if (uri[i] == '%' && i + 2 < uri.size() && StringUtil::CharacterIsHex(uri[i + 1]) &&
+                StringUtil::CharacterIsHex(uri[i + 2])) {
+                result += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                result += uri[i];
+            }
+        }
+        return result;
+    }
+
+    //! Absolute references are read through the cache if the file referencing them was
+    duckdb::string ResolveReference(const duckdb::string &path, const duckdb::string &reference,
+                                    const duckdb::string &table_location) {
+        if (reference.find("://") == duckdb::string::npos && !reference.empty() && reference[0] != '/') {
+            return table_location + "/" + reference;
+        }
+        const bool cached = path.rfind(SCHEMA_PREFIX, 0) == 0;
+        return cached && reference.rfind(SCHEMA_PREFIX, 0) != 0 ? SCHEMA_PREFIX + reference : reference;
+    }
+
+    bool ReadAvroLong(const duckdb::string &data, idx_t &pos, int64_t &value) {
+        uint64_t encoded = 0;
+        for (idx_t shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) {
+                return false;
+            }
+            const auto byte = static_cast<uint8_t>(data[pos++]);
+            encoded |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                // Zig-zag encoding
+                value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReadAvroBytes(const duckdb::string &data, idx_t &pos, duckdb::string &out) {
+        int64_t size = 0;
+        if (!ReadAvroLong(data, pos, size) || size < 0 || pos + size > data.size()) {
+            return false;
+        }
+        out = data.substr(pos, size);
+        pos += size;
+        return true;
+    }
+}
+
+// =============================================================================
+// TableFormat
+// =============================================================================
+
+TableFormat::FileKind TableFormat::Classify(const duckdb::string &path) {
+    const auto separator = path.find_last_of('/');
+    const auto file_name = separator == duckdb::string::npos ? path : path.substr(separator + 1);
+
+    if (path.find(DELTA_LOG_DIRECTORY) != duckdb::string::npos && StringUtil::EndsWith(file_name, ".json")) {
+        return FileKind::DELTA_LOG;
+    }
+    if (StringUtil::EndsWith(file_name, ".metadata.json")) {
+        return FileKind::ICEBERG_METADATA;
+    }
+    if (StringUtil::EndsWith(file_name, ".avro") && path.find("/metadata/") != duckdb::string::npos) {
+        return StringUtil::StartsWith(file_name, "snap-") ? FileKind::ICEBERG_MANIFEST_LIST : FileKind::ICEBERG_MANIFEST;
+    }
+    return FileKind::NONE;
+}
+
+TableFormat::References TableFormat::ExtractReferences(FileKind kind, const duckdb::string &path,
+                                                       const duckdb::string &content) {
+    References result;
+    switch (kind) {
+    case FileKind::ICEBERG_METADATA: {
+        // Only the current snapshot is read by scans. Other objects (refs, statistics) name snapshots too, so the
+        // snapshot is looked up in the objects of the snapshots array only.
+        const duckdb::string CURRENT_SNAPSHOT_ID = "current-snapshot-id";
+        const duckdb::string SNAPSHOTS = "snapshots";
+        const duckdb::string SNAPSHOT_ID = "snapshot-id";
+        const duckdb::string MANIFEST_LIST = "manifest-list";
+        const auto current_pos = FindJsonKey(content, CURRENT_SNAPSHOT_ID);
+        const auto snapshots_pos = FindJsonKey(content, SNAPSHOTS);
+        if (current_pos == duckdb::string::npos || snapshots_pos == duckdb::string::npos) {
+            break;
+        }
+        const auto current_snapshot_id = FindJsonNumber(content, current_pos, CURRENT_SNAPSHOT_ID);
+        if (current_snapshot_id.empty() || current_snapshot_id[0] == '-') {
+            break;
+        }
+        const auto array_pos = FindJsonValue(content, snapshots_pos, SNAPSHOTS);
+        if (array_pos >= content.size() || content[array_pos] != '[') {
+            break;
+        }
+        const auto array_end = FindJsonEnd(content, array_pos);
+        if (array_end == duckdb::string::npos) {
+            break;
+        }
+        for (auto snapshot_pos = content.find('{', array_pos); snapshot_pos < array_end;) {
+            const auto snapshot_end = FindJsonEnd(content, snapshot_pos);
+            if (snapshot_end == duckdb::string::npos) {
+                break;
+            }
+            const auto id_pos = FindJsonKey(content, SNAPSHOT_ID, snapshot_pos);
+            if (id_pos < snapshot_end && FindJsonNumber(content, id_pos, SNAPSHOT_ID) == current_snapshot_id) {
+                const auto list_pos = FindJsonKey(content, MANIFEST_LIST, snapshot_pos);
+                duckdb::string manifest_list;
+                if (list_pos < snapshot_end &&
+                    ReadJsonString(content, FindJsonValue(content, list_pos, MANIFEST_LIST), manifest_list)) {
+                    result.metadata_files.push_back(ResolveReference(path, manifest_list, ""));
+                }
+                break;
+            }
+            snapshot_pos = content.find('{', snapshot_end);
+        }
+        break;
+    }
+    case FileKind::ICEBERG_MANIFEST_LIST:
+        for (auto &manifest : FindAvroStrings(ReadAvroData(content), {".avro"})) {
+            result.metadata_files.push_back(ResolveReference(path, manifest, ""));
+        }
+        break;
+    case FileKind::ICEBERG_MANIFEST:
+        for (auto &data_file : FindAvroStrings(ReadAvroData(content), {".parquet"})) {
+            result.data_files.push_back(ResolveReference(path, data_file, ""));
+        }
+        break;
+    case FileKind::DELTA_LOG: {
+        const duckdb::string ADD = "add";
+        const duckdb::string PATH = "path";
+        const auto table_location = path.substr(0, path.find(DELTA_LOG_DIRECTORY));
+        for (auto add_pos = FindJsonKey(content, ADD); add_pos != duckdb::string::npos;
+             add_pos = FindJsonKey(content, ADD, add_pos + 1)) {
+            // Each action is a line of its own
+            const auto line_end = content.find('\n', add_pos);
+            const auto path_pos = FindJsonKey(content, PATH, add_pos);
+            duckdb::string data_file;
+            if (path_pos == duckdb::string::npos || (line_end != duckdb::string::npos && path_pos > line_end) ||
+                !ReadJsonString(content, FindJsonValue(content, path_pos, PATH), data_file)) {
+                continue;
+            }
+            result.data_files.push_back(ResolveReference(path, DecodeUri(data_file), table_location));
+        }
+        break;
+    }
+    case FileKind::NONE:
+        break;
+    }
+    return result;
+}
+
+duckdb::string TableFormat::ReadAvroData(const duckdb::string &content) {
+    static const duckdb::string AVRO_MAGIC("Obj\x01", 4);
+    static constexpr idx_t SYNC_MARKER_SIZE = 16;
+    if (content.rfind(AVRO_MAGIC, 0) != 0) {
+        return duckdb::string();
+    }
+
+    // File metadata: a map of blocks of entries, a negative count is followed by the size of the block
+    idx_t pos = AVRO_MAGIC.size();
+    duckdb::string codec = "null";
+    while (true) {
+        int64_t count = 0;
+        if (!ReadAvroLong(content, pos, count)) {
+            return duckdb::string();
+        }
+        if (count == 0) {
+            break;
+        }
+        if (count < 0) {
+            int64_t block_size = 0;
+            if (!ReadAvroLong(content, pos, block_size)) {
+                return duckdb::string();
+            }
+            count = -count;
+        }
+        for (int64_t i = 0; i < count; ++i) {
+            duckdb::string key;
+            duckdb::string value;
+            if (!ReadAvroBytes(content, pos, key) || !ReadAvroBytes(content, pos, value)) {
+                return duckdb::string();
+            }
+            if (key == "avro.codec") {
+                codec = value;
+            }
+        }
+    }
+    pos += SYNC_MARKER_SIZE;
+
+    // Data blocks: object count, size, the (compressed) objects and the sync marker
+    duckdb::string result;
+    while (pos < content.size()) {
+        int64_t object_count = 0;
+        duckdb::string block;
+        if (!ReadAvroLong(content, pos, object_count) || !ReadAvroBytes(content, pos, block)) {
+            break;
+        }
+        pos += SYNC_MARKER_SIZE;
+        if (codec == "null") {
+            result += block;
+        } else if (codec == "deflate") {
+            size_t inflated_size = 0;
+            auto inflated = duckdb_miniz::tinfl_decompress_mem_to_heap(block.data(), block.size(), &inflated_size, 0);
+            if (inflated) {
+                result.append(static_cast<const char *>(inflated), inflated_size);
+                duckdb_miniz::mz_free(inflated);
+            }
+        }
+        // Blocks of other codecs aren't scanned
+    }
+    return result;
+}
+
+duckdb::vector<duckdb::string> TableFormat::FindAvroStrings(const duckdb::string &data,
+                                                            const duckdb::vector<duckdb::string> &suffixes) {
+    static constexpr int64_t MIN_LENGTH = 8;
+    static constexpr int64_t MAX_LENGTH = 4096;
+
+    duckdb::vector<duckdb::string> result;
+    duckdb::unordered_set<duckdb::string> found;
+    for (idx_t pos = 0; pos < data.size(); ++pos) {
+        // Every position may hold the length of a string, check whether a path ends where the string would end
+        idx_t start = pos;
+        int64_t length = 0;
+        if (!ReadAvroLong(data, start, length) || length < MIN_LENGTH || length > MAX_LENGTH ||
+            start + length > data.size()) {
+            continue;
+        }
+        const auto end = start + length;
+        const bool has_suffix = std::any_of(suffixes.begin(), suffixes.end(), [&](const duckdb::string &suffix) {
+            return static_cast<idx_t>(length) >= suffix.size() && data.compare(end - suffix.size(), suffix.size(), suffix) == 0;
+        });
+        if (!has_suffix) {
+            continue;
+        }
+        auto candidate = data.substr(start, length);
+        const bool printable = std::all_of(candidate.begin(), candidate.end(), [](char c) { return c >= 0x20 && c < 0x7F; });
+        if (!printable || (candidate.find("://") == duckdb::string::npos && candidate[0] != '/')) {
+            continue;
+        }
+        if (found.insert(candidate).second) {
+            result.push_back(std::move(candidate));
+        }
+        pos = end - 1;
+    }
+    return result;
+}
+
+}  // namespace quackstore
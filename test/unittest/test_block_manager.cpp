@@ -3,12 +3,13 @@
 #include <duckdb/common/file_opener.hpp>
 
 #include "block_manager.hpp"
+#include "segment_table.hpp"
 
 using namespace quackstore;
 
 TEST_CASE("BlockCacheDataFileHeader size", "[BlockManager]")
 {
-    CHECK(BlockCacheDataFileHeader::Size() == 44);
+    CHECK(BlockCacheDataFileHeader::Size() == 72);
 }
 
 TEST_CASE("Make sure block manager uses the correct path (CreateNewDatabase)", "[BlockManager]") 
@@ -333,4 +334,132 @@ TEST_CASE("FreeList should be correctly deallocated before serialization", "[Blo
     CHECK(block_mgr.GetFreeList().size() == NUM_INITIAL_BLOCKS - NUM_BLOCKS_FOR_FINAL_FREE_LIST);
     CHECK(*block_mgr.GetFreeList().begin() == NUM_BLOCKS_FOR_FINAL_FREE_LIST);
     CHECK(*block_mgr.GetFreeList().rbegin() == NUM_INITIAL_BLOCKS - 1);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Shared blocks are freed only after the last owner releases them", "[BlockManager]") {
+    auto storage_file_path = "/tmp/cache.bin";
+
+    auto block_mgr = BlockManager{{Kilobytes(1)}};
+    block_mgr.CreateNewDatabase(storage_file_path);
+
+    auto shared_id = block_mgr.AllocBlock();
+    auto exclusive_id = block_mgr.AllocBlock();
+    CHECK(block_mgr.GetBlockRefCount(shared_id) == 1);
+
+    block_mgr.AddBlockRef(shared_id);
+    block_mgr.AddBlockRef(shared_id);
+    CHECK(block_mgr.GetBlockRefCount(shared_id) == 3);
+    CHECK(block_mgr.GetBlockRefCount(exclusive_id) == 1);
+
+    CHECK_FALSE(block_mgr.ReleaseBlockRef(shared_id));
+    CHECK_FALSE(block_mgr.ReleaseBlockRef(shared_id));
+    CHECK(block_mgr.GetFreeList().empty());
+
+    CHECK(block_mgr.ReleaseBlockRef(shared_id));
+    CHECK(block_mgr.ReleaseBlockRef(exclusive_id));
+    CHECK(block_mgr.GetFreeList() == duckdb::set<block_id_t>{shared_id, exclusive_id});
+}
+
+TEST_CASE("Extents are allocated from contiguous free blocks and freed as a whole", "[BlockManager]") {
+    auto storage_file_path = "/tmp/cache.bin";
+
+    auto block_mgr = BlockManager{{Kilobytes(1)}};
+    block_mgr.CreateNewDatabase(storage_file_path);
+
+    // Blocks: [0] [1 .. 4] [5]
+    auto single_id = block_mgr.AllocBlock();
+    auto extent_id = block_mgr.AllocBlocks(4);
+    auto last_id = block_mgr.AllocBlock();
+    CHECK(extent_id == single_id + 1);
+    CHECK(last_id == extent_id + 4);
+    CHECK(block_mgr.GetExtentBlockCount(extent_id) == 4);
+    CHECK(block_mgr.GetExtentBlockCount(single_id) == 1);
+
+    // The whole extent is addressable by its first block
+    duckdb::vector<uint8_t> data(Kilobytes(3), 'e');
+    block_mgr.StoreBlockRange(extent_id, Kilobytes(1), data.data(), data.size());
+    REQUIRE_THROWS_AS(block_mgr.StoreBlockRange(single_id, 0, data.data(), data.size()), duckdb::InvalidInputException);
+
+    block_mgr.MarkBlockAsFree(extent_id);
+    CHECK(block_mgr.GetFreeList().size() == 4);
+    CHECK(block_mgr.GetExtentBlockCount(extent_id) == 1);
+
+    // A smaller extent reuses the freed run, a larger one doesn't fit and goes to the end of the storage
+    CHECK(block_mgr.AllocBlocks(3) == extent_id);
+    CHECK(block_mgr.AllocBlocks(2) == last_id + 1);
+    CHECK(block_mgr.GetFreeList() == duckdb::set<block_id_t>{extent_id + 3});
+}
+
+TEST_CASE("Segment table appends rewritten blocks and finds sparse segments", "[BlockManager]") {
+    SegmentTable table(4);
+
+    // Segments: [0 1 2 3] [4 5 ...]
+    for (block_id_t block_id = 0; block_id < 6; ++block_id) {
+        CHECK(table.Place(block_id, 1) == uint64_t(block_id));
+    }
+    CHECK(table.GetSegmentCount() == 2);
+
+    // Rewriting moves the block to the head, leaving a dead slot in the first segment
+    CHECK(table.Place(1, 1) == 6);
+    CHECK(table.Place(2, 1) == 7);
+    CHECK(table.Place(3, 1) == 8);
+    CHECK(table.GetSegmentCount() == 3);
+    CHECK(table.GetLiveSlots(0) == 1);
+
+    uint64_t segment = 0;
+    REQUIRE(table.FindSparseSegment(50, BlockManager::INVALID_BLOCK_ID, segment));
+    CHECK(segment == 0);
+    CHECK(table.GetSegmentBlocks(0) == duckdb::vector<block_id_t>{0});
+    CHECK_FALSE(table.FindSparseSegment(50, 0, segment));
+
+    // Once its last block moves and the table is written, the segment is reused before the storage grows
+    table.Place(0, 1);
+    table.Place(4, 1);
+    table.Place(5, 1);
+    CHECK(table.GetFreeSegmentCount() == 0);
+    table.ReleasePendingSegments();
+    CHECK(table.GetFreeSegmentCount() == 1);
+    CHECK(table.Place(6, 2) == 0);
+    CHECK(table.GetSegmentCount() == 3);
+
+    // Blocks longer than a segment get segments of their own at the end
+    CHECK(table.Place(7, 6) == 12);
+    CHECK(table.GetSegmentCount() == 5);
+}
+
+TEST_CASE("Segmented storage keeps blocks across rewrites and reloads", "[BlockManager]") {
+    auto storage_file_path = "/tmp/cache.bin";
+
+    auto block_mgr = BlockManager{{Kilobytes(1), StorageLayout::SEGMENTED}};
+    block_mgr.CreateNewDatabase(storage_file_path);
+    CHECK(block_mgr.GetLayout() == StorageLayout::SEGMENTED);
+
+    auto first_id = block_mgr.AllocBlock();
+    auto second_id = block_mgr.AllocBlock();
+    block_mgr.StoreBlock(first_id, duckdb::vector<uint8_t>(Kilobytes(1), 'a'));
+    block_mgr.StoreBlock(second_id, duckdb::vector<uint8_t>(Kilobytes(1), 'b'));
+
+    SegmentTable::Location first_location;
+    REQUIRE(block_mgr.GetSegmentTable().TryGetLocation(first_id, first_location));
+    block_mgr.StoreBlock(first_id, duckdb::vector<uint8_t>(Kilobytes(1), 'c'));
+    SegmentTable::Location rewritten_location;
+    REQUIRE(block_mgr.GetSegmentTable().TryGetLocation(first_id, rewritten_location));
+    CHECK(rewritten_location.slot > first_location.slot);
+
+    block_mgr.Flush();
+    block_mgr.Close();
+
+    auto loaded_mgr = BlockManager{{Kilobytes(1)}};
+    loaded_mgr.LoadExistingDatabase(storage_file_path);
+    CHECK(loaded_mgr.GetLayout() == StorageLayout::SEGMENTED);
+
+    duckdb::vector<uint8_t> data(Kilobytes(1));
+    loaded_mgr.RetrieveBlock(first_id, data);
+    CHECK(data == duckdb::vector<uint8_t>(Kilobytes(1), 'c'));
+    loaded_mgr.RetrieveBlock(second_id, data);
+    CHECK(data == duckdb::vector<uint8_t>(Kilobytes(1), 'b'));
+
+    // Blocks are placed by writes only
+    auto unwritten_id = loaded_mgr.AllocBlock();
+    CHECK_THROWS_AS(loaded_mgr.RetrieveBlock(unwritten_id, data), duckdb::IOException);
+}
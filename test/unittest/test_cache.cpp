@@ -1,10 +1,23 @@
 #include <catch/catch.hpp>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <duckdb.hpp>
 #include <duckdb/common/file_opener.hpp>
 #include <random>
+#include <thread>
 
 #include "cache.hpp"
+#include "cache_bundle.hpp"
+#include "cache_registry.hpp"
+#include "file_lock.hpp"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 using namespace quackstore;
 
@@ -181,6 +194,23 @@ public:
     bool simulate_crash = false;
 };
 
+// Class to simulate a full volume: the next stores fail with ENOSPC
+class FullVolumeBlockManager : public quackstore::BlockManager {
+public:
+    using BlockManager::BlockManager;
+
+    void StoreBlock(block_id_t block_id, const duckdb::vector<uint8_t>& data) override {
+        if (failing_stores > 0) {
+            --failing_stores;
+            throw duckdb::IOException("Could not write file \"%s\": %s", {{"errno", std::to_string(ENOSPC)}},
+                                      "/tmp/cache.bin", std::strerror(ENOSPC));
+        }
+        BlockManager::StoreBlock(block_id, data);
+    }
+
+    idx_t failing_stores = 0;
+};
+
 duckdb::vector<uint8_t> InitializeRandomData(size_t size) {
     std::random_device rd;                               // Initialize a random device
     std::mt19937 gen(rd());                              // Seed the generator
@@ -288,3 +318,985 @@ TEST_CASE("Metadata should be correctly deallocated before serialization", "[Cac
         REQUIRE(block_mgr_ref.GetFreeList().empty());
     }
 }
+
+TEST_CASE("Blocks with identical content are stored once when deduplication is enabled", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto block_mgr_ptr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{BLOCK_SIZE});
+    auto& block_mgr_ref = *block_mgr_ptr;
+
+    auto cache = Cache{BLOCK_SIZE, std::move(block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+    cache.Open(storage_file_path);
+    cache.SetMaxCacheSize(Megabytes(1));
+    cache.SetDeduplicationEnabled(true);
+
+    const auto shared_data = InitializeRandomData(BLOCK_SIZE);
+    const auto unique_data = InitializeRandomData(BLOCK_SIZE);
+
+    auto data = shared_data;
+    cache.StoreBlock("s3://bucket/a.parquet", 0, data);
+    data = shared_data;
+    cache.StoreBlock("s3://bucket/snapshot/a.parquet", 0, data);
+    data = unique_data;
+    cache.StoreBlock("s3://bucket/b.parquet", 0, data);
+    REQUIRE(block_mgr_ref.GetMaxBlock() == 2);
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    REQUIRE(cache.RetrieveBlock("s3://bucket/snapshot/a.parquet", 0, retrieved));
+    CHECK(retrieved == shared_data);
+
+    SECTION("Evicting one owner keeps the content for the other") {
+        cache.Evict("s3://bucket/a.parquet");
+        CHECK(block_mgr_ref.GetFreeList().empty());
+        REQUIRE(cache.RetrieveBlock("s3://bucket/snapshot/a.parquet", 0, retrieved));
+        CHECK(retrieved == shared_data);
+
+        cache.Evict("s3://bucket/snapshot/a.parquet");
+        CHECK(block_mgr_ref.GetFreeList().size() == 1);
+    }
+
+    SECTION("Shared blocks survive a reload") {
+        cache.Close();
+
+        auto reloaded_block_mgr_ptr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{BLOCK_SIZE});
+        auto& reloaded_block_mgr_ref = *reloaded_block_mgr_ptr;
+        auto reloaded = Cache{BLOCK_SIZE, std::move(reloaded_block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+        reloaded.Open(storage_file_path);
+
+        block_id_t shared_block_id = BlockManager::INVALID_BLOCK_ID;
+        MetadataManager::FileMetadata md;
+        REQUIRE(reloaded.RetrieveFileMetadata("s3://bucket/a.parquet", md));
+        shared_block_id = md.blocks.begin()->first;
+        CHECK(reloaded_block_mgr_ref.GetBlockRefCount(shared_block_id) == 2);
+    }
+
+    SECTION("Rewriting a shared block detaches it") {
+        data = unique_data;
+        cache.StoreBlock("s3://bucket/a.parquet", 0, data);
+
+        REQUIRE(cache.RetrieveBlock("s3://bucket/snapshot/a.parquet", 0, retrieved));
+        CHECK(retrieved == shared_data);
+    }
+}
+
+TEST_CASE("Small tail blocks are packed into shared slab blocks", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto block_mgr_ptr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{BLOCK_SIZE});
+    auto& block_mgr_ref = *block_mgr_ptr;
+
+    auto cache = Cache{BLOCK_SIZE, std::move(block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+    cache.Open(storage_file_path);
+    cache.SetMaxCacheSize(Megabytes(1));
+    cache.SetPackThreshold(Bytes(300));
+
+    // Three 280 byte files fit into a single slab block, the fourth one starts a new slab block
+    duckdb::vector<duckdb::vector<uint8_t>> contents;
+    for (int i = 0; i < 4; ++i) {
+        contents.push_back(InitializeRandomData(280));
+        auto data = contents.back();
+        cache.StoreBlock("https://host/manifest_" + std::to_string(i) + ".json", 0, data);
+    }
+    REQUIRE(block_mgr_ref.GetMaxBlock() == 2);
+
+    // Blocks at or above the threshold are stored on their own
+    auto large_tail = InitializeRandomData(600);
+    cache.StoreBlock("https://host/data.csv", 3, large_tail);
+    REQUIRE(block_mgr_ref.GetMaxBlock() == 3);
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    for (int i = 0; i < 4; ++i) {
+        INFO("Packed file #" << i);
+        REQUIRE(cache.RetrieveBlock("https://host/manifest_" + std::to_string(i) + ".json", 0, retrieved));
+        CHECK(std::equal(contents[i].begin(), contents[i].end(), retrieved.begin()));
+    }
+
+    SECTION("Evicting a packed file keeps the rest of the slab") {
+        cache.Evict("https://host/manifest_0.json");
+        cache.Evict("https://host/manifest_1.json");
+        CHECK(block_mgr_ref.GetFreeList().empty());
+        REQUIRE(cache.RetrieveBlock("https://host/manifest_2.json", 0, retrieved));
+        CHECK(std::equal(contents[2].begin(), contents[2].end(), retrieved.begin()));
+
+        // Slab block is freed once its last packed block is gone
+        cache.Evict("https://host/manifest_2.json");
+        CHECK(block_mgr_ref.GetFreeList().size() == 1);
+    }
+
+    SECTION("Packed locations survive a reload") {
+        cache.Close();
+
+        auto reloaded = Cache{BLOCK_SIZE};
+        reloaded.Open(storage_file_path);
+        for (int i = 0; i < 4; ++i) {
+            INFO("Packed file #" << i);
+            REQUIRE(reloaded.RetrieveBlock("https://host/manifest_" + std::to_string(i) + ".json", 0, retrieved));
+            CHECK(std::equal(contents[i].begin(), contents[i].end(), retrieved.begin()));
+        }
+    }
+}
+
+TEST_CASE("Tail blocks store only their valid bytes and are counted by length", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto cache = Cache{BLOCK_SIZE};
+    cache.Open(storage_file_path);
+    cache.SetPackThreshold(0); // Store each tail block on its own
+    cache.SetMaxCacheSize(BLOCK_SIZE + Bytes(400));
+
+    auto full_block = InitializeRandomData(BLOCK_SIZE);
+    auto first_tail = InitializeRandomData(200);
+    auto second_tail = InitializeRandomData(200);
+    cache.StoreBlock("https://host/a.csv", 0, full_block);
+    cache.StoreBlock("https://host/a.csv", 1, first_tail);
+    cache.StoreBlock("https://host/b.csv", 0, second_tail);
+
+    // Three blocks fit, as the tail blocks take only 400 bytes together
+    CHECK(cache.GetCachedBytes() == BLOCK_SIZE + 400);
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    REQUIRE(cache.RetrieveBlock("https://host/a.csv", 1, retrieved));
+    CHECK(retrieved == first_tail);
+    REQUIRE(cache.RetrieveBlock("https://host/b.csv", 0, retrieved));
+    CHECK(retrieved == second_tail);
+    REQUIRE(cache.RetrieveBlock("https://host/a.csv", 0, retrieved));
+    CHECK(retrieved == full_block);
+
+    SECTION("Lengths survive a reload") {
+        cache.Close();
+
+        auto reloaded = Cache{BLOCK_SIZE};
+        reloaded.Open(storage_file_path);
+        CHECK(reloaded.GetCachedBytes() == BLOCK_SIZE + 400);
+        REQUIRE(reloaded.RetrieveBlock("https://host/a.csv", 1, retrieved));
+        CHECK(retrieved == first_tail);
+    }
+
+    SECTION("Exceeding the size by a few bytes evicts the least recently used block") {
+        auto third_tail = InitializeRandomData(10);
+        cache.StoreBlock("https://host/c.csv", 0, third_tail);
+
+        CHECK(cache.GetCachedBytes() == BLOCK_SIZE + 210);
+        CHECK_FALSE(cache.RetrieveBlock("https://host/a.csv", 1, retrieved));
+        REQUIRE(cache.RetrieveBlock("https://host/c.csv", 0, retrieved));
+        CHECK(retrieved == third_tail);
+    }
+}
+
+TEST_CASE("Cache blocks are migrated when the block size changes", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto FILE_SIZE = Bytes(3000);
+    auto content = InitializeRandomData(FILE_SIZE);
+    const auto Slice = [&](uint64_t begin, uint64_t end) {
+        return duckdb::vector<uint8_t>(content.begin() + begin, content.begin() + end);
+    };
+
+    // Write the cache with 1KB blocks: all blocks of one file and only the middle block of another one
+    {
+        auto cache = Cache{Kilobytes(1)};
+        cache.Open(storage_file_path);
+        cache.SetPackThreshold(0);
+        cache.StoreFileSize("https://host/full.bin", FILE_SIZE);
+        cache.StoreFileSize("https://host/partial.bin", FILE_SIZE);
+        for (int64_t i = 0; i < 3; ++i) {
+            auto data = Slice(i * Kilobytes(1), std::min<uint64_t>((i + 1) * Kilobytes(1), FILE_SIZE));
+            cache.StoreBlock("https://host/full.bin", i, data);
+        }
+        auto middle = Slice(Kilobytes(1), Kilobytes(2));
+        cache.StoreBlock("https://host/partial.bin", 1, middle);
+    }
+
+    // Without a block size set, the cache file keeps the block size it was written with
+    {
+        auto cache = Cache{Kilobytes(2)};
+        cache.Open(storage_file_path);
+        CHECK(cache.GetBlockSize() == Kilobytes(1));
+    }
+
+    auto cache = Cache{Kilobytes(2)};
+    cache.SetBlockSize(Kilobytes(2));
+    cache.Open(storage_file_path);
+
+    duckdb::vector<uint8_t> retrieved(Kilobytes(2));
+    REQUIRE(cache.GetBlockSize() == Kilobytes(2));
+    REQUIRE(cache.RetrieveBlock("https://host/full.bin", 0, retrieved));
+    CHECK(retrieved == Slice(0, Kilobytes(2)));
+    REQUIRE(cache.RetrieveBlock("https://host/full.bin", 1, retrieved));
+    CHECK(retrieved == Slice(Kilobytes(2), FILE_SIZE));
+
+    // New blocks made of partially cached old blocks are dropped, the file metadata is kept
+    CHECK_FALSE(cache.RetrieveBlock("https://host/partial.bin", 0, retrieved));
+    CHECK_FALSE(cache.RetrieveBlock("https://host/partial.bin", 1, retrieved));
+    MetadataManager::FileMetadata md;
+    REQUIRE(cache.RetrieveFileMetadata("https://host/partial.bin", md));
+    CHECK(md.file_size == FILE_SIZE);
+
+    SECTION("Block size of an open cache can be changed") {
+        cache.SetBlockSize(Bytes(512));
+        REQUIRE(cache.IsOpen());
+        REQUIRE(cache.GetBlockSize() == Bytes(512));
+
+        retrieved.resize(Bytes(512));
+        REQUIRE(cache.RetrieveBlock("https://host/full.bin", 5, retrieved));
+        CHECK(retrieved == Slice(5 * Bytes(512), FILE_SIZE));
+    }
+
+    SECTION("Block size must be a power of two") {
+        REQUIRE_THROWS_AS(cache.SetBlockSize(Bytes(1000)), duckdb::InvalidInputException);
+        CHECK(cache.GetBlockSize() == Kilobytes(2));
+    }
+}
+
+TEST_CASE("Data spanning several blocks is stored as an extent", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto block_mgr_ptr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{BLOCK_SIZE});
+    auto& block_mgr_ref = *block_mgr_ptr;
+    auto cache = Cache{BLOCK_SIZE, std::move(block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+    cache.Open(storage_file_path);
+
+    // A single block followed by a streamed region of 3.5 blocks: [0] [4 .. 7]
+    auto single = InitializeRandomData(BLOCK_SIZE);
+    auto extent = InitializeRandomData(3 * BLOCK_SIZE + 512);
+    cache.StoreBlock("https://host/data.parquet", 0, single);
+    cache.StoreBlock("https://host/data.parquet", 4, extent);
+    CHECK(cache.GetCachedBytes() == BLOCK_SIZE + extent.size());
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    int64_t start_index = -1;
+    for (int64_t block_index : {4, 5, 7}) {
+        INFO("Block index " << block_index);
+        REQUIRE(cache.RetrieveCoveringBlock("https://host/data.parquet", block_index, start_index, retrieved));
+        CHECK(start_index == 4);
+        CHECK(retrieved == extent);
+    }
+    REQUIRE(cache.RetrieveCoveringBlock("https://host/data.parquet", 0, start_index, retrieved));
+    CHECK(start_index == 0);
+    CHECK_FALSE(cache.RetrieveCoveringBlock("https://host/data.parquet", 1, start_index, retrieved));
+    CHECK_FALSE(cache.RetrieveCoveringBlock("https://host/data.parquet", 8, start_index, retrieved));
+    CHECK(cache.IsBlockCached("https://host/data.parquet", 0));
+    CHECK(cache.IsBlockCached("https://host/data.parquet", 6));
+    CHECK_FALSE(cache.IsBlockCached("https://host/data.parquet", 2));
+
+    SECTION("Extents must start at an aligned block index") {
+        auto misaligned = InitializeRandomData(2 * BLOCK_SIZE);
+        REQUIRE_THROWS_AS(cache.StoreBlock("https://host/data.parquet", 1, misaligned), duckdb::InvalidInputException);
+    }
+
+    SECTION("Evicting the file frees all blocks of the extent") {
+        cache.Evict("https://host/data.parquet");
+        CHECK(block_mgr_ref.GetFreeList().size() == 5);
+        CHECK(cache.GetCachedBytes() == 0);
+    }
+
+    SECTION("Extents survive a reload") {
+        cache.Close();
+
+        auto reloaded_block_mgr_ptr = duckdb::make_uniq<BlockManager>(BlockManagerOptions{BLOCK_SIZE});
+        auto& reloaded_block_mgr_ref = *reloaded_block_mgr_ptr;
+        auto reloaded = Cache{BLOCK_SIZE, std::move(reloaded_block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+        reloaded.Open(storage_file_path);
+        REQUIRE(reloaded.RetrieveCoveringBlock("https://host/data.parquet", 6, start_index, retrieved));
+        CHECK(retrieved == extent);
+
+        const auto free_blocks_before = reloaded_block_mgr_ref.GetFreeList().size();
+        reloaded.Evict("https://host/data.parquet");
+        CHECK(reloaded_block_mgr_ref.GetFreeList().size() == free_blocks_before + 5);
+    }
+}
+
+TEST_CASE("Caches sharing one file see each other's changes", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    // Each cache stands for another process using the same cache file
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto first = Cache{BLOCK_SIZE};
+    first.SetSharedAccessEnabled(true);
+    first.Open(storage_file_path);
+    auto second = Cache{BLOCK_SIZE};
+    second.SetSharedAccessEnabled(true);
+    second.Open(storage_file_path);
+    REQUIRE(local_fs->FileExists(storage_file_path + ".lock"));
+
+    auto first_data = InitializeRandomData(BLOCK_SIZE);
+    first.StoreFileSize("https://host/first.bin", BLOCK_SIZE);
+    // Stores are published right away
+    first.StoreBlock("https://host/first.bin", 0, first_data);
+
+    // Stored by the other cache, no second download needed
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    REQUIRE(second.RetrieveBlock("https://host/first.bin", 0, retrieved));
+    CHECK(retrieved == first_data);
+
+    // Blocks are allocated from the shared state, so they don't overwrite each other
+    auto second_data = InitializeRandomData(BLOCK_SIZE);
+    second.StoreBlock("https://host/second.bin", 0, second_data);
+    auto third_data = InitializeRandomData(BLOCK_SIZE);
+    first.StoreBlock("https://host/third.bin", 0, third_data);
+    REQUIRE(second.RetrieveBlock("https://host/third.bin", 0, retrieved));
+    CHECK(retrieved == third_data);
+    REQUIRE(first.RetrieveBlock("https://host/second.bin", 0, retrieved));
+    CHECK(retrieved == second_data);
+    REQUIRE(first.RetrieveBlock("https://host/first.bin", 0, retrieved));
+    CHECK(retrieved == first_data);
+
+    SECTION("Evictions are shared as well") {
+        // Published right away, the file is gone along with its blocks
+        second.Evict("https://host/first.bin");
+        MetadataManager::FileMetadata md;
+        CHECK_FALSE(first.RetrieveFileMetadata("https://host/first.bin", md));
+        CHECK_FALSE(first.RetrieveBlock("https://host/first.bin", 0, retrieved));
+    }
+
+    SECTION("Closing one cache keeps the changes of the other one") {
+        second.Close();
+        first.Close();
+
+        auto reopened = Cache{BLOCK_SIZE};
+        reopened.Open(storage_file_path);
+        CHECK(reopened.RetrieveBlock("https://host/first.bin", 0, retrieved));
+        CHECK(reopened.RetrieveBlock("https://host/second.bin", 0, retrieved));
+    }
+}
+
+TEST_CASE("File locks exclude other processes and other locks of the process", "[Cache]") {
+    const duckdb::string lock_path = "/tmp/cache.bin.lock";
+    FileLock lock{lock_path};
+    lock.Lock(FileLock::Mode::EXCLUSIVE);
+
+    SECTION("Another lock of the process waits") {
+        std::atomic<bool> locked{false};
+        std::thread other([&]() {
+            FileLock other_lock{lock_path};
+            other_lock.Lock(FileLock::Mode::SHARED);
+            locked = true;
+            other_lock.Unlock();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK_FALSE(locked);
+        lock.Unlock();
+        other.join();
+        CHECK(locked);
+    }
+
+#ifndef _WIN32
+    SECTION("Another process waits") {
+        const auto pid = fork();
+        REQUIRE(pid >= 0);
+        if (pid == 0) {
+            FileLock child_lock{lock_path};
+            child_lock.Lock(FileLock::Mode::EXCLUSIVE);
+            _exit(0);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        int status = 0;
+        CHECK(waitpid(pid, &status, WNOHANG) == 0);
+        lock.Unlock();
+        REQUIRE(waitpid(pid, &status, 0) == pid);
+        CHECK(WIFEXITED(status));
+        CHECK(WEXITSTATUS(status) == 0);
+    }
+#endif
+}
+
+TEST_CASE("Database instances opening the same cache path share one cache", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    // Each cache stands for the cache of another database instance in this process
+    const auto BLOCK_SIZE = Kilobytes(1);
+    CacheRegistry registry;
+    auto first = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+    first.Open(storage_file_path);
+    auto second = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+    // Another spelling of the same path resolves to the same cache
+    second.Open("/tmp/./cache.bin");
+    CHECK(registry.GetCacheCount() == 1);
+    CHECK(CacheRegistry::CanonicalPath("/tmp/./cache.bin") == CacheRegistry::CanonicalPath(storage_file_path));
+
+    auto data = InitializeRandomData(BLOCK_SIZE);
+    first.StoreBlock("https://host/file.bin", 0, data);
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    REQUIRE(second.RetrieveBlock("https://host/file.bin", 0, retrieved));
+    CHECK(retrieved == data);
+    CHECK(first.GetCachedBytes() == BLOCK_SIZE);
+    CHECK(second.GetCachedBytes() == BLOCK_SIZE);
+
+    SECTION("Deduplication stays a setting of each instance") {
+        second.SetDeduplicationEnabled(true);
+        auto copy = data;
+        first.StoreBlock("https://host/first_copy.bin", 0, copy);
+        CHECK(first.GetCachedBytes() == 2 * BLOCK_SIZE);
+        second.StoreBlock("https://host/second_copy.bin", 0, copy);
+        CHECK(second.GetCachedBytes() == 2 * BLOCK_SIZE);
+    }
+
+    SECTION("The storage settings of the instances are merged") {
+        auto other_data = InitializeRandomData(BLOCK_SIZE);
+        first.StoreBlock("https://host/other.bin", 0, other_data);
+
+        // The largest max cache size, no instance gets less than it asked for
+        first.SetMaxCacheSize(BLOCK_SIZE);
+        CHECK(first.GetCachedBytes() == 2 * BLOCK_SIZE);
+        second.SetMaxCacheSize(4 * BLOCK_SIZE);
+        CHECK(first.GetMaxCacheSize() == 4 * BLOCK_SIZE);
+        first.SetMaxCacheSize(BLOCK_SIZE);
+        CHECK(second.GetCachedBytes() == 2 * BLOCK_SIZE);
+
+        // The quotas of the prefixes all instances limit
+        MetadataManager::Quota quota;
+        quota.prefix = "https://host/";
+        quota.max_bytes = BLOCK_SIZE;
+        first.SetQuotas({quota});
+        CHECK(second.GetGroupUsage().size() == 1);
+        quota.max_bytes = 3 * BLOCK_SIZE;
+        second.SetQuotas({quota});
+        REQUIRE(first.GetGroupUsage().size() == 2);
+        CHECK(first.GetGroupUsage()[0].limit == 3 * BLOCK_SIZE);
+
+        // Background eviction if any instance enables it
+        first.SetBackgroundEviction(true, 50, 90);
+        CHECK(second.IsBackgroundEvictionEnabled());
+        first.SetBackgroundEviction(false, 50, 90);
+        CHECK_FALSE(second.IsBackgroundEvictionEnabled());
+
+        // The settings of a closed instance no longer count
+        second.Close();
+        CHECK(first.GetMaxCacheSize() == BLOCK_SIZE);
+        CHECK(first.GetCachedBytes() == BLOCK_SIZE);
+        CHECK(first.GetGroupUsage()[0].limit == BLOCK_SIZE);
+    }
+
+    SECTION("The block size of the instance opening the cache last applies to it") {
+        auto third = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+        third.SetBlockSize(2 * BLOCK_SIZE);
+        third.Open(storage_file_path);
+        CHECK(registry.GetCacheCount() == 1);
+        CHECK(first.GetBlockSize() == 2 * BLOCK_SIZE);
+
+        // Released under the canonical path, whichever spelling it was opened with
+        third.Close();
+        second.Close();
+        first.Close();
+        CHECK(registry.GetCacheCount() == 0);
+    }
+
+    SECTION("The cache stays open until its last instance closes it") {
+        first.Close();
+        CHECK_FALSE(first.IsOpen());
+        CHECK(registry.GetCacheCount() == 1);
+        REQUIRE(second.RetrieveBlock("https://host/file.bin", 0, retrieved));
+
+        second.Close();
+        CHECK(registry.GetCacheCount() == 0);
+
+        auto reopened = Cache{BLOCK_SIZE};
+        reopened.Open(storage_file_path);
+        CHECK(reopened.RetrieveBlock("https://host/file.bin", 0, retrieved));
+    }
+
+    SECTION("Queries of one instance don't keep the other one from closing") {
+        first.AddRef();
+        CHECK_THROWS_AS(first.Close(), duckdb::IOException);
+        second.Close();
+        first.RemoveRef();
+        first.Close();
+        CHECK(registry.GetCacheCount() == 0);
+    }
+}
+
+TEST_CASE("File handles finish against the cache epoch they were opened in", "[Cache]") {
+    duckdb::string first_file_path = "/tmp/cache.bin";
+    duckdb::string second_file_path = "/tmp/cache_1.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    for (const auto &path : {first_file_path, second_file_path}) {
+        if (local_fs->FileExists(path)) {
+            local_fs->RemoveFile(path);
+        }
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    CacheRegistry registry;
+    auto cache = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+    cache.Open(first_file_path);
+    auto data = InitializeRandomData(BLOCK_SIZE);
+    cache.StoreBlock("https://host/file.bin", 0, data);
+
+    // What a file handle does while it's open
+    auto pinned = cache.PinEpoch();
+    REQUIRE(pinned);
+    CHECK(cache.PinEpoch() == pinned);
+    pinned->AddRef();
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    SECTION("Clearing takes effect for the handles in flight") {
+        REQUIRE_NOTHROW(cache.Clear());
+        CHECK(pinned->IsOpen());
+        CHECK_FALSE(pinned->RetrieveBlock("https://host/file.bin", 0, retrieved));
+        pinned->StoreBlock("https://host/file.bin", 0, data);
+        CHECK(cache.RetrieveBlock("https://host/file.bin", 0, retrieved));
+        pinned->RemoveRef();
+    }
+
+    SECTION("Handles keep the layout of the shared cache") {
+        pinned->RemoveRef();
+        auto segmented = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+        segmented.SetStorageLayout(StorageLayout::SEGMENTED);
+        segmented.Open(second_file_path);
+        REQUIRE(segmented.PinEpoch());
+        auto other = Cache{BLOCK_SIZE, nullptr, nullptr, &registry};
+        other.Open(second_file_path);
+        CHECK(segmented.GetStorageLayout() == StorageLayout::SEGMENTED);
+
+        // The cache file created again after clearing keeps it too
+        segmented.Clear();
+        segmented.StoreBlock("https://host/file.bin", 0, data);
+        CHECK(other.GetStorageLayout() == StorageLayout::SEGMENTED);
+    }
+
+    SECTION("A path switch moves only new handles to the new cache") {
+        REQUIRE_NOTHROW(cache.Close());
+        cache.Open(second_file_path);
+        CHECK(registry.GetCacheCount() == 2);
+        CHECK(cache.PinEpoch() != pinned);
+        CHECK_FALSE(cache.RetrieveBlock("https://host/file.bin", 0, retrieved));
+        REQUIRE(pinned->RetrieveBlock("https://host/file.bin", 0, retrieved));
+        CHECK(retrieved == data);
+
+        // The old cache is closed with the last handle of its epoch
+        pinned->RemoveRef();
+        pinned.reset();
+        CHECK(registry.GetCacheCount() == 1);
+        auto reopened = Cache{BLOCK_SIZE};
+        reopened.Open(first_file_path);
+        CHECK(reopened.RetrieveBlock("https://host/file.bin", 0, retrieved));
+    }
+}
+
+TEST_CASE("A read-only cache serves blocks without writing to its file", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    // Build the warm cache image
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto first_data = InitializeRandomData(BLOCK_SIZE);
+    auto second_data = InitializeRandomData(BLOCK_SIZE / 2);
+    {
+        auto cache = Cache{BLOCK_SIZE};
+        cache.Open(storage_file_path);
+        cache.StoreFileSize("https://host/file.bin", BLOCK_SIZE + BLOCK_SIZE / 2);
+        cache.StoreBlock("https://host/file.bin", 0, first_data);
+        cache.StoreBlock("https://host/file.bin", 1, second_data);
+    }
+    const auto read_file = [&]() {
+        auto handle = local_fs->OpenFile(storage_file_path, duckdb::FileFlags::FILE_FLAGS_READ);
+        duckdb::vector<uint8_t> content(local_fs->GetFileSize(*handle));
+        handle->Read(content.data(), content.size(), 0);
+        return content;
+    };
+    const auto image = read_file();
+
+    // Opened with another block size, the file keeps its own
+    auto cache = Cache{Kilobytes(4)};
+    cache.SetReadOnly(true);
+    cache.Open(storage_file_path);
+    CHECK(cache.GetBlockSize() == BLOCK_SIZE);
+    CHECK_FALSE(local_fs->FileExists(storage_file_path + ".lock"));
+
+    duckdb::vector<uint8_t> retrieved(BLOCK_SIZE);
+    REQUIRE(cache.RetrieveBlock("https://host/file.bin", 0, retrieved));
+    CHECK(retrieved == first_data);
+
+    // Ranges are read independently of the block size
+    duckdb::vector<uint8_t> range(BLOCK_SIZE);
+    REQUIRE(cache.RetrieveRange("https://host/file.bin", BLOCK_SIZE / 2, BLOCK_SIZE, range.data()));
+    CHECK(std::equal(range.begin(), range.begin() + BLOCK_SIZE / 2, first_data.begin() + BLOCK_SIZE / 2));
+    CHECK(std::equal(range.begin() + BLOCK_SIZE / 2, range.end(), second_data.begin()));
+    CHECK_FALSE(cache.RetrieveRange("https://host/file.bin", BLOCK_SIZE, BLOCK_SIZE, range.data()));
+    CHECK_FALSE(cache.RetrieveRange("https://host/other.bin", 0, 1, range.data()));
+
+    CHECK_THROWS_AS(cache.StoreBlock("https://host/file.bin", 2, first_data), duckdb::IOException);
+    CHECK_THROWS_AS(cache.Evict("https://host/file.bin"), duckdb::IOException);
+    CHECK_THROWS_AS(cache.Clear(), duckdb::IOException);
+    cache.SetMaxCacheSize(0);
+    cache.Close();
+    CHECK(read_file() == image);
+
+    SECTION("A missing file isn't created") {
+        local_fs->RemoveFile(storage_file_path);
+        CHECK_THROWS_AS(cache.Open(storage_file_path), duckdb::IOException);
+        CHECK_FALSE(local_fs->FileExists(storage_file_path));
+    }
+}
+
+TEST_CASE("Cache contents are exported and imported as a bundle", "[Cache]") {
+    duckdb::string source_file_path = "/tmp/cache.bin";
+    duckdb::string target_file_path = "/tmp/cache_import.bin";
+    duckdb::string bundle_path = "/tmp/cache.qsbundle";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    for (const auto &path : {source_file_path, target_file_path, bundle_path}) {
+        if (local_fs->FileExists(path)) {
+            local_fs->RemoveFile(path);
+        }
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    const auto FILE_SIZE = 4 * BLOCK_SIZE + BLOCK_SIZE / 2;
+    auto file_data = InitializeRandomData(FILE_SIZE);
+    auto other_data = InitializeRandomData(BLOCK_SIZE);
+
+    auto source = Cache{BLOCK_SIZE};
+    source.Open(source_file_path);
+    source.StoreFileSize("https://host/file.bin", FILE_SIZE);
+    source.StoreFileLastModified("https://host/file.bin", duckdb::timestamp_t(1000));
+    for (int64_t block_index = 0; block_index < 5; ++block_index) {
+        const auto begin = file_data.begin() + block_index * BLOCK_SIZE;
+        duckdb::vector<uint8_t> block(begin, std::min(begin + BLOCK_SIZE, file_data.end()));
+        source.StoreBlock("https://host/file.bin", block_index, block);
+    }
+    source.StoreFileSize("https://host/stale.bin", BLOCK_SIZE);
+    source.StoreFileLastModified("https://host/stale.bin", duckdb::timestamp_t(1000));
+    source.StoreBlock("https://host/stale.bin", 0, other_data);
+    source.StoreFileSize("https://other/file.bin", BLOCK_SIZE);
+    source.StoreBlock("https://other/file.bin", 0, other_data);
+
+    auto exported = CacheBundle::Export(*local_fs, bundle_path, {source}, "https://host/");
+    CHECK(exported.files == 2);
+    CHECK(exported.blocks == 6);
+    CHECK(exported.bytes == FILE_SIZE + BLOCK_SIZE);
+
+    // The target has another block size and a newer version of one of the files
+    auto target = Cache{2 * BLOCK_SIZE};
+    target.Open(target_file_path);
+    target.StoreFileSize("https://host/stale.bin", 2 * BLOCK_SIZE);
+    target.StoreFileLastModified("https://host/stale.bin", duckdb::timestamp_t(2000));
+
+    auto imported = CacheBundle::Import(*local_fs, bundle_path, [&](const duckdb::string &) -> Cache & { return target; });
+    CHECK(imported.files == 1);
+    CHECK(imported.skipped_files == 1);
+    CHECK(imported.blocks == 3);
+    CHECK(imported.bytes == FILE_SIZE);
+
+    duckdb::vector<uint8_t> retrieved(FILE_SIZE);
+    REQUIRE(target.RetrieveRange("https://host/file.bin", 0, FILE_SIZE, retrieved.data()));
+    CHECK(retrieved == file_data);
+    MetadataManager::FileMetadata md;
+    REQUIRE(target.RetrieveFileMetadata("https://host/stale.bin", md));
+    CHECK(md.file_size == 2 * BLOCK_SIZE);
+    CHECK(md.blocks.empty());
+    CHECK_FALSE(target.RetrieveFileMetadata("https://other/file.bin", md));
+
+    // Importing again keeps the blocks already cached
+    imported = CacheBundle::Import(*local_fs, bundle_path, [&](const duckdb::string &) -> Cache & { return target; });
+    CHECK(imported.files == 1);
+    CHECK(imported.blocks == 0);
+
+    {
+        // A path length beyond the end of the bundle
+        auto handle = local_fs->OpenFile(bundle_path, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW);
+        duckdb::vector<uint8_t> content(8 + sizeof(uint32_t) + 1 + sizeof(uint32_t));
+        memcpy(content.data(), CacheBundle::MAGIC, 8);
+        duckdb::Store<uint32_t>(CacheBundle::VERSION, content.data() + 8);
+        content[8 + sizeof(uint32_t)] = 1;
+        duckdb::Store<uint32_t>(0xFFFFFFFF, content.data() + 8 + sizeof(uint32_t) + 1);
+        handle->Write(content.data(), content.size(), 0);
+    }
+    CHECK_THROWS_AS(CacheBundle::Import(*local_fs, bundle_path, [&](const duckdb::string &) -> Cache & { return target; }),
+                    duckdb::IOException);
+
+    {
+        auto handle = local_fs->OpenFile(bundle_path, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW);
+        const duckdb::string content = "not a bundle";
+        handle->Write((void *)content.data(), content.size(), 0);
+    }
+    CHECK_THROWS_AS(CacheBundle::Import(*local_fs, bundle_path, [&](const duckdb::string &) -> Cache & { return target; }),
+                    duckdb::IOException);
+}
+
+TEST_CASE("Files are evicted by path prefix and glob pattern", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    auto cache = Cache{BLOCK_SIZE};
+    cache.Open(storage_file_path);
+    auto data = InitializeRandomData(BLOCK_SIZE);
+    for (int i = 0; i < 100; ++i) {
+        cache.StoreBlock("quackstore://s3://b/t/date=2024-01/part-" + std::to_string(i) + ".parquet", 0, data);
+        cache.StoreBlock("quackstore://s3://b/t/date=2023-12/part-" + std::to_string(i) + ".parquet", 0, data);
+    }
+    CHECK(cache.GetCachedBytes() == 200 * BLOCK_SIZE);
+
+    // Given without the quackstore:// prefix
+    CHECK(cache.EvictGlob("s3://b/t/date=2024-*/") == 100);
+    CHECK(cache.GetCachedBytes() == 100 * BLOCK_SIZE);
+    CHECK(cache.EvictPrefix("quackstore://s3://b/t/date=2023-12/part-1") == 11);
+    CHECK(cache.EvictFiles({"quackstore://s3://b/t/date=2023-12/part-2.parquet", "quackstore://s3://b/missing"}) == 1);
+    CHECK(cache.GetCachedBytes() == 88 * BLOCK_SIZE);
+
+    // Artifacts matched along with their file are evicted but not counted
+    REQUIRE(cache.StoreArtifact("quackstore://s3://b/t/date=2023-12/part-3.parquet", "parquet_footer", data.data(), 10));
+    CHECK(cache.EvictPrefix("s3://b/t/date=2023-12/part-3.") == 1);
+    CHECK(cache.GetCachedBytes() == 87 * BLOCK_SIZE);
+
+    // The evictions are persisted
+    cache.Close();
+    cache.Open(storage_file_path);
+    CHECK(cache.GetCachedBytes() == 87 * BLOCK_SIZE);
+    CHECK(cache.EvictPrefix("s3://b/") == 87);
+    CHECK(cache.GetCachedBytes() == 0);
+}
+
+TEST_CASE("Artifacts are cached per file version and evicted with the file", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    const duckdb::string FILE_PATH = "quackstore://s3://b/t/part-0.parquet";
+    auto cache = Cache{BLOCK_SIZE};
+    cache.Open(storage_file_path);
+
+    // Artifacts need the file to be cached
+    auto footer = InitializeRandomData(3 * BLOCK_SIZE + 10);
+    duckdb::vector<uint8_t> data_out;
+    CHECK_FALSE(cache.StoreArtifact(FILE_PATH, "parquet_footer", footer.data(), footer.size()));
+
+    cache.StoreFileSize(FILE_PATH, 1000);
+    cache.StoreFileLastModified(FILE_PATH, duckdb::timestamp_t{1});
+    REQUIRE(cache.StoreArtifact(FILE_PATH, "parquet_footer", footer.data(), footer.size()));
+    REQUIRE(cache.StoreArtifact(FILE_PATH, "row_group_stats", footer.data(), 10));
+    CHECK_FALSE(cache.RetrieveArtifact(FILE_PATH, "csv_sniff", data_out));
+    REQUIRE(cache.RetrieveArtifact(FILE_PATH, "parquet_footer", data_out));
+    CHECK(data_out == footer);
+
+    // Artifacts are persisted
+    cache.Close();
+    cache.Open(storage_file_path);
+    REQUIRE(cache.RetrieveArtifact(FILE_PATH, "row_group_stats", data_out));
+    CHECK(data_out == duckdb::vector<uint8_t>(footer.begin(), footer.begin() + 10));
+
+    SECTION("A new version of the file doesn't see the artifacts of the old one") {
+        cache.StoreFileLastModified(FILE_PATH, duckdb::timestamp_t{2});
+        CHECK_FALSE(cache.RetrieveArtifact(FILE_PATH, "parquet_footer", data_out));
+    }
+
+    SECTION("Artifacts are evicted with the file") {
+        cache.Evict(FILE_PATH);
+        cache.StoreFileSize(FILE_PATH, 1000);
+        cache.StoreFileLastModified(FILE_PATH, duckdb::timestamp_t{1});
+        CHECK_FALSE(cache.RetrieveArtifact(FILE_PATH, "parquet_footer", data_out));
+        CHECK(cache.GetCachedBytes() == 0);
+    }
+}
+
+TEST_CASE("Stores into a full volume evict blocks instead of failing", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    const duckdb::string FILE_PATH = "quackstore://s3://b/t/data.bin";
+    auto block_mgr_ptr = duckdb::make_uniq<FullVolumeBlockManager>(BlockManagerOptions{BLOCK_SIZE});
+    auto &block_mgr = *block_mgr_ptr;
+    auto cache = Cache{BLOCK_SIZE, std::move(block_mgr_ptr), duckdb::make_uniq<MetadataManager>()};
+    cache.Open(storage_file_path);
+    cache.StoreFileSize(FILE_PATH, 20 * BLOCK_SIZE);
+    for (int64_t i = 0; i < 10; ++i) {
+        auto data = InitializeRandomData(BLOCK_SIZE);
+        cache.StoreBlock(FILE_PATH, i, data);
+    }
+    auto data = InitializeRandomData(BLOCK_SIZE);
+    duckdb::vector<uint8_t> data_out;
+
+    SECTION("The block is stored in the space of evicted blocks") {
+        block_mgr.failing_stores = 1;
+        cache.StoreBlock(FILE_PATH, 10, data);
+        REQUIRE(cache.RetrieveBlock(FILE_PATH, 10, data_out));
+        CHECK(data_out == data);
+        CHECK_FALSE(cache.RetrieveBlock(FILE_PATH, 0, data_out));
+    }
+
+    SECTION("The block is left uncached if it still doesn't fit") {
+        block_mgr.failing_stores = 2;
+        cache.StoreBlock(FILE_PATH, 10, data);
+        CHECK_FALSE(cache.RetrieveBlock(FILE_PATH, 10, data_out));
+        cache.StoreBlock(FILE_PATH, 10, data);
+        CHECK(cache.RetrieveBlock(FILE_PATH, 10, data_out));
+    }
+}
+
+TEST_CASE("The max cache size is derived from the free space of the volume", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto MAX_CACHE_SIZE = Gigabytes(1) << 20; // Larger than any test volume
+    auto cache = Cache{Kilobytes(1)};
+    cache.Open(storage_file_path);
+
+    cache.SetAutoSize(true, Kilobytes(64), 0);
+    cache.SetMaxCacheSize(MAX_CACHE_SIZE);
+    const auto derived_size = cache.GetMaxCacheSize();
+    CHECK(derived_size < MAX_CACHE_SIZE);
+    CHECK(derived_size >= Kilobytes(64));
+
+    // The size set is the maximum
+    cache.SetMaxCacheSize(Kilobytes(32));
+    CHECK(cache.GetMaxCacheSize() == Kilobytes(32));
+
+    // Without auto-sizing the size set applies
+    cache.SetAutoSize(false, 0, 0);
+    cache.SetMaxCacheSize(MAX_CACHE_SIZE);
+    CHECK(cache.GetMaxCacheSize() == MAX_CACHE_SIZE);
+}
+
+TEST_CASE("Background eviction keeps the cache between the watermarks", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    const duckdb::string FILE_PATH = "quackstore://s3://b/t/data.bin";
+    auto cache = Cache{BLOCK_SIZE};
+    cache.Open(storage_file_path);
+    cache.SetMaxCacheSize(100 * BLOCK_SIZE);
+
+    auto WaitForCachedBytes = [&](uint64_t max_bytes) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (cache.GetCachedBytes() > max_bytes && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return cache.GetCachedBytes();
+    };
+    cache.StoreFileSize(FILE_PATH, 200 * BLOCK_SIZE);
+    auto StoreBlocks = [&](int64_t first_index, int64_t count) {
+        for (int64_t i = first_index; i < first_index + count; ++i) {
+            auto data = InitializeRandomData(BLOCK_SIZE);
+            cache.StoreBlock(FILE_PATH, i, data);
+            CHECK(cache.GetCachedBytes() <= 100 * BLOCK_SIZE);
+        }
+    };
+
+    // The cache is over the high watermark, the evictor takes it down to the low watermark
+    StoreBlocks(0, 90);
+    cache.SetBackgroundEviction(true, 50, 80);
+    REQUIRE(cache.IsBackgroundEvictionEnabled());
+    CHECK(WaitForCachedBytes(50 * BLOCK_SIZE) == 50 * BLOCK_SIZE);
+
+    // The most recently stored blocks are kept
+    duckdb::vector<uint8_t> data_out;
+    CHECK(cache.RetrieveBlock(FILE_PATH, 89, data_out));
+    CHECK_FALSE(cache.RetrieveBlock(FILE_PATH, 0, data_out));
+
+    // Stores never take the cache over its max size while the evictor runs
+    StoreBlocks(90, 100);
+
+    SECTION("Shrinking the cache is done by the evictor") {
+        cache.SetMaxCacheSize(20 * BLOCK_SIZE);
+        CHECK(WaitForCachedBytes(10 * BLOCK_SIZE) == 10 * BLOCK_SIZE);
+    }
+
+    SECTION("The max cache size is enforced right away once background eviction is disabled") {
+        cache.SetBackgroundEviction(false, 50, 80);
+        CHECK_FALSE(cache.IsBackgroundEvictionEnabled());
+        cache.SetMaxCacheSize(20 * BLOCK_SIZE);
+        CHECK(cache.GetCachedBytes() == 20 * BLOCK_SIZE);
+    }
+}
+
+TEST_CASE("The most recently used blocks are warmed up after the cache is opened", "[Cache]") {
+    duckdb::string storage_file_path = "/tmp/cache.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (local_fs->FileExists(storage_file_path)) {
+        local_fs->RemoveFile(storage_file_path);
+    }
+
+    const auto BLOCK_SIZE = Kilobytes(1);
+    const duckdb::string FILE_PATH = "quackstore://s3://b/t/data.bin";
+    {
+        auto cache = Cache{BLOCK_SIZE};
+        cache.Open(storage_file_path);
+        cache.StoreFileSize(FILE_PATH, 10 * BLOCK_SIZE);
+        for (int64_t i = 0; i < 10; ++i) {
+            auto data = InitializeRandomData(BLOCK_SIZE);
+            cache.StoreBlock(FILE_PATH, i, data);
+        }
+        cache.Close();
+    }
+
+    auto cache = Cache{BLOCK_SIZE};
+    SECTION("Up to the warm-up size") {
+        cache.SetWarmupSize(4 * BLOCK_SIZE);
+        cache.Open(storage_file_path);
+        CHECK(cache.GetWarmupBytes() == 4 * BLOCK_SIZE);
+        // The blocks stored last
+        for (int64_t i = 0; i < 10; ++i) {
+            CHECK(cache.IsBlockWarmedUp(FILE_PATH, i) == (i >= 6));
+        }
+        // Once per open
+        cache.SetWarmupSize(8 * BLOCK_SIZE);
+        CHECK(cache.GetWarmupBytes() == 4 * BLOCK_SIZE);
+    }
+    SECTION("At most the cached blocks") {
+        cache.Open(storage_file_path);
+        CHECK(cache.GetWarmupBytes() == 0);
+        cache.SetWarmupSize(Megabytes(1));
+        CHECK(cache.GetWarmupBytes() == 10 * BLOCK_SIZE);
+    }
+    SECTION("Not while the page cache drop is enabled") {
+        cache.SetPageCacheDropEnabled(true);
+        cache.SetWarmupSize(4 * BLOCK_SIZE);
+        cache.Open(storage_file_path);
+        CHECK(cache.GetWarmupBytes() == 0);
+    }
+
+    duckdb::vector<uint8_t> data_out(BLOCK_SIZE);
+    CHECK(cache.RetrieveBlock(FILE_PATH, 9, data_out));
+}
@@ -8,6 +8,7 @@
 #include "quackstore_params.hpp"
 #include "extension_state.hpp"
 #include "quackstore_filesystem.hpp"
+#include "cache_router.hpp"
 
 using namespace quackstore;
 
@@ -243,12 +244,16 @@ TEST_CASE_METHOD(WithDuckDB, "Change cache paths while cache is used", "[quackst
 
     SECTION("Has open handles")
     {
+        // Open handles finish against the old cache, new handles use the new one
         auto open_handle = context_fs.OpenFile(FILENAME, duckdb::FileOpenFlags::FILE_FLAGS_READ);
         auto res = con.Query(query);
-        REQUIRE(res->HasError());
-        CHECK(res->GetErrorObject().Type() == duckdb::ExceptionType::IO);
-        CHECK(res->GetErrorObject().RawMessage() == "Query cache is in use, please wait for the running queries to finish and try again.");
-        REQUIRE(GetExtensionParams(*con.context).cache_path == INITIAL_PATH);
+        REQUIRE_FALSE(res->HasError());
+        CHECK(GetExtensionParams(*con.context).cache_path == NEW_PATH);
+
+        char buffer[4];
+        REQUIRE_NOTHROW(open_handle->Read(buffer, sizeof(buffer), 0));
+        auto new_handle = context_fs.OpenFile(FILENAME, duckdb::FileOpenFlags::FILE_FLAGS_READ);
+        CHECK(duckdb::FileSystem::CreateLocal()->FileExists(NEW_PATH));
     }
     SECTION("Has no open handles")
     {
@@ -346,3 +351,101 @@ TEST_CASE_METHOD(WithDuckDB, "Data mutable parameter scope behavior", "[quacksto
         CHECK(GetExtensionParams(*con2.context).data_mutable == true);
     }
 }
+
+TEST_CASE("Parse named caches", "[quackstore_params]") {
+    ExtensionParams defaults;
+    defaults.max_cache_size = 1024;
+    defaults.dedup_enabled = true;
+
+    auto caches = ExtensionParams::ParseNamedCaches(
+        "hot: prefix=s3://hot-bucket/, path=/tmp/hot.bin, size=1MiB, block_size=64KiB;\n"
+        " archive : prefix=https://archive/, path=/tmp/archive.bin, dedup=false;",
+        defaults);
+    REQUIRE(caches.size() == 2);
+    CHECK(caches[0].name == "hot");
+    CHECK(caches[0].prefix == "s3://hot-bucket/");
+    CHECK(caches[0].path == "/tmp/hot.bin");
+    CHECK(caches[0].max_cache_size == 1024 * 1024);
+    CHECK(caches[0].block_size == 64 * 1024);
+    CHECK(caches[0].dedup_enabled);
+    CHECK(caches[1].name == "archive");
+    CHECK(caches[1].max_cache_size == 1024);
+    CHECK(caches[1].block_size == 0);
+    CHECK_FALSE(caches[1].dedup_enabled);
+
+    CHECK(ExtensionParams::ParseNamedCaches("", defaults).empty());
+    CHECK_THROWS_AS(ExtensionParams::ParseNamedCaches("prefix=s3://a/, path=/tmp/a.bin", defaults), duckdb::InvalidInputException);
+    CHECK_THROWS_AS(ExtensionParams::ParseNamedCaches("a: prefix=s3://a/", defaults), duckdb::InvalidInputException);
+    CHECK_THROWS_AS(ExtensionParams::ParseNamedCaches("a: prefix=s3://a/, path=/tmp/a.bin, color=red", defaults), duckdb::InvalidInputException);
+    CHECK_THROWS_AS(ExtensionParams::ParseNamedCaches("a: prefix=s3://a/, path=/tmp/a.bin; a: prefix=s3://b/, path=/tmp/b.bin", defaults), duckdb::InvalidInputException);
+}
+
+TEST_CASE("Parse quotas", "[quackstore_params]") {
+    auto quotas = ExtensionParams::ParseQuotas(" s3://tenant-a/ = 1KiB; s3://tenant-b/=25%;");
+    REQUIRE(quotas.size() == 2);
+    CHECK(quotas[0].prefix == "s3://tenant-a/");
+    CHECK(quotas[0].max_bytes == 1024);
+    CHECK(quotas[0].percent == 0);
+    CHECK(quotas[1].prefix == "s3://tenant-b/");
+    CHECK(quotas[1].percent == 25);
+    CHECK(quotas[1].GetLimit(1000) == 250);
+
+    CHECK(ExtensionParams::ParseQuotas("").empty());
+    CHECK_THROWS_AS(ExtensionParams::ParseQuotas("s3://tenant-a/"), duckdb::InvalidInputException);
+    CHECK_THROWS_AS(ExtensionParams::ParseQuotas("s3://tenant-a/=0%"), duckdb::InvalidInputException);
+    CHECK_THROWS_AS(ExtensionParams::ParseQuotas("s3://a/=1KiB; s3://a/=2KiB"), duckdb::InvalidInputException);
+}
+
+TEST_CASE("Parse glob order", "[quackstore_params]") {
+    CHECK(ExtensionParams::ParseGlobOrder("source") == GlobOrder::SOURCE);
+    CHECK(ExtensionParams::ParseGlobOrder(" Cached_First ") == GlobOrder::CACHED_FIRST);
+    CHECK(ExtensionParams::ParseGlobOrder("interleaved") == GlobOrder::INTERLEAVED);
+    CHECK_THROWS_AS(ExtensionParams::ParseGlobOrder("random"), duckdb::InvalidInputException);
+}
+
+TEST_CASE("Parse storage layout", "[quackstore_params]") {
+    CHECK(ExtensionParams::ParseStorageLayout("in_place") == StorageLayout::IN_PLACE);
+    CHECK(ExtensionParams::ParseStorageLayout(" Segmented ") == StorageLayout::SEGMENTED);
+    CHECK_THROWS_AS(ExtensionParams::ParseStorageLayout("log"), duckdb::InvalidInputException);
+}
+
+TEST_CASE("Files are routed to named caches by path prefix", "[quackstore]") {
+    const duckdb::string DEFAULT_PATH = "/tmp/cache_default.bin";
+    const duckdb::string BUCKET_PATH = "/tmp/cache_bucket.bin";
+    const duckdb::string SUBDIR_PATH = "/tmp/cache_subdir.bin";
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    for (const auto &path : {DEFAULT_PATH, BUCKET_PATH, SUBDIR_PATH}) {
+        if (local_fs->FileExists(path)) {
+            local_fs->RemoveFile(path);
+        }
+    }
+
+    ExtensionParams params;
+    params.cache_path = DEFAULT_PATH;
+    params.caches = ExtensionParams::ParseNamedCaches(
+        "bucket: prefix=s3://bucket/, path=" + BUCKET_PATH + ", block_size=16KiB;"
+        "subdir: prefix=s3://bucket/subdir/, path=" + SUBDIR_PATH, params);
+
+    Cache default_cache{Kilobytes(64)};
+    CacheRouter router{default_cache};
+
+    auto &other = router.Route("quackstore://https://host/file.csv", params);
+    CHECK(&other == &default_cache);
+    CHECK(other.GetPath() == DEFAULT_PATH);
+
+    auto &bucket = router.Route("quackstore://s3://bucket/file.csv", params);
+    CHECK(bucket.GetPath() == BUCKET_PATH);
+    CHECK(bucket.GetBlockSize() == Kilobytes(16));
+
+    // The longest matching prefix wins
+    auto &subdir = router.Route("s3://bucket/subdir/file.csv", params);
+    CHECK(subdir.GetPath() == SUBDIR_PATH);
+    CHECK(&router.Route("s3://bucket/other/file.csv", params) == &bucket);
+
+    // Caches dropped from the configuration are closed
+    router.Configure({params.caches[0]});
+    CHECK(bucket.IsOpen());
+    idx_t cache_count = 0;
+    router.ForEachCache([&](Cache &) { ++cache_count; });
+    CHECK(cache_count == 2);
+}
@@ -13,6 +13,7 @@
 #include "quackstore_params.hpp"
 #include "cache.hpp"
 #include "extension_state.hpp"
+#include "gzip_reader.hpp"
 
 using namespace quackstore;
 
@@ -965,36 +966,455 @@ TEST_CASE_METHOD(WithDuckDB, "Check QuackstoreFileSystem::FileExists", "[cachefs
 }
 
 
-// TEST_CASE_METHOD(WithDuckDB, "Check QuackstoreFileSystem::FileExists (via ATATCH)", "[quackstore]") {
-//     const auto CACHE_PATH = "/tmp/cache.bin";
-//     RemoveLocalFile(CACHE_PATH);
-//     auto cache = Cache{16};
-//     cache.Open(CACHE_PATH);
-// 
-//     const duckdb::string FILE_PATH = QuackstoreFileSystem::SCHEMA_PREFIX + duckdb::string{"test/testdata/read_test.txt"};
-// 
-//     auto& main_fs_ref = GetDBInstance().GetFileSystem();
-//     main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
-//     main_fs_ref.RegisterSubSystem(duckdb::make_uniq<QuackstoreFileSystem>(cache));
-// 
-//     auto& db = GetDBInstance();
-//     auto con = duckdb::Connection{db};
-//     auto result = con.Query("SELECT 1;");
-// 
-//     result = con.Query("ATTACH 's3://dkosmakov/mydb3.duckdb' as remote_db_noncached;");
-//     CHECK_FALSE(result->HasError());
-// 
-//     result = con.Query("ATTACH 'quackstore://s3://dkosmakov/mydb3.duckdb' as remote_db_readonly (READ_ONLY);");
-//     REQUIRE_FALSE(result->HasError());
-// 
-//     result = con.Query("ATTACH 'quackstore://s3://dkosmakov/mydb3.duckdb' as remote_db;");
-//     CHECK(result->HasError());
-// 
-//     result = con.Query("SELECT * FROM remote_db_readonly.integers;");
-//     REQUIRE_FALSE(result->HasError());
-//     CHECK(result->ColumnCount() == 1);
-//     CHECK(result->RowCount() == 4);
-// }
+TEST_CASE_METHOD(WithDuckDB, "Database files are attached read-only through the cache", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_attach_test.bin";
+    const auto DATABASE_PATH = "/tmp/attach_test.duckdb";
+    const duckdb::string DATABASE_URI = QuackstoreFileSystem::SCHEMA_PREFIX + duckdb::string{DATABASE_PATH};
+    RemoveLocalFile(CACHE_PATH);
+    RemoveLocalFile(DATABASE_PATH);
+    {
+        duckdb::DuckDB source_db{DATABASE_PATH};
+        duckdb::Connection source_con{source_db};
+        REQUIRE_FALSE(source_con.Query("CREATE TABLE integers AS SELECT range AS i FROM range(100000);")->HasError());
+    }
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+
+    auto cache = Cache{Kilobytes(64)};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    main_fs_ref.RegisterSubSystem(duckdb::make_uniq<QuackstoreFileSystem>(cache));
+
+    auto con = duckdb::Connection{GetDBInstance()};
+
+    SECTION("Attaching for writing fails") {
+        auto result = con.Query("ATTACH '" + DATABASE_URI + "' AS remote_db;");
+        CHECK(result->HasError());
+    }
+
+    SECTION("Attached database is read from the cache") {
+        auto result = con.Query("ATTACH '" + DATABASE_URI + "' AS remote_db (READ_ONLY);");
+        REQUIRE_FALSE(result->HasError());
+
+        result = con.Query("SELECT count(*), sum(i) FROM remote_db.integers;");
+        REQUIRE_FALSE(result->HasError());
+        CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 100000);
+        CHECK(result->GetValue(1, 0).GetValue<int64_t>() == 4999950000);
+        REQUIRE_FALSE(con.Query("DETACH remote_db;")->HasError());
+
+        // The headers are cached and retained
+        MetadataManager::FileMetadata md;
+        REQUIRE(cache.RetrieveFileMetadata(DATABASE_URI, md));
+        CHECK_FALSE(md.blocks.empty());
+        duckdb::vector<uint8_t> header(4096 * 3);
+        CHECK(cache.RetrieveRange(DATABASE_URI, 0, header.size(), header.data()));
+
+        // Attaching it again is served from the cache
+        REQUIRE_FALSE(con.Query("ATTACH '" + DATABASE_URI + "' AS remote_db (READ_ONLY);")->HasError());
+        result = con.Query("SELECT count(*) FROM remote_db.integers;");
+        REQUIRE_FALSE(result->HasError());
+        CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 100000);
+        REQUIRE_FALSE(con.Query("DETACH remote_db;")->HasError());
+    }
+
+    cache.Close();
+    RemoveLocalFile(DATABASE_PATH);
+}
+
+TEST_CASE_METHOD(WithDuckDB, "Decompressed streams of gzip-compressed files are cached", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_decompressed_test.bin";
+    const auto CSV_PATH = "/tmp/decompressed_test.csv.gz";
+    const duckdb::string CSV_URI = QuackstoreFileSystem::SCHEMA_PREFIX + duckdb::string{CSV_PATH};
+    const duckdb::string DECOMPRESSED_KEY = CSV_URI + QuackstoreFileSystem::DECOMPRESSED_SUFFIX;
+    RemoveLocalFile(CACHE_PATH);
+    RemoveLocalFile(CSV_PATH);
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+
+    auto cache = Cache{Kilobytes(16)};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    main_fs_ref.RegisterSubSystem(duckdb::make_uniq<QuackstoreFileSystem>(cache));
+    main_fs_ref.RegisterSubSystem(duckdb::FileCompressionType::GZIP, duckdb::make_uniq<QuackstoreCompressedFileSystem>());
+
+    auto con = duckdb::Connection{GetDBInstance()};
+    // Files not read through the cache are compressed and decompressed by DuckDB's gzip file system
+    REQUIRE_FALSE(con.Query(duckdb::string("COPY (SELECT range AS i, 'row ' || range AS s FROM range(50000)) TO '") +
+                            CSV_PATH + "';")->HasError());
+    const auto query = "SELECT count(*), sum(i) FROM read_csv('" + CSV_URI + "');";
+
+    SECTION("Compressed bytes are cached by default") {
+        auto result = con.Query(query);
+        REQUIRE_FALSE(result->HasError());
+        CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 50000);
+        CHECK(result->GetValue(1, 0).GetValue<int64_t>() == 1249975000);
+
+        MetadataManager::FileMetadata md;
+        CHECK(cache.RetrieveFileMetadata(CSV_URI, md));
+        CHECK_FALSE(md.blocks.empty());
+        CHECK_FALSE(cache.RetrieveFileMetadata(DECOMPRESSED_KEY, md));
+    }
+
+    SECTION("Decompressed stream is cached") {
+        REQUIRE_FALSE(con.Query("SET quackstore_cache_decompressed = true;")->HasError());
+        for (int i = 0; i < 2; ++i) {
+            auto result = con.Query(query);
+            REQUIRE_FALSE(result->HasError());
+            CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 50000);
+            CHECK(result->GetValue(1, 0).GetValue<int64_t>() == 1249975000);
+        }
+
+        MetadataManager::FileMetadata md;
+        REQUIRE(cache.RetrieveFileMetadata(DECOMPRESSED_KEY, md));
+        CHECK(md.file_size > duckdb::FileSystem::CreateLocal()->OpenFile(CSV_PATH, duckdb::FileFlags::FILE_FLAGS_READ)->GetFileSize());
+        CHECK(md.blocks.size() == static_cast<size_t>((md.file_size + Kilobytes(16) - 1) / Kilobytes(16)));
+
+        // A stream without the marker of its size wasn't decompressed to its end, its blocks aren't used
+        duckdb::vector<uint8_t> marker;
+        REQUIRE(cache.RetrieveArtifact(CSV_URI, QuackstoreFileSystem::DECOMPRESSED_SIZE_ARTIFACT, marker));
+        CHECK(duckdb::Load<int64_t>(marker.data()) == md.file_size);
+        cache.EvictFiles({CSV_URI + Cache::ARTIFACT_SEPARATOR + QuackstoreFileSystem::DECOMPRESSED_SIZE_ARTIFACT});
+        duckdb::vector<uint8_t> garbage(Kilobytes(16), 'x');
+        cache.StoreBlock(DECOMPRESSED_KEY, 0, garbage);
+        {
+            auto result = con.Query(query);
+            REQUIRE_FALSE(result->HasError());
+            CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 50000);
+            CHECK(result->GetValue(1, 0).GetValue<int64_t>() == 1249975000);
+        }
+
+        // An evicted stream is decompressed again
+        cache.EvictPrefix(CSV_URI);
+        CHECK_FALSE(cache.RetrieveFileMetadata(DECOMPRESSED_KEY, md));
+        auto result = con.Query(query);
+        REQUIRE_FALSE(result->HasError());
+        CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 50000);
+    }
+
+    SECTION("Seeking back decompresses from the closest checkpoint") {
+        auto plain_stream = main_fs_ref.OpenFile(CSV_PATH, duckdb::FileFlags::FILE_FLAGS_READ |
+                                                           duckdb::FileCompressionType::GZIP);
+        // Compressed handles report the size of the compressed file, the stream is read to its end
+        duckdb::vector<uint8_t> expected;
+        duckdb::vector<uint8_t> chunk(Kilobytes(64));
+        int64_t bytes_read;
+        while ((bytes_read = plain_stream->Read(chunk.data(), chunk.size())) > 0) {
+            expected.insert(expected.end(), chunk.begin(), chunk.begin() + bytes_read);
+        }
+        REQUIRE(expected.size() > Kilobytes(256));
+
+        auto reader = GzipReader{duckdb::FileSystem::CreateLocal()->OpenFile(CSV_PATH, duckdb::FileFlags::FILE_FLAGS_READ), Kilobytes(64)};
+        duckdb::vector<uint8_t> data_out(expected.size() + 1);
+        CHECK(reader.Read(data_out.data(), data_out.size()) == expected.size());
+        CHECK(reader.IsFinished());
+        CHECK(reader.GetCheckpointCount() > 0);
+        data_out.resize(expected.size());
+        CHECK(data_out == expected);
+
+        const idx_t offset = expected.size() / 2;
+        CHECK(reader.Seek(offset) == offset);
+        duckdb::vector<uint8_t> middle(Kilobytes(16));
+        CHECK(reader.Read(middle.data(), middle.size()) == middle.size());
+        CHECK(std::equal(middle.begin(), middle.end(), expected.begin() + offset));
+        CHECK(reader.Seek(expected.size() + 1) == expected.size());
+    }
+
+    cache.Close();
+    RemoveLocalFile(CSV_PATH);
+}
+
+TEST_CASE_METHOD(WithDuckDB, "Files written through the cache are read from it", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_write_through_test.bin";
+    const auto PARQUET_PATH = "/tmp/write_through_test.parquet";
+    const duckdb::string PARQUET_URI = QuackstoreFileSystem::SCHEMA_PREFIX + duckdb::string{PARQUET_PATH};
+    RemoveLocalFile(CACHE_PATH);
+    RemoveLocalFile(PARQUET_PATH);
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+
+    auto cache = Cache{Kilobytes(16)};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    main_fs_ref.RegisterSubSystem(duckdb::make_uniq<QuackstoreFileSystem>(cache));
+
+    auto con = duckdb::Connection{GetDBInstance()};
+    const auto copy = "COPY (SELECT range AS i FROM range(100000)) TO '" + PARQUET_URI + "' (FORMAT parquet);";
+    MetadataManager::FileMetadata md;
+
+    SECTION("Files are only written to the source by default") {
+        REQUIRE_FALSE(con.Query(copy)->HasError());
+        CHECK(duckdb::FileSystem::CreateLocal()->FileExists(PARQUET_PATH));
+        CHECK_FALSE(cache.RetrieveFileMetadata(PARQUET_URI, md));
+    }
+
+    SECTION("Written blocks are cached with write-through") {
+        REQUIRE_FALSE(con.Query("SET quackstore_write_through = true;")->HasError());
+        REQUIRE_FALSE(con.Query(copy)->HasError());
+
+        auto local_fs = duckdb::FileSystem::CreateLocal();
+        auto handle = local_fs->OpenFile(PARQUET_PATH, duckdb::FileFlags::FILE_FLAGS_READ);
+        REQUIRE(cache.RetrieveFileMetadata(PARQUET_URI, md));
+        CHECK(md.file_size == local_fs->GetFileSize(*handle));
+        CHECK(md.last_modified == local_fs->GetLastModifiedTime(*handle));
+        CHECK(md.blocks.size() == static_cast<size_t>((md.file_size + Kilobytes(16) - 1) / Kilobytes(16)));
+        handle.reset();
+
+        // The file is read from the cache only, even once the source is gone
+        REQUIRE_FALSE(con.Query("SET quackstore_data_mutable = false;")->HasError());
+        local_fs->RemoveFile(PARQUET_PATH);
+        auto result = con.Query("SELECT count(*), sum(i) FROM '" + PARQUET_URI + "';");
+        REQUIRE_FALSE(result->HasError());
+        CHECK(result->GetValue(0, 0).GetValue<int64_t>() == 100000);
+        CHECK(result->GetValue(1, 0).GetValue<int64_t>() == 4999950000);
+    }
+
+    SECTION("Removing a file evicts it") {
+        REQUIRE_FALSE(con.Query("SET quackstore_write_through = true;")->HasError());
+        REQUIRE_FALSE(con.Query(copy)->HasError());
+        REQUIRE(cache.RetrieveFileMetadata(PARQUET_URI, md));
+        auto opener = duckdb::DatabaseFileOpener{GetDBInstance()};
+        main_fs_ref.RemoveFile(PARQUET_URI, &opener);
+        CHECK_FALSE(cache.RetrieveFileMetadata(PARQUET_URI, md));
+    }
+
+    SECTION("Handles opened for writing seek but can't be read") {
+        REQUIRE_FALSE(con.Query("SET quackstore_write_through = true;")->HasError());
+        auto opener = duckdb::DatabaseFileOpener{GetDBInstance()};
+        auto handle = main_fs_ref.OpenFile(PARQUET_URI, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW, &opener);
+        duckdb::string content = "quack";
+        handle->Write(const_cast<char *>(content.data()), content.size());
+        CHECK(handle->SeekPosition() == content.size());
+        handle->Seek(1);
+        CHECK(handle->SeekPosition() == 1);
+        handle->Write(const_cast<char *>(content.data()), content.size());
+        CHECK(handle->SeekPosition() == 1 + content.size());
+        CHECK(main_fs_ref.GetFileSize(*handle) == static_cast<int64_t>(1 + content.size()));
+
+        char buffer[5];
+        CHECK_THROWS_AS(handle->Read(buffer, sizeof(buffer), 0), duckdb::IOException);
+        handle->Close();
+
+        // Written out of order, the file isn't cached
+        CHECK_FALSE(cache.RetrieveFileMetadata(PARQUET_URI, md));
+    }
+
+    cache.Close();
+    RemoveLocalFile(PARQUET_PATH);
+}
+
+TEST_CASE_METHOD(WithDuckDB, "Version tags are derived from the cached file metadata", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_version_tag_test.bin";
+    const auto FILENAME = "/tmp/version_tag_test.txt";
+    const duckdb::string FILE_URI = QuackstoreFileSystem::SCHEMA_PREFIX + duckdb::string{FILENAME};
+    RemoveLocalFile(CACHE_PATH);
+    RemoveLocalFile(FILENAME);
+
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    auto WriteFile = [&](const duckdb::string &content) {
+        auto handle = local_fs->OpenFile(FILENAME, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW);
+        handle->Write(const_cast<char *>(content.data()), content.size());
+    };
+    WriteFile("quack");
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_BACKING_TIER, duckdb::Value::BOOLEAN(true));
+
+    auto cache = Cache{16};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    main_fs_ref.RegisterSubSystem(duckdb::make_uniq<QuackstoreFileSystem>(cache));
+
+    auto opener = duckdb::DatabaseFileOpener{GetDBInstance()};
+    auto handle = main_fs_ref.OpenFile(FILE_URI, duckdb::FileFlags::FILE_FLAGS_READ, &opener);
+    const auto tag = main_fs_ref.GetVersionTag(*handle);
+    CHECK_FALSE(tag.empty());
+    CHECK(main_fs_ref.GetVersionTag(*handle) == tag);
+    CHECK(cache.IsPageCacheDropEnabled());
+
+    // Blocks read with the page cache dropped are intact
+    duckdb::vector<char> data(5);
+    handle->Read(data.data(), data.size(), 0);
+    handle->Read(data.data(), data.size(), 0);
+    CHECK(duckdb::string(data.data(), data.size()) == "quack");
+    handle.reset();
+
+    // A changed file is a new version (evicted as a file changed within the resolution of its modification time)
+    RemoveLocalFile(FILENAME);
+    WriteFile("quack quack");
+    cache.Evict(FILE_URI);
+    handle = main_fs_ref.OpenFile(FILE_URI, duckdb::FileFlags::FILE_FLAGS_READ, &opener);
+    CHECK(main_fs_ref.GetVersionTag(*handle) != tag);
+    handle.reset();
+
+    // Handles opened for writing are versioned by the source file
+    handle = main_fs_ref.OpenFile(FILE_URI, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW, &opener);
+    duckdb::string content = "quack";
+    handle->Write(const_cast<char *>(content.data()), content.size());
+    CHECK_FALSE(main_fs_ref.GetVersionTag(*handle).empty());
+    CHECK(main_fs_ref.GetLastModifiedTime(*handle) == local_fs->GetLastModifiedTime(*local_fs->OpenFile(FILENAME, duckdb::FileFlags::FILE_FLAGS_READ)));
+    handle.reset();
+
+    cache.Close();
+    RemoveLocalFile(FILENAME);
+}
+
+TEST_CASE_METHOD(WithDuckDB, "Files referenced by Delta logs are prefetched", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_table_prefetch_test.bin";
+    const duckdb::string TABLE_PATH = "/tmp/table_prefetch_test";
+    const auto DATA_PATH = TABLE_PATH + "/part-0.parquet";
+    const auto LOG_PATH = TABLE_PATH + "/_delta_log/00000000000000000000.json";
+    const duckdb::string DATA_URI = QuackstoreFileSystem::SCHEMA_PREFIX + DATA_PATH;
+    const duckdb::string LOG_URI = QuackstoreFileSystem::SCHEMA_PREFIX + LOG_PATH;
+    RemoveLocalFile(CACHE_PATH);
+    RemoveLocalFile(DATA_PATH);
+    RemoveLocalFile(LOG_PATH);
+
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (!local_fs->DirectoryExists(TABLE_PATH + "/_delta_log")) {
+        local_fs->CreateDirectory(TABLE_PATH);
+        local_fs->CreateDirectory(TABLE_PATH + "/_delta_log");
+    }
+    {
+        const duckdb::string log = R"({"add":{"path":"part-0.parquet","partitionValues":{},"dataChange":true}})" "\n";
+        auto handle = local_fs->OpenFile(LOG_PATH, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW);
+        handle->Write(const_cast<char *>(log.data()), log.size());
+    }
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+
+    auto con = duckdb::Connection{GetDBInstance()};
+    REQUIRE_FALSE(con.Query("COPY (SELECT range AS i FROM range(100000)) TO '" + DATA_PATH + "' (FORMAT parquet);")->HasError());
+
+    auto cache = Cache{Kilobytes(16)};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    auto cache_fs = duckdb::make_uniq<QuackstoreFileSystem>(cache);
+    auto& cache_fs_ref = *cache_fs;
+    main_fs_ref.RegisterSubSystem(std::move(cache_fs));
+
+    auto ReadLog = [&]() {
+        auto opener = duckdb::DatabaseFileOpener{GetDBInstance()};
+        auto handle = main_fs_ref.OpenFile(LOG_URI, duckdb::FileFlags::FILE_FLAGS_READ, &opener);
+        duckdb::vector<char> data(main_fs_ref.GetFileSize(*handle));
+        handle->Read(data.data(), data.size(), 0);
+        handle.reset();
+        cache_fs_ref.WaitForPrefetches();
+    };
+    MetadataManager::FileMetadata md;
+
+    SECTION("Nothing is prefetched by default") {
+        ReadLog();
+        CHECK_FALSE(cache.RetrieveFileMetadata(DATA_URI, md));
+    }
+
+    SECTION("The footers of the data files are prefetched") {
+        config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_TABLE_PREFETCH, duckdb::Value::BOOLEAN(true));
+        ReadLog();
+        REQUIRE(cache.RetrieveFileMetadata(DATA_URI, md));
+        const auto last_block = static_cast<block_id_t>((md.file_size - 1) / Kilobytes(16));
+        CHECK(md.blocks.count(last_block) == 1);
+        CHECK(md.blocks.count(0) == 0);
+    }
+
+    cache.Close();
+    RemoveLocalFile(DATA_PATH);
+    RemoveLocalFile(LOG_PATH);
+}
+
+TEST_CASE_METHOD(WithDuckDB, "Glob results can list cached files first", "[quackstore]") {
+    const auto CACHE_PATH = "/tmp/cache_glob_order_test.bin";
+    const duckdb::string DIRECTORY = "/tmp/glob_order_test";
+    const duckdb::string PATTERN_URI = QuackstoreFileSystem::SCHEMA_PREFIX + DIRECTORY + "/*.csv";
+    const duckdb::vector<duckdb::string> NAMES = {"a.csv", "b.csv", "c.csv"};
+    RemoveLocalFile(CACHE_PATH);
+
+    auto local_fs = duckdb::FileSystem::CreateLocal();
+    if (!local_fs->DirectoryExists(DIRECTORY)) {
+        local_fs->CreateDirectory(DIRECTORY);
+    }
+    for (auto &name : NAMES) {
+        RemoveLocalFile(DIRECTORY + "/" + name);
+        const duckdb::string content = "i\n" + name + "\n";
+        auto handle = local_fs->OpenFile(DIRECTORY + "/" + name, duckdb::FileFlags::FILE_FLAGS_WRITE | duckdb::FileFlags::FILE_FLAGS_FILE_CREATE_NEW);
+        handle->Write(const_cast<char *>(content.data()), content.size());
+    }
+
+    auto& config = duckdb::DBConfig::GetConfig(GetDBInstance());
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_PATH, duckdb::Value{CACHE_PATH});
+    config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_CACHE_ENABLED, duckdb::Value::BOOLEAN(true));
+
+    auto cache = Cache{16};
+    cache.Open(CACHE_PATH);
+    auto& main_fs_ref = GetDBInstance().GetFileSystem();
+    main_fs_ref.UnregisterSubSystem(QuackstoreFileSystem::FILESYSTEM_NAME);
+    auto cache_fs = duckdb::make_uniq<QuackstoreFileSystem>(cache);
+    auto& cache_fs_ref = *cache_fs;
+    main_fs_ref.RegisterSubSystem(std::move(cache_fs));
+
+    // b.csv and c.csv are cached
+    auto opener = duckdb::DatabaseFileOpener{GetDBInstance()};
+    for (auto &name : {"b.csv", "c.csv"}) {
+        const auto uri = QuackstoreFileSystem::SCHEMA_PREFIX + DIRECTORY + "/" + name;
+        auto handle = main_fs_ref.OpenFile(uri, duckdb::FileFlags::FILE_FLAGS_READ, &opener);
+        duckdb::vector<char> data(main_fs_ref.GetFileSize(*handle));
+        handle->Read(data.data(), data.size(), 0);
+    }
+    auto GlobNames = [&]() {
+        duckdb::vector<duckdb::string> names;
+        for (auto &entry : main_fs_ref.Glob(PATTERN_URI, &opener)) {
+            names.push_back(entry.path.substr(entry.path.find_last_of('/') + 1));
+        }
+        return names;
+    };
+
+    SECTION("The source order is kept by default") {
+        CHECK(GlobNames() == NAMES);
+    }
+
+    SECTION("Cached files are listed first") {
+        config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_GLOB_ORDER, duckdb::Value{"cached_first"});
+        CHECK(GlobNames() == duckdb::vector<duckdb::string>{"b.csv", "c.csv", "a.csv"});
+    }
+
+    SECTION("Cached files alternate with the other files, which are prefetched") {
+        config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_GLOB_ORDER, duckdb::Value{"interleaved"});
+        CHECK(GlobNames() == duckdb::vector<duckdb::string>{"b.csv", "a.csv", "c.csv"});
+        cache_fs_ref.WaitForPrefetches();
+        CHECK(cache.IsFileCached(QuackstoreFileSystem::SCHEMA_PREFIX + DIRECTORY + "/a.csv"));
+    }
+
+    SECTION("Files beyond the free space of the cache aren't prefetched") {
+        // b.csv and c.csv hold 16 bytes, a.csv doesn't fit the 4 bytes left
+        REQUIRE(cache.GetCachedBytes() == 16);
+        cache.SetMaxCacheSize(20);
+        config.SetOptionByName(ExtensionParams::PARAM_NAME_QUACKSTORE_GLOB_ORDER, duckdb::Value{"interleaved"});
+        CHECK(GlobNames() == duckdb::vector<duckdb::string>{"b.csv", "a.csv", "c.csv"});
+        cache_fs_ref.WaitForPrefetches();
+        CHECK_FALSE(cache.IsFileCached(QuackstoreFileSystem::SCHEMA_PREFIX + DIRECTORY + "/a.csv"));
+        CHECK(cache.IsFileCached(QuackstoreFileSystem::SCHEMA_PREFIX + DIRECTORY + "/b.csv"));
+    }
+
+    cache_fs_ref.WaitForPrefetches();
+    cache.Close();
+    for (auto &name : NAMES) {
+        RemoveLocalFile(DIRECTORY + "/" + name);
+    }
+}
 
 TEST_CASE_METHOD(WithDuckDB, "Check QuackstoreFileSystem::DirectoryExists", "[quackstore]") {
     const auto CACHE_PATH = "/tmp/cache_direxists_test.bin";
@@ -46,6 +46,16 @@ MetadataManager::FileMetadata GetSampleMetadataV3()
     return result;
 }
 
+MetadataManager::FileMetadata GetSampleMetadataV4()
+{
+    auto result = GetSampleMetadataV3();
+    result.blocks[2].offset = 512;
+    result.blocks[2].length = 100;
+    REQUIRE(result.blocks[2].HasLength());
+    REQUIRE_FALSE(result.blocks[1].HasLength());
+    return result;
+}
+
 TEST_CASE("FileMetadata is constructed properly initialized", "[MetadataManager][FileMetadata]") {
     MetadataManager::FileMetadata metadata;
     CHECK(metadata.file_size == 0);
@@ -123,3 +133,247 @@ TEST_CASE("FileMetadata gets serialized and deserialized properly v3", "[Metadat
     CHECK(deserialized.last_modified > duckdb::timestamp_t::epoch());
     CHECK(deserialized.last_modified == SAMPLE_TIMESTAMP_T);
 }
+
+TEST_CASE("FileMetadata gets serialized and deserialized properly v4", "[MetadataManager][FileMetadata]") {
+    const auto serialized = GetSampleMetadataV4();
+    INFO("Serialized metadata: " + serialized.ToString());
+
+    duckdb::MemoryStream mem;
+    serialized.Write(mem);
+
+    mem.Rewind();
+    auto deserialized = MetadataManager::FileMetadata::Read(mem, 4);
+    INFO("Deserialized metadata: " + deserialized.ToString());
+
+    CHECK(deserialized.file_size == serialized.file_size);
+    CHECK(deserialized.blocks.size() == serialized.blocks.size());
+    for (const auto& [in_id, in_block] : serialized.blocks) {
+        REQUIRE(deserialized.blocks.find(in_id) != deserialized.blocks.end());
+        const auto& out_block = deserialized.blocks.at(in_id);
+        CHECK(out_block.block_index == in_block.block_index);
+        CHECK(out_block.block_id == in_block.block_id);
+        CHECK(out_block.checksum == in_block.checksum);
+        CHECK(out_block.offset == in_block.offset);
+        CHECK(out_block.length == in_block.length);
+    }
+    CHECK(deserialized.last_modified == SAMPLE_TIMESTAMP_T);
+}
+
+TEST_CASE("Groups over their quota are evicted first", "[MetadataManager]") {
+    const uint64_t BLOCK_SIZE = 100;
+    MetadataManager metadata_manager;
+    metadata_manager.SetBlockSize(BLOCK_SIZE);
+    metadata_manager.SetMaxCacheSize(10 * BLOCK_SIZE);
+
+    duckdb::vector<block_id_t> removed;
+    const auto remove = [&](block_id_t block_id) { removed.push_back(block_id); };
+
+    // An older block of another tenant, and a tenant scanning a lot of data
+    metadata_manager.RegisterBlock("quackstore://s3://quiet/file.csv", 0, 1, 1);
+    metadata_manager.UpdateLRUOrder(1);
+    block_id_t block_id = 2;
+    for (int64_t block_index = 0; block_index < 5; ++block_index, ++block_id) {
+        metadata_manager.RegisterBlock("quackstore://s3://noisy/file.csv", block_index, block_id, block_id);
+        metadata_manager.UpdateLRUOrder(block_id);
+    }
+
+    MetadataManager::Quota noisy_quota;
+    noisy_quota.prefix = "s3://noisy/";
+    noisy_quota.percent = 30;
+    metadata_manager.SetQuotas({noisy_quota});
+
+    // The noisy group is over its quota, but the cache has room for it
+    CHECK_FALSE(metadata_manager.EvictLRUBlockIfNeeded(remove));
+    CHECK(removed.empty());
+
+    // Over the max cache size, the oldest blocks of the noisy group go first
+    for (int64_t block_index = 1; block_index <= 6; ++block_index, ++block_id) {
+        metadata_manager.RegisterBlock("quackstore://s3://quiet/file.csv", block_index, block_id, block_id);
+        metadata_manager.UpdateLRUOrder(block_id);
+    }
+    CHECK(metadata_manager.EvictLRUBlockIfNeeded(remove));
+    CHECK(removed == duckdb::vector<block_id_t>{2, 3});
+    CHECK(metadata_manager.GetBlockId("quackstore://s3://quiet/file.csv", 0) == 1);
+
+    auto usage = metadata_manager.GetGroupUsage();
+    REQUIRE(usage.size() == 2);
+    CHECK(usage[0].prefix == "s3://noisy/");
+    CHECK(usage[0].limit == 3 * BLOCK_SIZE);
+    CHECK(usage[0].cached_bytes == 3 * BLOCK_SIZE);
+    CHECK(usage[0].block_count == 3);
+    CHECK(usage[1].prefix == "");
+    CHECK(usage[1].cached_bytes == 7 * BLOCK_SIZE);
+    CHECK(usage[1].block_count == 7);
+
+    SECTION("Byte quotas") {
+        noisy_quota.percent = 0;
+        noisy_quota.max_bytes = BLOCK_SIZE;
+        metadata_manager.SetQuotas({noisy_quota});
+        removed.clear();
+        CHECK_FALSE(metadata_manager.EvictLRUBlockIfNeeded(remove));
+        metadata_manager.RegisterBlock("quackstore://s3://quiet/file.csv", 7, block_id, block_id);
+        metadata_manager.UpdateLRUOrder(block_id);
+        CHECK(metadata_manager.EvictLRUBlockIfNeeded(remove));
+        CHECK(removed == duckdb::vector<block_id_t>{4});
+        CHECK(metadata_manager.GetCachedBytes() == 10 * BLOCK_SIZE);
+    }
+
+    SECTION("Removing the quotas moves the blocks to the group without a quota") {
+        metadata_manager.SetQuotas({});
+        usage = metadata_manager.GetGroupUsage();
+        REQUIRE(usage.size() == 1);
+        CHECK(usage[0].cached_bytes == 10 * BLOCK_SIZE);
+        CHECK(usage[0].block_count == 10);
+        removed.clear();
+        CHECK_FALSE(metadata_manager.EvictLRUBlockIfNeeded(remove));
+    }
+}
+
+TEST_CASE("Retained blocks are evicted last", "[MetadataManager]") {
+    const uint64_t BLOCK_SIZE = 100;
+    MetadataManager metadata_manager;
+    metadata_manager.SetBlockSize(BLOCK_SIZE);
+    metadata_manager.SetMaxCacheSize(2 * BLOCK_SIZE);
+
+    duckdb::vector<block_id_t> removed;
+    const auto remove = [&](block_id_t block_id) { removed.push_back(block_id); };
+
+    for (block_id_t block_id = 1; block_id <= 4; ++block_id) {
+        metadata_manager.RegisterBlock("quackstore://s3://bucket/db.duckdb", block_id - 1, block_id, block_id);
+        metadata_manager.UpdateLRUOrder(block_id);
+    }
+    // The least recently used block holds the database header
+    metadata_manager.RetainBlock(1);
+    CHECK(metadata_manager.IsBlockRetained(1));
+    CHECK_FALSE(metadata_manager.IsBlockRetained(2));
+
+    CHECK(metadata_manager.EvictLRUBlockIfNeeded(remove));
+    CHECK(removed == duckdb::vector<block_id_t>{2, 3});
+
+    SECTION("Retained blocks are evicted once no other block is left") {
+        metadata_manager.SetMaxCacheSize(0);
+        removed.clear();
+        CHECK(metadata_manager.EvictLRUBlockIfNeeded(remove, 4));
+        CHECK(removed == duckdb::vector<block_id_t>{1});
+        CHECK_FALSE(metadata_manager.IsBlockRetained(1));
+    }
+}
+
+TEST_CASE("Files are found by path prefix and glob pattern", "[MetadataManager]") {
+    MetadataManager metadata_manager;
+    metadata_manager.SetBlockSize(100);
+
+    block_id_t block_id = 0;
+    for (const auto &path : {"quackstore://s3://b/t/date=2024-01/part-0.parquet",
+                             "quackstore://s3://b/t/date=2024-01/part-1.parquet",
+                             "quackstore://s3://b/t/date=2024-02/nested/part-0.parquet",
+                             "quackstore://s3://b/t/date=2023-12/part-0.parquet",
+                             "quackstore://s3://b/t2/part-0.parquet"}) {
+        metadata_manager.RegisterBlock(path, 0, block_id, block_id);
+        ++block_id;
+    }
+
+    CHECK(metadata_manager.GetFilePathsWithPrefix("quackstore://s3://b/t/date=2024-01/") ==
+          duckdb::vector<duckdb::string>{"quackstore://s3://b/t/date=2024-01/part-0.parquet",
+                                         "quackstore://s3://b/t/date=2024-01/part-1.parquet"});
+    CHECK(metadata_manager.GetFilePathsWithPrefix("quackstore://s3://b/t").size() == 5);
+    CHECK(metadata_manager.GetFilePathsWithPrefix("quackstore://s3://c/").empty());
+
+    // A trailing slash matches everything below, a single star stays within one directory
+    CHECK(metadata_manager.GetFilePathsMatching("quackstore://s3://b/t/date=2024-*/").size() == 3);
+    CHECK(metadata_manager.GetFilePathsMatching("quackstore://s3://b/t/date=2024-*/*.parquet").size() == 2);
+    CHECK(metadata_manager.GetFilePathsMatching("quackstore://s3://b/t/**/part-0.parquet").size() == 3);
+    CHECK(metadata_manager.GetFilePathsMatching("quackstore://s3://b/t/date=202[3]-??/part-0.parquet") ==
+          duckdb::vector<duckdb::string>{"quackstore://s3://b/t/date=2023-12/part-0.parquet"});
+
+    duckdb::vector<block_id_t> released;
+    CHECK(metadata_manager.UnregisterFileBlocks("quackstore://s3://b/t2/part-0.parquet",
+                                                [&](block_id_t block_id) { released.push_back(block_id); }) == 1);
+    CHECK(released == duckdb::vector<block_id_t>{4});
+    CHECK(metadata_manager.GetFilePathsWithPrefix("quackstore://s3://b/t2/").empty());
+}
+
+TEST_CASE("Renamed files keep their blocks under the new path", "[MetadataManager]") {
+    MetadataManager metadata_manager;
+    metadata_manager.SetBlockSize(100);
+    const duckdb::string SOURCE_PATH = "quackstore://s3://bucket/tmp/part-0.parquet";
+    const duckdb::string TARGET_PATH = "quackstore://s3://bucket/table/part-0.parquet";
+
+    metadata_manager.RegisterBlock(SOURCE_PATH, 0, 1, 1);
+    metadata_manager.RegisterBlock(SOURCE_PATH, 1, 2, 2);
+    metadata_manager.SetFileSize(SOURCE_PATH, 200);
+    metadata_manager.UpdateLRUOrder(1);
+    metadata_manager.UpdateLRUOrder(2);
+    // The target was only stat'ed before
+    metadata_manager.SetFileSize(TARGET_PATH, 50);
+    const auto metadata_bytes = metadata_manager.GetMetadataBytes();
+
+    CHECK(metadata_manager.RenameFile(SOURCE_PATH, TARGET_PATH));
+    CHECK(metadata_manager.GetFilePaths() == duckdb::vector<duckdb::string>{TARGET_PATH});
+    CHECK(metadata_manager.GetBlockId(SOURCE_PATH, 0) == BlockManager::INVALID_BLOCK_ID);
+    CHECK(metadata_manager.GetBlockId(TARGET_PATH, 0) == 1);
+    CHECK(metadata_manager.GetBlockId(TARGET_PATH, 1) == 2);
+    MetadataManager::FileMetadata file_metadata;
+    REQUIRE(metadata_manager.GetFileMetadata(TARGET_PATH, file_metadata));
+    CHECK(file_metadata.file_size == 200);
+    CHECK(metadata_manager.GetLRUState() ==
+          duckdb::vector<MetadataManager::BlockKey>{{TARGET_PATH, 1}, {TARGET_PATH, 0}});
+    CHECK(metadata_manager.GetMetadataBytes() < metadata_bytes);
+    CHECK_FALSE(metadata_manager.RenameFile(SOURCE_PATH, TARGET_PATH));
+
+    // Evicting the block removes the renamed file
+    metadata_manager.UnregisterBlock(1);
+    metadata_manager.UnregisterBlock(2);
+    CHECK(metadata_manager.GetFileCount() == 0);
+}
+
+TEST_CASE("Metadata over its budget drops files without blocks first, then the least recently used files", "[MetadataManager]") {
+    MetadataManager metadata_manager;
+    metadata_manager.SetBlockSize(100);
+    const auto empty_bytes = metadata_manager.GetMetadataBytes();
+
+    for (block_id_t block_id = 0; block_id < 4; ++block_id) {
+        const auto path = "quackstore://s3://bucket/file-" + std::to_string(block_id) + ".parquet";
+        metadata_manager.RegisterBlock(path, 0, block_id, block_id);
+        metadata_manager.UpdateLRUOrder(block_id);
+    }
+    // Only the size and modification time of these files are known
+    metadata_manager.SetFileSize("quackstore://s3://bucket/stat-only-0.parquet", 100);
+    metadata_manager.SetFileSize("quackstore://s3://bucket/stat-only-1.parquet", 100);
+    CHECK(metadata_manager.GetFileCount() == 6);
+    const auto full_bytes = metadata_manager.GetMetadataBytes();
+    CHECK(full_bytes > empty_bytes);
+
+    duckdb::vector<block_id_t> released;
+    const auto release = [&](block_id_t block_id) { released.push_back(block_id); };
+    CHECK(metadata_manager.EvictFileMetadata(full_bytes, "", release) == 0);
+
+    SECTION("Files without blocks go first") {
+        CHECK(metadata_manager.EvictFileMetadata(full_bytes - 1, "", release) == 1);
+        CHECK(metadata_manager.GetFileCount() == 5);
+        CHECK(released.empty());
+    }
+
+    SECTION("Files that got blocks since are kept") {
+        metadata_manager.RegisterBlock("quackstore://s3://bucket/stat-only-0.parquet", 0, 4, 4);
+        metadata_manager.UpdateLRUOrder(4);
+        CHECK(metadata_manager.EvictFileMetadata(metadata_manager.GetMetadataBytes() - 1, "", release) == 1);
+        MetadataManager::FileMetadata md;
+        CHECK(metadata_manager.GetFileMetadata("quackstore://s3://bucket/stat-only-0.parquet", md));
+        CHECK_FALSE(metadata_manager.GetFileMetadata("quackstore://s3://bucket/stat-only-1.parquet", md));
+        CHECK(released.empty());
+    }
+
+    SECTION("Then the files of the least recently used blocks") {
+        metadata_manager.UpdateLRUOrder(0);
+        CHECK(metadata_manager.EvictFileMetadata(0, "quackstore://s3://bucket/file-0.parquet", release) == 5);
+        CHECK(metadata_manager.GetFilePaths() == duckdb::vector<duckdb::string>{"quackstore://s3://bucket/file-0.parquet"});
+        CHECK(released == duckdb::vector<block_id_t>{1, 2, 3});
+    }
+
+    SECTION("Dropping everything leaves the metadata of an empty cache") {
+        metadata_manager.EvictFileMetadata(0, "", release);
+        CHECK(metadata_manager.GetFileCount() == 0);
+        CHECK(metadata_manager.GetMetadataBytes() == empty_bytes);
+    }
+}
@@ -0,0 +1,111 @@
+#include <catch/catch.hpp>
+#include <duckdb.hpp>
+
+#include "table_format.hpp"
+
+using namespace quackstore;
+
+namespace {
+    //! Zig-zag varint encoding of Avro longs
+    duckdb::string AvroLong(int64_t value) {
+        auto encoded = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        duckdb::string result;
+        do {
+            uint8_t byte = encoded & 0x7F;
+            encoded >>= 7;
+            result += static_cast<char>(encoded ? byte | 0x80 : byte);
+        } while (encoded);
+        return result;
+    }
+
+    duckdb::string AvroString(const duckdb::string &value) {
+        return AvroLong(value.size()) + value;
+    }
+
+    //! Avro object container file with one block of null-codec data
+    duckdb::string AvroFile(const duckdb::string &data, int64_t object_count) {
+        const duckdb::string sync(16, '\x5A');
+        duckdb::string result("Obj\x01", 4);
+        result += AvroLong(1) + AvroString("avro.codec") + AvroString("null") + AvroLong(0);
+        result += sync;
+        result += AvroLong(object_count) + AvroString(data) + sync;
+        return result;
+    }
+}
+
+TEST_CASE("Table metadata files are classified by their paths", "[TableFormat]") {
+    using FileKind = TableFormat::FileKind;
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/table/metadata/00001-abc.metadata.json") == FileKind::ICEBERG_METADATA);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/table/metadata/snap-123-1-abc.avro") == FileKind::ICEBERG_MANIFEST_LIST);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/table/metadata/abc-m0.avro") == FileKind::ICEBERG_MANIFEST);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/table/_delta_log/00000000000000000001.json") == FileKind::DELTA_LOG);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/table/data/part-0.parquet") == FileKind::NONE);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/data/records.avro") == FileKind::NONE);
+    CHECK(TableFormat::Classify("quackstore://s3://bucket/data/records.json") == FileKind::NONE);
+}
+
+TEST_CASE("Data files of Delta add actions are extracted", "[TableFormat]") {
+    const duckdb::string LOG_PATH = "quackstore://s3://bucket/table/_delta_log/00000000000000000001.json";
+    const duckdb::string log =
+        R"({"commitInfo":{"timestamp":1700000000000,"operation":"WRITE"}})" "\n"
+        R"({"add":{"path":"year=2024/part-0.parquet","partitionValues":{"year":"2024"},"size":100}})" "\n"
+        R"({"remove":{"path":"part-old.parquet","deletionTimestamp":1700000000000}})" "\n"
+        R"({"add":{"path":"city=New%20York/part-1.parquet","size":200}})" "\n"
+        R"({"add":{"path":"s3://other-bucket/part-2.parquet","size":300}})" "\n";
+
+    auto references = TableFormat::ExtractReferences(TableFormat::FileKind::DELTA_LOG, LOG_PATH, log);
+    CHECK(references.metadata_files.empty());
+    REQUIRE(references.data_files.size() == 3);
+    CHECK(references.data_files[0] == "quackstore://s3://bucket/table/year=2024/part-0.parquet");
+    CHECK(references.data_files[1] == "quackstore://s3://bucket/table/city=New York/part-1.parquet");
+    CHECK(references.data_files[2] == "quackstore://s3://other-bucket/part-2.parquet");
+}
+
+TEST_CASE("The manifest list of the current Iceberg snapshot is extracted", "[TableFormat]") {
+    const duckdb::string METADATA_PATH = "quackstore://s3://bucket/table/metadata/00002-abc.metadata.json";
+    const duckdb::string metadata = R"({
+        "format-version": 2,
+        "current-snapshot-id" : 222,
+        "refs": {"main": {"snapshot-id": 222, "type": "branch"}, "audit": {"snapshot-id": 111, "type": "tag"}},
+        "snapshots": [
+            {"snapshot-id": 111, "manifest-list": "s3://bucket/table/metadata/snap-111-1-a.avro"},
+            {"snapshot-id": 222, "parent-snapshot-id": 111, "manifest-list": "s3:\/\/bucket/table/metadata/snap-222-1-b.avro"}
+        ]
+    })";
+
+    auto references = TableFormat::ExtractReferences(TableFormat::FileKind::ICEBERG_METADATA, METADATA_PATH, metadata);
+    CHECK(references.data_files.empty());
+    REQUIRE(references.metadata_files.size() == 1);
+    CHECK(references.metadata_files[0] == "quackstore://s3://bucket/table/metadata/snap-222-1-b.avro");
+
+    SECTION("Tables without snapshots reference nothing") {
+        const duckdb::string empty_table = R"({"format-version": 2, "current-snapshot-id": -1, "snapshots": []})";
+        references = TableFormat::ExtractReferences(TableFormat::FileKind::ICEBERG_METADATA, METADATA_PATH, empty_table);
+        CHECK(references.metadata_files.empty());
+    }
+}
+
+TEST_CASE("Paths are found in the records of Avro files", "[TableFormat]") {
+    const duckdb::string MANIFEST_PATH = "quackstore://s3://bucket/table/metadata/abc-m0.avro";
+    // Records of a manifest: status, the data file path, its format and record count
+    duckdb::string records;
+    records += AvroLong(1) + AvroString("s3://bucket/table/data/part-0.parquet") + AvroString("PARQUET") + AvroLong(1000);
+    records += AvroLong(1) + AvroString("s3://bucket/table/data/part-1.parquet") + AvroString("PARQUET") + AvroLong(2000);
+    records += AvroLong(2) + AvroString("s3://bucket/table/data/part-0.parquet") + AvroString("PARQUET") + AvroLong(1000);
+    const auto manifest = AvroFile(records, 3);
+
+    CHECK(TableFormat::ReadAvroData(manifest) == records);
+    CHECK(TableFormat::ReadAvroData("not an avro file").empty());
+
+    auto references = TableFormat::ExtractReferences(TableFormat::FileKind::ICEBERG_MANIFEST, MANIFEST_PATH, manifest);
+    CHECK(references.metadata_files.empty());
+    REQUIRE(references.data_files.size() == 2);
+    CHECK(references.data_files[0] == "quackstore://s3://bucket/table/data/part-0.parquet");
+    CHECK(references.data_files[1] == "quackstore://s3://bucket/table/data/part-1.parquet");
+
+    // Long paths have lengths of more than one byte
+    const duckdb::string long_path = "/data/" + duckdb::string(300, 'x') + ".parquet";
+    auto strings = TableFormat::FindAvroStrings(AvroLong(7) + AvroString(long_path), {".parquet"});
+    REQUIRE(strings.size() == 1);
+    CHECK(strings[0] == long_path);
+}